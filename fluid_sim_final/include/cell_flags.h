@@ -0,0 +1,137 @@
+#ifndef CELL_FLAGS_H
+#define CELL_FLAGS_H
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Per-cell type of the lattice, shared by the GL pipelines (as an R8UI
+// texture) and the CPU engine. Solid cells bounce populations back, inlet
+// cells are held at equilibrium with a fixed velocity, outlet cells at
+// equilibrium with rho = 1 and their own velocity. The values match the
+// FLAG_* constants of the shaders.
+enum class CellType : uint8_t { Fluid = 0, Solid = 1, Inlet = 2, Outlet = 3 };
+
+// Row-major NX x NY field, row 0 at the bottom like the textures. Images are
+// loaded from binary or ASCII PGM/PPM and scaled to the grid by nearest
+// neighbour, top image row at the top of the grid:
+//   PGM: dark (< half of maxval) = solid, anything else = fluid
+//   PPM: dark = solid, red = inlet, blue = outlet, anything else = fluid
+class CellFlags {
+private:
+    int NX = 0;
+    int NY = 0;
+    std::vector<uint8_t> types;
+
+    // next token of a PNM header, skipping whitespace and # comments
+    static bool readToken(std::istream& in, int& value) {
+        in >> std::ws;
+        while (in.peek() == '#') {
+            std::string comment;
+            std::getline(in, comment);
+            in >> std::ws;
+        }
+        return bool(in >> value);
+    }
+
+    static CellType classify(int r, int g, int b, int maxval) {
+        int half = (maxval + 1) / 2;
+        bool red = r >= half, green = g >= half, blue = b >= half;
+        if (!red && !green && !blue) return CellType::Solid;
+        if (red && !green && !blue) return CellType::Inlet;
+        if (!red && !green && blue) return CellType::Outlet;
+        return CellType::Fluid;
+    }
+
+public:
+    CellFlags() = default;
+    CellFlags(int nx, int ny) : NX(nx), NY(ny), types(size_t(nx) * ny, uint8_t(CellType::Fluid)) {}
+
+    int width() const { return NX; }
+    int height() const { return NY; }
+    bool empty() const { return types.empty(); }
+    const uint8_t* data() const { return types.data(); }
+
+    CellType at(int x, int y) const { return CellType(types[size_t(y) * NX + x]); }
+    void set(int x, int y, CellType type) { types[size_t(y) * NX + x] = uint8_t(type); }
+
+    // true if some cell has a type other than fluid
+    bool hasBoundaries() const {
+        for (uint8_t t : types) {
+            if (t != uint8_t(CellType::Fluid)) return true;
+        }
+        return false;
+    }
+
+    // The field with a one-cell solid ring around it, (NX + 2) x (NY + 2).
+    // Shaders look up x - e_i at offset (1, 1) in this copy, so the box walls
+    // are ordinary solid cells and no fragment tests coordinates.
+    std::vector<uint8_t> bordered() const {
+        int bx = NX + 2;
+        std::vector<uint8_t> out(size_t(bx) * (NY + 2), uint8_t(CellType::Solid));
+        for (int y = 0; y < NY; y++) {
+            for (int x = 0; x < NX; x++) out[size_t(y + 1) * bx + x + 1] = types[size_t(y) * NX + x];
+        }
+        return out;
+    }
+
+    // replaces the field with the image at path scaled to nx x ny
+    bool load(const std::string& path, int nx, int ny) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            std::cerr << "ERROR: cannot open flag image " << path << std::endl;
+            return false;
+        }
+        char magic[2] = {};
+        in.read(magic, 2);
+        int kind = magic[0] == 'P' ? magic[1] - '0' : 0;
+        if (kind != 2 && kind != 3 && kind != 5 && kind != 6) {
+            std::cerr << "ERROR: " << path << " is not a PGM or PPM image" << std::endl;
+            return false;
+        }
+        int w = 0, h = 0, maxval = 0;
+        if (!readToken(in, w) || !readToken(in, h) || !readToken(in, maxval) ||
+            w <= 0 || h <= 0 || maxval <= 0 || maxval > 65535) {
+            std::cerr << "ERROR: bad header in " << path << std::endl;
+            return false;
+        }
+        bool color = kind == 3 || kind == 6;
+        bool binary = kind == 5 || kind == 6;
+        int channels = color ? 3 : 1;
+        int bytes = maxval > 255 ? 2 : 1;
+        if (binary) in.get();  // the single whitespace before the raster
+
+        std::vector<int> samples(size_t(w) * h * channels);
+        for (int& s : samples) {
+            if (binary) {
+                unsigned char c[2] = {};
+                in.read(reinterpret_cast<char*>(c), bytes);
+                s = bytes == 2 ? (c[0] << 8) | c[1] : c[0];
+            } else {
+                in >> s;
+            }
+        }
+        if (!in) {
+            std::cerr << "ERROR: truncated image data in " << path << std::endl;
+            return false;
+        }
+
+        NX = nx;
+        NY = ny;
+        types.assign(size_t(nx) * ny, uint8_t(CellType::Fluid));
+        for (int y = 0; y < ny; y++) {
+            int row = int((long long)(ny - 1 - y) * h / ny);  // image rows run top-down
+            for (int x = 0; x < nx; x++) {
+                const int* p = &samples[(size_t(row) * w + size_t((long long)x * w / nx)) * channels];
+                CellType type = color ? classify(p[0], p[1], p[2], maxval)
+                                      : classify(p[0], p[0], p[0], maxval);
+                set(x, y, type);
+            }
+        }
+        return true;
+    }
+};
+
+#endif
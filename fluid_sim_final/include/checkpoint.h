@@ -0,0 +1,261 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Binary checkpoint of a population lattice.
+//
+// The file is one header page followed by the Q population planes, row-major
+// with row 0 first (texel row 0 of the GL textures). Each plane is padded to
+// a page multiple, so in an mmap of the file every plane starts page-aligned
+// and its pointer goes straight to glTexSubImage / glBufferSubData or into
+// the CPU engine's planes: loading never reads the file into a buffer first.
+// Saving writes each plane at its offset as soon as it is available, into
+// path.tmp, and renames it over path once complete, so a crash mid-save
+// leaves the previous checkpoint intact.
+namespace checkpoint {
+
+constexpr char Magic[8] = {'L', 'B', 'M', 'C', 'K', 'P', 'T', '\0'};
+constexpr uint32_t Version = 1;
+constexpr size_t PageBytes = 4096;
+constexpr int MaxQ = 32;
+
+// element type of the planes; same order as LBMStorage
+enum class Precision : uint32_t {
+    Float32 = 0,
+    Float16 = 1,           // IEEE half
+    Float16Deviation = 2,  // IEEE half of f_i - bias[i]
+};
+
+// What the planes hold, so a checkpoint restarts any scheme whose step
+// begins from the same state:
+//   Streamed       plain populations after streaming (split; in-place
+//                  before an even step)
+//   PostCollision  collided populations not yet streamed (fused, compute)
+//   Swapped        PostCollision with slot i stored in slot opp(i) (in-place
+//                  before an odd step)
+// PostCollision and Swapped only differ in plane order.
+enum class State : uint32_t {
+    Streamed = 0,
+    PostCollision = 1,
+    Swapped = 2,
+};
+
+inline const char* stateName(State state) {
+    switch (state) {
+        case State::PostCollision: return "post-collision";
+        case State::Swapped: return "swapped post-collision";
+        default: return "streamed";
+    }
+}
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;  // offset of plane 0
+    char lattice[8];       // e.g. "D2Q9"
+    uint32_t q;
+    uint32_t nx, ny, nz;
+    uint32_t precision;    // Precision
+    uint32_t state;        // State
+    float tau;
+    uint32_t reserved;
+    int64_t step;          // steps run when the checkpoint was taken
+    uint64_t planeBytes;   // distance between planes, a page multiple
+    float bias[MaxQ];      // Float16Deviation: added back to decoded values
+};
+static_assert(sizeof(Header) <= PageBytes, "checkpoint header must fit its page");
+
+inline size_t elementBytes(Precision precision) {
+    return precision == Precision::Float32 ? sizeof(float) : sizeof(uint16_t);
+}
+
+inline uint64_t roundToPage(uint64_t bytes) {
+    return (bytes + PageBytes - 1) / PageBytes * PageBytes;
+}
+
+inline Header makeHeader(const char* lattice, int q, int nx, int ny, int nz, float tau, long long step,
+                         Precision precision, State state) {
+    Header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, Magic, sizeof(Magic));
+    h.version = Version;
+    h.headerBytes = uint32_t(PageBytes);
+    std::strncpy(h.lattice, lattice, sizeof(h.lattice) - 1);
+    h.q = uint32_t(q);
+    h.nx = uint32_t(nx);
+    h.ny = uint32_t(ny);
+    h.nz = uint32_t(nz);
+    h.precision = uint32_t(precision);
+    h.state = uint32_t(state);
+    h.tau = tau;
+    h.step = step;
+    h.planeBytes = roundToPage(uint64_t(nx) * ny * nz * elementBytes(precision));
+    return h;
+}
+
+// Writes a checkpoint plane by plane, in any order and from any one thread.
+class Writer {
+private:
+    int fd = -1;
+    std::string path;
+    std::string tmpPath;
+    Header header{};
+
+    bool writeAt(const void* data, size_t bytes, uint64_t offset) {
+        const char* p = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t n = pwrite(fd, p, bytes, off_t(offset));
+            if (n <= 0) return false;
+            p += n;
+            bytes -= size_t(n);
+            offset += uint64_t(n);
+        }
+        return true;
+    }
+
+public:
+    Writer() = default;
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    ~Writer() { abort(); }
+
+    bool open(const std::string& file, const Header& h) {
+        abort();
+        path = file;
+        tmpPath = file + ".tmp";
+        header = h;
+        fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            std::cerr << "ERROR: cannot write checkpoint " << tmpPath << std::endl;
+            return false;
+        }
+        uint64_t size = header.headerBytes + header.planeBytes * header.q;
+        if (ftruncate(fd, off_t(size)) != 0 || !writeAt(&header, sizeof(header), 0)) {
+            std::cerr << "ERROR: cannot size checkpoint " << tmpPath << std::endl;
+            abort();
+            return false;
+        }
+        return true;
+    }
+
+    const Header& info() const { return header; }
+
+    // rows [y0, y1) of plane i, nx * nz elements per row
+    bool writeRows(int i, int y0, int y1, const void* data) {
+        size_t row = size_t(header.nx) * header.nz * elementBytes(Precision(header.precision));
+        uint64_t offset = header.headerBytes + header.planeBytes * uint64_t(i) + uint64_t(row) * y0;
+        if (fd < 0 || !writeAt(data, row * size_t(y1 - y0), offset)) {
+            std::cerr << "ERROR: checkpoint write failed for plane " << i << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool writePlane(int i, const void* data) { return writeRows(i, 0, int(header.ny), data); }
+
+    // makes the file durable and moves it over the previous checkpoint
+    bool commit() {
+        if (fd < 0) return false;
+        bool ok = fsync(fd) == 0;
+        ok = ::close(fd) == 0 && ok;
+        fd = -1;
+        if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            std::cerr << "ERROR: cannot finish checkpoint " << path << std::endl;
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // drops an unfinished file
+    void abort() {
+        if (fd < 0) return;
+        ::close(fd);
+        fd = -1;
+        std::remove(tmpPath.c_str());
+    }
+};
+
+// Read-only mapping of a checkpoint; plane pointers stay valid until close().
+class Reader {
+private:
+    int fd = -1;
+    void* base = MAP_FAILED;
+    size_t size = 0;
+
+public:
+    Reader() = default;
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    ~Reader() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            std::cerr << "ERROR: cannot open checkpoint " << path << std::endl;
+            close();
+            return false;
+        }
+        size = size_t(st.st_size);
+        if (size >= sizeof(Header)) base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            std::cerr << "ERROR: cannot map checkpoint " << path << std::endl;
+            close();
+            return false;
+        }
+
+        const Header& h = header();
+        bool valid = std::memcmp(h.magic, Magic, sizeof(Magic)) == 0;
+        if (valid && h.version != Version) {
+            std::cerr << "ERROR: checkpoint " << path << " has version " << h.version << ", expected "
+                      << Version << std::endl;
+            close();
+            return false;
+        }
+        valid = valid && h.q > 0 && h.q <= uint32_t(MaxQ) && h.precision <= uint32_t(Precision::Float16Deviation) &&
+                h.state <= uint32_t(State::Swapped) && h.headerBytes % PageBytes == 0 &&
+                h.planeBytes % PageBytes == 0 &&
+                h.planeBytes >= uint64_t(h.nx) * h.ny * h.nz * elementBytes(Precision(h.precision)) &&
+                h.headerBytes + h.planeBytes * h.q <= size;
+        if (!valid) {
+            std::cerr << "ERROR: " << path << " is not a valid checkpoint" << std::endl;
+            close();
+            return false;
+        }
+        // planes are consumed front to back, once
+        madvise(base, size, MADV_SEQUENTIAL);
+        madvise(base, size, MADV_WILLNEED);
+        return true;
+    }
+
+    const Header& header() const { return *static_cast<const Header*>(base); }
+
+    const void* plane(int i) const {
+        const Header& h = header();
+        return static_cast<const char*>(base) + h.headerBytes + h.planeBytes * uint64_t(i);
+    }
+
+    void close() {
+        if (base != MAP_FAILED) munmap(base, size);
+        base = MAP_FAILED;
+        size = 0;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+};
+
+}  // namespace checkpoint
+
+#endif
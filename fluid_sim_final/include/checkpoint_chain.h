@@ -0,0 +1,591 @@
+#ifndef CHECKPOINT_CHAIN_H
+#define CHECKPOINT_CHAIN_H
+
+#include <checkpoint.h>
+#include <half_float.h>
+#include <thread_pool.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Incremental checkpoints for long runs.
+//
+// A chain is a text manifest, prefix.chain, listing checkpoints in step
+// order: full keyframes in the checkpoint.h format (each one loads on its
+// own) and delta files holding only the tiles that moved by more than a
+// threshold since their parent, the previous entry of the same population
+// state. The writer keeps a shadow copy of the lattice as the chain
+// reconstructs it and compares every tile against it, so an unwritten tile
+// never drifts more than the threshold from the live one however many deltas
+// follow; threshold 0 keeps the chain bit-exact. An in-place run saved after
+// odd intervals alternates between the streamed and swapped states, which
+// are not a plane permutation of each other, so each state keeps its own
+// shadow and deltas of one state skip over the entries of the other. A
+// keyframe is written every keyframeEvery saves of a state, when most tiles
+// changed anyway, and whenever the grid or storage differs from the previous
+// entry. compactChain() folds a chain into one keyframe.
+//
+// Delta file: one header page (DeltaHeader), the ids of the tiles it holds
+// padded to a page, then one record per tile: the tile's rows of each of
+// the q planes, tileSize^2 elements per plane even for the smaller tiles at
+// the grid edge, so record k starts at dataOffset + k * recordBytes.
+namespace checkpoint {
+
+constexpr char DeltaMagic[8] = {'L', 'B', 'M', 'D', 'E', 'L', 'T', '\0'};
+constexpr const char* ChainMagic = "LBMCHAIN";
+
+struct DeltaHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;  // offset of the tile ids
+    Header base;           // lattice, storage, state and step of this entry
+    int64_t parentStep;    // step of the previous entry
+    uint32_t tileSize;
+    uint32_t tilesX, tilesY;
+    uint32_t tileCount;    // tiles in this file
+    uint64_t dataOffset;   // offset of record 0, a page multiple
+    uint64_t recordBytes;
+    float threshold;       // largest change of a population left out
+    uint32_t reserved;
+};
+static_assert(sizeof(DeltaHeader) <= PageBytes, "delta header must fit its page");
+
+// Tiles over the rows of a checkpoint: nx * nz elements wide, ny rows high.
+struct TileGrid {
+    int size = 0;
+    int width = 0, height = 0;
+    int tilesX = 0, tilesY = 0;
+
+    TileGrid() = default;
+    TileGrid(int tile, const Header& h)
+        : size(tile), width(int(h.nx * h.nz)), height(int(h.ny)),
+          tilesX((width + tile - 1) / tile), tilesY((height + tile - 1) / tile) {}
+
+    int count() const { return tilesX * tilesY; }
+
+    void bounds(int t, int& x0, int& x1, int& y0, int& y1) const {
+        x0 = (t % tilesX) * size;
+        y0 = (t / tilesX) * size;
+        x1 = std::min(x0 + size, width);
+        y1 = std::min(y0 + size, height);
+    }
+};
+
+struct ChainEntry {
+    bool keyframe = false;
+    long long step = 0;
+    std::string file;  // relative to the manifest's directory
+};
+
+// what one ChainWriter::save() did
+struct ChainStats {
+    bool keyframe = false;
+    int tiles = 0;          // tiles of the grid
+    int tilesWritten = 0;
+    uint64_t bytes = 0;     // size of the file written
+    uint64_t fullBytes = 0; // size of a keyframe of the same lattice
+};
+
+inline std::string chainDirectory(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+inline std::string chainFileName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// prefix.000000001000.ckpt / .delta: names sort in step order
+inline std::string chainEntryPath(const std::string& prefix, long long step, bool keyframe) {
+    char name[32];
+    std::snprintf(name, sizeof(name), ".%012lld", step);
+    return prefix + name + (keyframe ? ".ckpt" : ".delta");
+}
+
+inline uint64_t fileBytes(const Header& h) {
+    return h.headerBytes + h.planeBytes * h.q;
+}
+
+// Writes `parts` ({offset, data, bytes}) into a path.tmp of `size` bytes,
+// fsyncs it and renames it over path, like Writer::commit().
+struct FilePart {
+    uint64_t offset;
+    const void* data;
+    size_t bytes;
+};
+
+inline bool writeAtomically(const std::string& path, uint64_t size, const std::vector<FilePart>& parts) {
+    std::string tmpPath = path + ".tmp";
+    int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0 && ftruncate(fd, off_t(size)) == 0;
+    for (size_t k = 0; ok && k < parts.size(); k++) {
+        const char* p = static_cast<const char*>(parts[k].data);
+        size_t bytes = parts[k].bytes;
+        uint64_t offset = parts[k].offset;
+        while (ok && bytes > 0) {
+            ssize_t n = pwrite(fd, p, bytes, off_t(offset));
+            ok = n > 0;
+            if (!ok) break;
+            p += n;
+            bytes -= size_t(n);
+            offset += uint64_t(n);
+        }
+    }
+    if (fd >= 0) {
+        ok = fsync(fd) == 0 && ok;
+        ok = ::close(fd) == 0 && ok;
+    }
+    if (!ok || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "ERROR: cannot write " << path << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+inline bool readManifest(const std::string& path, std::vector<ChainEntry>& entries) {
+    entries.clear();
+    std::ifstream in(path);
+    std::string magic;
+    int version = 0;
+    if (!(in >> magic >> version) || magic != ChainMagic || version != int(Version)) {
+        std::cerr << "ERROR: " << path << " is not a checkpoint chain" << std::endl;
+        return false;
+    }
+    std::string kind;
+    ChainEntry e;
+    while (in >> kind >> e.step >> e.file) {
+        if (kind != "full" && kind != "delta") {
+            std::cerr << "ERROR: unknown entry " << kind << " in " << path << std::endl;
+            return false;
+        }
+        e.keyframe = kind == "full";
+        entries.push_back(e);
+    }
+    return true;
+}
+
+inline bool writeManifest(const std::string& path, const std::vector<ChainEntry>& entries) {
+    std::ostringstream out;
+    out << ChainMagic << " " << Version << "\n";
+    for (const ChainEntry& e : entries) out << (e.keyframe ? "full " : "delta ") << e.step << " " << e.file << "\n";
+    std::string text = out.str();
+    return writeAtomically(path, text.size(), {{0, text.data(), text.size()}});
+}
+
+// Read-only mapping of a delta file; records stay valid until close().
+class DeltaReader {
+private:
+    int fd = -1;
+    void* base = MAP_FAILED;
+    size_t size = 0;
+
+public:
+    DeltaReader() = default;
+    DeltaReader(const DeltaReader&) = delete;
+    DeltaReader& operator=(const DeltaReader&) = delete;
+    ~DeltaReader() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        fd = ::open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd >= 0 && fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(DeltaHeader)) {
+            size = size_t(st.st_size);
+            base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        if (base == MAP_FAILED) {
+            std::cerr << "ERROR: cannot map checkpoint delta " << path << std::endl;
+            close();
+            return false;
+        }
+
+        const DeltaHeader& h = header();
+        const Header& b = h.base;
+        uint64_t elements = uint64_t(h.tileSize) * h.tileSize * b.q;
+        bool valid = std::memcmp(h.magic, DeltaMagic, sizeof(DeltaMagic)) == 0 && h.version == Version &&
+                     b.q > 0 && b.q <= uint32_t(MaxQ) && b.precision <= uint32_t(Precision::Float16Deviation) &&
+                     b.state <= uint32_t(State::Swapped) && h.tileSize > 0 &&
+                     h.tilesX == (b.nx * b.nz + h.tileSize - 1) / h.tileSize &&
+                     h.tilesY == (b.ny + h.tileSize - 1) / h.tileSize &&
+                     h.recordBytes == elements * elementBytes(Precision(b.precision)) &&
+                     h.headerBytes + uint64_t(h.tileCount) * sizeof(uint32_t) <= h.dataOffset &&
+                     h.dataOffset + h.recordBytes * h.tileCount <= size;
+        for (uint32_t k = 0; valid && k < h.tileCount; k++) valid = tileId(int(k)) < h.tilesX * h.tilesY;
+        if (!valid) {
+            std::cerr << "ERROR: " << path << " is not a valid checkpoint delta" << std::endl;
+            close();
+            return false;
+        }
+        madvise(base, size, MADV_SEQUENTIAL);
+        return true;
+    }
+
+    const DeltaHeader& header() const { return *static_cast<const DeltaHeader*>(base); }
+
+    uint32_t tileId(int k) const {
+        const char* ids = static_cast<const char*>(base) + header().headerBytes;
+        uint32_t id;
+        std::memcpy(&id, ids + sizeof(uint32_t) * size_t(k), sizeof(id));
+        return id;
+    }
+
+    // rows of plane i of the k-th tile, packed at the tile's actual width
+    const void* tilePlane(int k, int i) const {
+        const DeltaHeader& h = header();
+        size_t planeBytes = size_t(h.tileSize) * h.tileSize * elementBytes(Precision(h.base.precision));
+        return static_cast<const char*>(base) + h.dataOffset + h.recordBytes * uint64_t(k) + planeBytes * size_t(i);
+    }
+
+    void close() {
+        if (base != MAP_FAILED) munmap(base, size);
+        base = MAP_FAILED;
+        size = 0;
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+};
+
+// step of the entry the delta at path was taken against
+inline bool deltaParent(const std::string& path, long long& parentStep) {
+    DeltaReader delta;
+    if (!delta.open(path)) return false;
+    parentStep = delta.header().parentStep;
+    return true;
+}
+
+// The files that rebuild the newest state of a chain: the keyframe and the
+// deltas that newest entry descends from, oldest first, as paths usable from
+// the current directory.
+inline bool resolveChain(const std::string& manifest, std::string& keyframe, std::vector<std::string>& deltas) {
+    std::vector<ChainEntry> entries;
+    if (!readManifest(manifest, entries)) return false;
+    std::string dir = chainDirectory(manifest);
+    keyframe.clear();
+    deltas.clear();
+    if (entries.empty()) {
+        std::cerr << "ERROR: checkpoint chain " << manifest << " has no keyframe" << std::endl;
+        return false;
+    }
+    size_t k = entries.size() - 1;
+    while (!entries[k].keyframe) {
+        std::string path = dir + entries[k].file;
+        long long parent = 0;
+        if (!deltaParent(path, parent)) return false;
+        deltas.push_back(path);
+        size_t j = k;
+        while (j > 0 && entries[j - 1].step != parent) j--;
+        if (j == 0) {
+            std::cerr << "ERROR: " << path << " continues step " << parent << ", which " << manifest
+                      << " does not hold" << std::endl;
+            return false;
+        }
+        k = j - 1;
+    }
+    keyframe = dir + entries[k].file;
+    std::reverse(deltas.begin(), deltas.end());
+    return true;
+}
+
+// Copies the tiles of a delta into q planes of the delta's layout; plane i
+// of the file lands in planes[map(i)].
+template <typename Map>
+inline void applyDelta(ThreadPool& pool, const DeltaReader& delta, char* const* planes, Map&& map) {
+    const DeltaHeader& h = delta.header();
+    TileGrid grid(int(h.tileSize), h.base);
+    size_t elem = elementBytes(Precision(h.base.precision));
+    pool.parallelFor(0, int(h.tileCount), [&](int k0, int k1) {
+        for (int k = k0; k < k1; k++) {
+            int x0, x1, y0, y1;
+            grid.bounds(int(delta.tileId(k)), x0, x1, y0, y1);
+            size_t row = size_t(x1 - x0) * elem;
+            for (int i = 0; i < int(h.base.q); i++) {
+                const char* src = static_cast<const char*>(delta.tilePlane(k, i));
+                char* dst = planes[map(i)];
+                for (int y = y0; y < y1; y++, src += row) {
+                    std::memcpy(dst + (size_t(y) * grid.width + x0) * elem, src, row);
+                }
+            }
+        }
+    });
+}
+
+// Appends checkpoints of one lattice to a chain.
+class ChainWriter {
+private:
+    std::string prefix;
+    std::string manifest;
+    int tileSize = 64;
+    float threshold = 0.0f;
+    int keyframeEvery = 16;
+    std::vector<ChainEntry> entries;
+
+    // the newest entry of one population state, the parent of its next delta
+    struct Lineage {
+        Header last{};
+        std::vector<char> shadow;  // its planes, packed back to back
+        int deltasSinceKeyframe = 0;
+    };
+    Lineage lineages[3];        // indexed by State
+    std::vector<uint8_t> changed;
+    std::vector<char> records;
+
+    // true when any population of tile t differs from the shadow by more
+    // than the threshold
+    template <typename T>
+    bool tileChanged(const std::vector<char>& shadow, const TileGrid& grid, int t, const void* const* planes, int q,
+                     size_t planeElements) const {
+        int x0, x1, y0, y1;
+        grid.bounds(t, x0, x1, y0, y1);
+        size_t n = size_t(x1 - x0);
+        for (int i = 0; i < q; i++) {
+            const T* now = static_cast<const T*>(planes[i]);
+            const T* then = reinterpret_cast<const T*>(shadow.data()) + planeElements * size_t(i);
+            for (int y = y0; y < y1; y++) {
+                size_t c = size_t(y) * grid.width + x0;
+                if (std::memcmp(now + c, then + c, n * sizeof(T)) == 0) continue;
+                for (size_t k = c; k < c + n; k++) {
+                    float a, b;
+                    if (std::is_same<T, float>::value) {
+                        a = float(now[k]);
+                        b = float(then[k]);
+                    } else {
+                        a = half_float::toFloat(uint16_t(now[k]));
+                        b = half_float::toFloat(uint16_t(then[k]));
+                    }
+                    if (!(std::fabs(a - b) <= threshold)) return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    static bool sameLayout(const Header& a, const Header& b) {
+        return a.q == b.q && a.nx == b.nx && a.ny == b.ny && a.nz == b.nz && a.precision == b.precision &&
+               std::memcmp(a.bias, b.bias, sizeof(a.bias)) == 0;
+    }
+
+    bool compatible(const Header& h) const {
+        const Lineage& l = lineages[h.state];
+        return !entries.empty() && !l.shadow.empty() && sameLayout(h, l.last) && h.step > l.last.step;
+    }
+
+public:
+    // a delta that would hold more than this fraction of the tiles is
+    // written as a keyframe instead
+    static constexpr float KeyframeFraction = 0.5f;
+
+    // Opens prefix.chain for appending, or starts it. The first save of a
+    // writer is always a keyframe: the chain so far may not hold what the
+    // caller resumed from.
+    bool open(const std::string& chainPrefix, int tile, float maxChange, int keyframeInterval) {
+        prefix = chainPrefix;
+        manifest = prefix + ".chain";
+        tileSize = std::max(tile, 1);
+        threshold = std::max(maxChange, 0.0f);
+        keyframeEvery = std::max(keyframeInterval, 1);
+        entries.clear();
+        for (Lineage& l : lineages) l = Lineage();
+        struct stat st;
+        if (stat(manifest.c_str(), &st) == 0) return readManifest(manifest, entries);
+        return true;
+    }
+
+    const std::string& manifestPath() const { return manifest; }
+
+    // Adds the lattice described by h, with plane i at planes[i] (stored
+    // elements, rows of nx * nz), as a keyframe or a delta.
+    bool save(ThreadPool& pool, const Header& h, const void* const* planes, ChainStats* stats = nullptr) {
+        if (h.state > uint32_t(State::Swapped)) {
+            std::cerr << "ERROR: unknown population state " << h.state << " for " << manifest << std::endl;
+            return false;
+        }
+        TileGrid grid(tileSize, h);
+        int q = int(h.q);
+        size_t elem = elementBytes(Precision(h.precision));
+        size_t planeElements = size_t(grid.width) * grid.height;
+        size_t planeBytes = planeElements * elem;
+
+        // entries at or past this step belong to a run we were rewound from;
+        // their files go once the manifest no longer lists them
+        std::vector<ChainEntry> rewound;
+        while (!entries.empty() && entries.back().step >= h.step) {
+            rewound.push_back(entries.back());
+            entries.pop_back();
+        }
+        for (Lineage& l : lineages) {
+            if (!l.shadow.empty() && (l.last.step >= h.step || !sameLayout(h, l.last))) l = Lineage();
+        }
+
+        Lineage& lineage = lineages[h.state];
+        std::vector<char>& shadow = lineage.shadow;
+        bool keyframe = !compatible(h) || lineage.deltasSinceKeyframe + 1 >= keyframeEvery;
+        int count = 0;
+        if (!keyframe) {
+            changed.assign(size_t(grid.count()), 0);
+            pool.parallelFor(0, grid.count(), [&](int t0, int t1) {
+                for (int t = t0; t < t1; t++) {
+                    changed[size_t(t)] = elem == sizeof(float)
+                                             ? tileChanged<float>(shadow, grid, t, planes, q, planeElements)
+                                             : tileChanged<uint16_t>(shadow, grid, t, planes, q, planeElements);
+                }
+            });
+            count = int(std::count(changed.begin(), changed.end(), uint8_t(1)));
+            keyframe = count > KeyframeFraction * grid.count();
+        }
+
+        std::string path = chainEntryPath(prefix, h.step, keyframe);
+        uint64_t bytes = 0;
+        if (keyframe) {
+            Writer file;
+            if (!file.open(path, h)) return false;
+            for (int i = 0; i < q; i++) {
+                if (!file.writePlane(i, planes[i])) return false;
+            }
+            if (!file.commit()) return false;
+            shadow.resize(planeBytes * size_t(q));
+            pool.parallelFor(0, q, [&](int i0, int i1) {
+                for (int i = i0; i < i1; i++) std::memcpy(shadow.data() + planeBytes * size_t(i), planes[i], planeBytes);
+            });
+            bytes = fileBytes(h);
+            count = grid.count();
+            lineage.deltasSinceKeyframe = 0;
+        } else {
+            std::vector<uint32_t> ids;
+            for (int t = 0; t < grid.count(); t++) {
+                if (changed[size_t(t)]) ids.push_back(uint32_t(t));
+            }
+            DeltaHeader d;
+            std::memset(&d, 0, sizeof(d));
+            std::memcpy(d.magic, DeltaMagic, sizeof(DeltaMagic));
+            d.version = Version;
+            d.headerBytes = uint32_t(PageBytes);
+            d.base = h;
+            d.parentStep = lineage.last.step;
+            d.tileSize = uint32_t(tileSize);
+            d.tilesX = uint32_t(grid.tilesX);
+            d.tilesY = uint32_t(grid.tilesY);
+            d.tileCount = uint32_t(ids.size());
+            d.dataOffset = PageBytes + roundToPage(ids.size() * sizeof(uint32_t));
+            d.recordBytes = uint64_t(tileSize) * tileSize * q * elem;
+            d.threshold = threshold;
+
+            // gather the tiles into records and into the shadow
+            records.assign(size_t(d.recordBytes) * ids.size(), 0);
+            size_t tilePlaneBytes = size_t(tileSize) * tileSize * elem;
+            pool.parallelFor(0, int(ids.size()), [&](int k0, int k1) {
+                for (int k = k0; k < k1; k++) {
+                    int x0, x1, y0, y1;
+                    grid.bounds(int(ids[size_t(k)]), x0, x1, y0, y1);
+                    size_t row = size_t(x1 - x0) * elem;
+                    for (int i = 0; i < q; i++) {
+                        char* dst = records.data() + size_t(d.recordBytes) * size_t(k) + tilePlaneBytes * size_t(i);
+                        const char* src = static_cast<const char*>(planes[i]);
+                        char* copy = shadow.data() + planeBytes * size_t(i);
+                        for (int y = y0; y < y1; y++, dst += row) {
+                            size_t offset = (size_t(y) * grid.width + x0) * elem;
+                            std::memcpy(dst, src + offset, row);
+                            std::memcpy(copy + offset, src + offset, row);
+                        }
+                    }
+                }
+            });
+            bytes = d.dataOffset + records.size();
+            if (!writeAtomically(path, bytes, {{0, &d, sizeof(d)},
+                                        {PageBytes, ids.data(), ids.size() * sizeof(uint32_t)},
+                                        {d.dataOffset, records.data(), records.size()}})) {
+                return false;
+            }
+            lineage.deltasSinceKeyframe++;
+        }
+
+        entries.push_back({keyframe, h.step, chainFileName(path)});
+        if (!writeManifest(manifest, entries)) return false;
+        std::string dir = chainDirectory(manifest);
+        for (const ChainEntry& e : rewound) {
+            if (e.file != entries.back().file) std::remove((dir + e.file).c_str());
+        }
+        lineage.last = h;
+        if (stats) {
+            stats->keyframe = keyframe;
+            stats->tiles = grid.count();
+            stats->tilesWritten = count;
+            stats->bytes = bytes;
+            stats->fullBytes = fileBytes(h);
+        }
+        return true;
+    }
+};
+
+// Folds the newest keyframe of a chain and the deltas after it into one
+// keyframe, makes it the chain's only entry and deletes the files of all
+// the others. One plane is rebuilt in memory at a time.
+inline bool compactChain(const std::string& manifest, std::string* keyframePath = nullptr) {
+    std::vector<ChainEntry> entries;
+    std::string keyframe;
+    std::vector<std::string> deltas;
+    if (!readManifest(manifest, entries) || !resolveChain(manifest, keyframe, deltas)) return false;
+
+    Reader key;
+    if (!key.open(keyframe)) return false;
+    Header h = key.header();
+    std::vector<DeltaReader> files(deltas.size());
+    for (size_t k = 0; k < deltas.size(); k++) {
+        if (!files[k].open(deltas[k])) return false;
+        const Header& b = files[k].header().base;
+        if (b.q != h.q || b.nx != h.nx || b.ny != h.ny || b.nz != h.nz || b.precision != h.precision ||
+            b.state != h.state) {
+            std::cerr << "ERROR: " << deltas[k] << " does not continue " << keyframe << std::endl;
+            return false;
+        }
+        h.step = b.step;
+    }
+
+    std::string dir = chainDirectory(manifest);
+    std::string prefix = manifest.substr(0, manifest.size() - std::strlen(".chain"));
+    std::string path = chainEntryPath(prefix, h.step, true);
+    if (!deltas.empty()) {
+        Writer out;
+        if (!out.open(path, h)) return false;
+        size_t planeBytes = size_t(h.nx) * h.ny * h.nz * elementBytes(Precision(h.precision));
+        size_t elem = elementBytes(Precision(h.precision));
+        std::vector<char> plane(planeBytes);
+        for (int i = 0; i < int(h.q); i++) {
+            std::memcpy(plane.data(), key.plane(i), planeBytes);
+            for (const DeltaReader& delta : files) {
+                const DeltaHeader& d = delta.header();
+                TileGrid grid(int(d.tileSize), d.base);
+                for (uint32_t k = 0; k < d.tileCount; k++) {
+                    int x0, x1, y0, y1;
+                    grid.bounds(int(delta.tileId(int(k))), x0, x1, y0, y1);
+                    size_t row = size_t(x1 - x0) * elem;
+                    const char* src = static_cast<const char*>(delta.tilePlane(int(k), i));
+                    for (int y = y0; y < y1; y++, src += row) {
+                        std::memcpy(plane.data() + (size_t(y) * grid.width + x0) * elem, src, row);
+                    }
+                }
+            }
+            if (!out.writePlane(i, plane.data())) return false;
+        }
+        if (!out.commit()) return false;
+    }
+
+    std::string name = chainFileName(path);
+    if (!writeManifest(manifest, {{true, h.step, name}})) return false;
+    for (const ChainEntry& e : entries) {
+        if (e.file != name) std::remove((dir + e.file).c_str());
+    }
+    if (keyframePath) *keyframePath = path;
+    return true;
+}
+
+}  // namespace checkpoint
+
+#endif
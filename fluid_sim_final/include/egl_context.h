@@ -0,0 +1,133 @@
+#ifndef EGL_CONTEXT_H
+#define EGL_CONTEXT_H
+
+#include <glad/glad.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <cstring>
+#include <iostream>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+// Offscreen GL context through EGL, for runs without a window system
+// (containers, CI, Mesa llvmpipe). Takes the surfaceless platform when the
+// driver offers it, otherwise the default display with a 1x1 pbuffer. There
+// is no default framebuffer to present to, so nothing swaps and nothing
+// waits on vsync: the simulation passes render to their own FBOs anyway.
+// Replaces gl.init() + window.create(); GL entry points are loaded through
+// glad from eglGetProcAddress.
+// fluid_sim_final and fluid_sim_glsl each build standalone against their own
+// lib/, so both keep this header; keep the two copies identical.
+class EGLHeadlessContext {
+private:
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    static bool hasExtension(const char* list, const char* name) {
+        if (!list) return false;
+        size_t n = std::strlen(name);
+        for (const char* p = std::strstr(list, name); p; p = std::strstr(p + n, name)) {
+            if ((p == list || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0')) return true;
+        }
+        return false;
+    }
+
+    EGLContext createCore(EGLConfig config, int major, int minor) {
+        const EGLint attribs[] = {
+            EGL_CONTEXT_MAJOR_VERSION, major,
+            EGL_CONTEXT_MINOR_VERSION, minor,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        return eglCreateContext(display, config, EGL_NO_CONTEXT, attribs);
+    }
+
+public:
+    // Core profile major.minor, or 3.3 (what every shader needs) when the
+    // driver refuses it. The context is current on return.
+    bool create(int major, int minor) {
+        const char* clientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+        if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+                eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            if (getPlatformDisplay) {
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            }
+        }
+        if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr)) {
+            std::cerr << "ERROR: no EGL display available" << std::endl;
+            return false;
+        }
+        if (!eglBindAPI(EGL_OPENGL_API)) {
+            std::cerr << "ERROR: EGL display has no desktop OpenGL" << std::endl;
+            return false;
+        }
+
+        // surfaceless needs no config at all; otherwise a pbuffer-capable one
+        const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+        bool surfaceless = hasExtension(extensions, "EGL_KHR_surfaceless_context");
+        EGLConfig config = nullptr;
+        if (!surfaceless || !hasExtension(extensions, "EGL_KHR_no_config_context")) {
+            const EGLint configAttribs[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+                EGL_NONE
+            };
+            EGLint count = 0;
+            if (!eglChooseConfig(display, configAttribs, &config, 1, &count) || count == 0) {
+                std::cerr << "ERROR: no pbuffer-capable EGL config" << std::endl;
+                return false;
+            }
+        }
+
+        context = createCore(config, major, minor);
+        if (context == EGL_NO_CONTEXT && (major > 3 || (major == 3 && minor > 3))) {
+            std::cerr << "WARNING: no GL " << major << "." << minor << " context, trying 3.3" << std::endl;
+            context = createCore(config, 3, 3);
+        }
+        if (context == EGL_NO_CONTEXT) {
+            std::cerr << "ERROR: EGL context creation failed (0x" << std::hex << eglGetError()
+                      << std::dec << ")" << std::endl;
+            return false;
+        }
+
+        if (!surfaceless) {
+            const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+            surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+            if (surface == EGL_NO_SURFACE) {
+                std::cerr << "ERROR: EGL pbuffer creation failed" << std::endl;
+                return false;
+            }
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            std::cerr << "ERROR: eglMakeCurrent failed" << std::endl;
+            return false;
+        }
+        if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(eglGetProcAddress))) {
+            std::cerr << "ERROR: failed to load GL functions" << std::endl;
+            return false;
+        }
+
+        std::cout << "✓ Headless EGL context (" << (surfaceless ? "surfaceless" : "pbuffer") << "): "
+                  << glGetString(GL_RENDERER) << ", GL " << glGetString(GL_VERSION) << std::endl;
+        return true;
+    }
+
+    void destroy() {
+        if (display == EGL_NO_DISPLAY) return;
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        if (context != EGL_NO_CONTEXT) eglDestroyContext(display, context);
+        eglTerminate(display);
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+        surface = EGL_NO_SURFACE;
+    }
+};
+
+#endif
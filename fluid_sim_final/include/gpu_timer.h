@@ -0,0 +1,297 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <glad/glad.h>
+#include <roofline.h>
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Per-pass GPU times from GL_TIME_ELAPSED queries.
+//
+// Every named section (one per pass) owns a small ring of query objects, so
+// a frame issues its queries while earlier frames' results are still in
+// flight. collect() once per frame takes whatever results are available and
+// never waits; a section whose ring is full skips timing for that frame
+// instead of stalling. Elapsed queries cannot nest: begin() and end() pair up
+// around one pass at a time.
+//
+// report() and write() turn the samples into per-pass percentiles, and MLUPS
+// (million lattice updates per second) for sections that update the lattice.
+// Sections with declared traffic (setTraffic, see roofline.h) also get their
+// achieved GB/s, and its share of setPeakBandwidth() once that is known.
+class GpuTimers {
+public:
+    struct Stats {
+        std::string name;
+        size_t count = 0;
+        double mean = 0, p50 = 0, p90 = 0, p99 = 0, max = 0;  // milliseconds
+        double mlups = 0;  // 0 for sections that do not update the lattice
+        double gbps = 0;   // 0 without declared traffic
+        double peakPercent = 0;  // 0 without a peak bandwidth
+        bool total = false;  // the "step" row: mean and MLUPS only
+    };
+
+private:
+    static constexpr int Depth = 4;  // frames of results that may be in flight
+
+    struct Section {
+        std::string name;
+        bool latticeUpdate = true;
+        double bytes = 0;  // per cell and run
+        GLuint queries[Depth] = {};
+        int next = 0;      // slot of the next begin()
+        int oldest = 0;    // oldest slot in flight
+        int inFlight = 0;
+        size_t runs = 0;   // begin() calls, timed or not
+        size_t skipped = 0;
+        std::vector<double> samples;  // milliseconds, in frame order
+    };
+
+    std::vector<Section> sections;
+    int active = -1;  // section between begin() and end()
+    double peakBandwidth = 0;  // GB/s
+
+    int find(const std::string& name) const {
+        for (size_t i = 0; i < sections.size(); i++) {
+            if (sections[i].name == name) return int(i);
+        }
+        return -1;
+    }
+
+    // result of the oldest query of s; returns false if not ready and !wait
+    static bool take(Section& s, bool wait) {
+        GLuint query = s.queries[s.oldest];
+        if (!wait) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return false;
+        }
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+        s.samples.push_back(double(ns) * 1e-6);
+        s.oldest = (s.oldest + 1) % Depth;
+        s.inFlight--;
+        return true;
+    }
+
+    static double percentile(const std::vector<double>& sorted, double p) {
+        size_t rank = size_t(p * double(sorted.size() - 1) + 0.5);  // nearest rank
+        return sorted[std::min(rank, sorted.size() - 1)];
+    }
+
+public:
+    // Declares a section ahead of use, e.g. to mark display passes that do
+    // not update the lattice. Unknown names passed to begin() are created
+    // on the fly as lattice sections.
+    void addSection(const std::string& name, bool latticeUpdate) {
+        int i = find(name);
+        if (i < 0) {
+            sections.emplace_back();
+            i = int(sections.size() - 1);
+            sections[i].name = name;
+            glGenQueries(Depth, sections[i].queries);
+        }
+        sections[i].latticeUpdate = latticeUpdate;
+    }
+
+    // bytes per cell one run of the section moves
+    void setTraffic(const std::string& name, double bytesPerCell) {
+        int i = find(name);
+        if (i < 0) {
+            addSection(name, true);
+            i = int(sections.size() - 1);
+        }
+        sections[i].bytes = bytesPerCell;
+    }
+
+    // GB/s the achieved bandwidths are reported against, e.g. from a STREAM probe
+    void setPeakBandwidth(double gbps) { peakBandwidth = gbps; }
+
+    void begin(const std::string& name) {
+        int i = find(name);
+        if (i < 0) {
+            addSection(name, true);
+            i = int(sections.size() - 1);
+        }
+        Section& s = sections[i];
+        s.runs++;
+        if (s.inFlight == Depth) {
+            s.skipped++;
+            return;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, s.queries[s.next]);
+        active = i;
+    }
+
+    void end() {
+        if (active < 0) return;
+        Section& s = sections[active];
+        glEndQuery(GL_TIME_ELAPSED);
+        s.next = (s.next + 1) % Depth;
+        s.inFlight++;
+        active = -1;
+    }
+
+    // takes the results that are ready; call once per frame
+    void collect() {
+        for (Section& s : sections) {
+            while (s.inFlight > 0 && take(s, false)) {}
+        }
+    }
+
+    // waits for every query in flight (at exit, before the report)
+    void finish() {
+        for (Section& s : sections) {
+            while (s.inFlight > 0) take(s, true);
+        }
+    }
+
+    // Per-section statistics in declaration order, followed by a "step" row:
+    // the summed lattice-section time over `steps` steps of `cells` cells.
+    std::vector<Stats> stats(size_t cells, size_t steps) const {
+        std::vector<Stats> out;
+        double latticeTotal = 0;
+        double latticeBytes = 0;  // per cell over all steps
+        for (const Section& s : sections) {
+            if (s.samples.empty()) continue;
+            std::vector<double> sorted = s.samples;
+            std::sort(sorted.begin(), sorted.end());
+            Stats st;
+            st.name = s.name;
+            st.count = sorted.size();
+            double sum = 0;
+            for (double t : sorted) sum += t;
+            st.mean = sum / double(sorted.size());
+            st.p50 = percentile(sorted, 0.50);
+            st.p90 = percentile(sorted, 0.90);
+            st.p99 = percentile(sorted, 0.99);
+            st.max = sorted.back();
+            if (s.latticeUpdate && st.mean > 0) {
+                st.mlups = double(cells) / (st.mean * 1e-3) * 1e-6;
+                // every run counts, timed or not (skipped, or a pass that
+                // only runs on some steps)
+                latticeTotal += st.mean * double(s.runs);
+                latticeBytes += s.bytes * double(s.runs);
+            }
+            if (s.bytes > 0 && st.mean > 0) {
+                st.gbps = achievedBandwidth(s.bytes, double(cells), st.mean * 1e-3);
+                if (peakBandwidth > 0) st.peakPercent = st.gbps / peakBandwidth * 100.0;
+            }
+            out.push_back(st);
+        }
+        if (latticeTotal > 0 && steps > 0) {
+            Stats step;
+            step.name = "step";
+            step.count = steps;
+            step.total = true;
+            step.mean = latticeTotal / double(steps);
+            step.mlups = double(cells) / (step.mean * 1e-3) * 1e-6;
+            step.gbps = achievedBandwidth(latticeBytes / double(steps), double(cells), step.mean * 1e-3);
+            if (peakBandwidth > 0) step.peakPercent = step.gbps / peakBandwidth * 100.0;
+            out.push_back(step);
+        }
+        return out;
+    }
+
+    size_t skipped() const {
+        size_t n = 0;
+        for (const Section& s : sections) n += s.skipped;
+        return n;
+    }
+
+    bool hasTraffic() const {
+        for (const Section& s : sections) {
+            if (s.bytes > 0) return true;
+        }
+        return false;
+    }
+
+    void report(size_t cells, size_t steps) const {
+        std::vector<Stats> all = stats(cells, steps);
+        if (all.empty()) return;
+        std::cout << "=== GPU Pass Timings (ms) ===" << std::endl;
+        std::cout << std::left << std::setw(12) << "pass" << std::right
+                  << std::setw(8) << "count" << std::setw(9) << "mean" << std::setw(9) << "p50"
+                  << std::setw(9) << "p90" << std::setw(9) << "p99" << std::setw(9) << "max"
+                  << std::setw(10) << "MLUPS";
+        bool traffic = hasTraffic();
+        if (traffic) std::cout << std::setw(9) << "GB/s" << std::setw(9) << "% peak";
+        std::cout << std::endl;
+        for (const Stats& s : all) {
+            std::cout << std::left << std::setw(12) << s.name << std::right << std::fixed
+                      << std::setw(8) << s.count << std::setprecision(4) << std::setw(9) << s.mean;
+            if (s.total) {
+                std::cout << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-" << std::setw(9) << "-";
+            } else {
+                std::cout << std::setw(9) << s.p50 << std::setw(9) << s.p90 << std::setw(9) << s.p99
+                          << std::setw(9) << s.max;
+            }
+            std::cout << std::setprecision(1) << std::setw(10) << s.mlups;
+            if (traffic) {
+                std::cout << std::setw(9) << s.gbps;
+                if (s.peakPercent > 0) std::cout << std::setw(9) << s.peakPercent;
+                else std::cout << std::setw(9) << "-";
+            }
+            std::cout << std::endl;
+        }
+        if (traffic && peakBandwidth > 0) {
+            std::cout << "(% peak of " << std::setprecision(1) << peakBandwidth << " GB/s)" << std::endl;
+        }
+        if (skipped() > 0) {
+            std::cout << "(" << skipped() << " pass timings skipped while results were in flight)" << std::endl;
+        }
+    }
+
+    // CSV, or JSON when path ends in .json
+    bool write(const std::string& path, size_t cells, size_t steps) const {
+        std::ofstream out(path);
+        if (!out) {
+            std::cerr << "ERROR: cannot write timings to " << path << std::endl;
+            return false;
+        }
+        std::vector<Stats> all = stats(cells, steps);
+        bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+        out << std::setprecision(6);
+        if (json) {
+            out << "{\n  \"cells\": " << cells << ",\n  \"steps\": " << steps;
+            if (peakBandwidth > 0) out << ",\n  \"peak_gbps\": " << peakBandwidth;
+            out << ",\n  \"passes\": [\n";
+            for (size_t i = 0; i < all.size(); i++) {
+                const Stats& s = all[i];
+                out << "    {\"name\": \"" << s.name << "\", \"count\": " << s.count
+                    << ", \"mean_ms\": " << s.mean;
+                if (!s.total) {
+                    out << ", \"p50_ms\": " << s.p50 << ", \"p90_ms\": " << s.p90
+                        << ", \"p99_ms\": " << s.p99 << ", \"max_ms\": " << s.max;
+                }
+                out << ", \"mlups\": " << s.mlups;
+                if (s.gbps > 0) out << ", \"gbps\": " << s.gbps;
+                if (s.peakPercent > 0) out << ", \"peak_percent\": " << s.peakPercent;
+                out << "}" << (i + 1 < all.size() ? ",\n" : "\n");
+            }
+            out << "  ]\n}\n";
+        } else {
+            out << "pass,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms,mlups,gbps,peak_percent\n";
+            for (const Stats& s : all) {
+                out << s.name << ',' << s.count << ',' << s.mean << ',';
+                if (!s.total) out << s.p50 << ',' << s.p90 << ',' << s.p99 << ',' << s.max;
+                else out << ",,,";
+                out << ',' << s.mlups << ',' << s.gbps << ',' << s.peakPercent << '\n';
+            }
+        }
+        return true;
+    }
+
+    void destroy() {
+        for (Section& s : sections) glDeleteQueries(Depth, s.queries);
+        sections.clear();
+        active = -1;
+    }
+};
+
+#endif
@@ -0,0 +1,142 @@
+#ifndef HALF_FLOAT_H
+#define HALF_FLOAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HALF_FLOAT_X86 1
+#include <immintrin.h>
+#endif
+
+// IEEE 754 binary16 storage for population planes. Values are only stored as
+// half; every kernel converts a row to float, computes, and converts back.
+// Rows are converted with F16C when the CPU has it, otherwise in software.
+// The row converters take a bias: stored = value - bias, value = stored + bias,
+// so a plane can hold deviations from a known offset.
+
+namespace half_float {
+
+// round to nearest even, overflow to infinity, keeps NaN
+inline uint16_t fromFloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    uint32_t magnitude = bits & 0x7fffffffu;
+
+    if (magnitude >= 0x7f800000u) {  // inf or NaN
+        return uint16_t(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+    }
+    if (magnitude >= 0x477ff000u) return uint16_t(sign | 0x7c00u);  // rounds past 65504
+    if (magnitude < 0x38800000u) {  // subnormal half or zero
+        if (magnitude < 0x33000000u) return uint16_t(sign);
+        uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+        int shift = 126 - int(magnitude >> 23);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1u);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1u))) half++;
+        return uint16_t(sign | half);
+    }
+    uint32_t half = ((magnitude - 0x38000000u) >> 13);
+    uint32_t rest = magnitude & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u))) half++;
+    return uint16_t(sign | half);
+}
+
+inline float toFloat(uint16_t value) {
+    uint32_t sign = uint32_t(value & 0x8000u) << 16;
+    uint32_t exponent = (value >> 10) & 0x1fu;
+    uint32_t mantissa = value & 0x3ffu;
+    uint32_t bits;
+
+    if (exponent == 0x1fu) {
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    } else if (exponent != 0) {
+        bits = sign | ((exponent + 112u) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        bits = sign;
+    } else {  // subnormal: normalize
+        int shift = 0;
+        while (!(mantissa & 0x400u)) {
+            mantissa <<= 1;
+            shift++;
+        }
+        bits = sign | (uint32_t(113 - shift) << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+inline void toFloatRow_Scalar(const uint16_t* src, float* dst, std::size_t n, float bias) {
+    for (std::size_t i = 0; i < n; i++) dst[i] = toFloat(src[i]) + bias;
+}
+
+inline void fromFloatRow_Scalar(const float* src, uint16_t* dst, std::size_t n, float bias) {
+    for (std::size_t i = 0; i < n; i++) dst[i] = fromFloat(src[i] - bias);
+}
+
+#ifdef HALF_FLOAT_X86
+
+__attribute__((target("avx,f16c")))
+inline void toFloatRow_F16C(const uint16_t* src, float* dst, std::size_t n, float bias) {
+    const __m256 b = _mm256_set1_ps(bias);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_cvtph_ps(h), b));
+    }
+    toFloatRow_Scalar(src + i, dst + i, n - i, bias);
+}
+
+__attribute__((target("avx,f16c")))
+inline void fromFloatRow_F16C(const float* src, uint16_t* dst, std::size_t n, float bias) {
+    const __m256 b = _mm256_set1_ps(bias);
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_sub_ps(_mm256_loadu_ps(src + i), b);
+        __m128i h = _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), h);
+    }
+    fromFloatRow_Scalar(src + i, dst + i, n - i, bias);
+}
+
+#endif // HALF_FLOAT_X86
+
+inline bool hasF16C() {
+#ifdef HALF_FLOAT_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("f16c") && __builtin_cpu_supports("avx");
+#else
+    return false;
+#endif
+}
+
+// row converters picked once for the running CPU
+inline void toFloatRow(const uint16_t* src, float* dst, std::size_t n, float bias = 0.0f) {
+#ifdef HALF_FLOAT_X86
+    static const bool f16c = hasF16C();
+    if (f16c) {
+        toFloatRow_F16C(src, dst, n, bias);
+        return;
+    }
+#endif
+    toFloatRow_Scalar(src, dst, n, bias);
+}
+
+inline void fromFloatRow(const float* src, uint16_t* dst, std::size_t n, float bias = 0.0f) {
+#ifdef HALF_FLOAT_X86
+    static const bool f16c = hasF16C();
+    if (f16c) {
+        fromFloatRow_F16C(src, dst, n, bias);
+        return;
+    }
+#endif
+    fromFloatRow_Scalar(src, dst, n, bias);
+}
+
+} // namespace half_float
+
+#endif
@@ -0,0 +1,161 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+// Compile-time lattice descriptors. A descriptor lists the discrete
+// velocities and weights of a DdQq lattice; kernels templated on it unroll
+// every loop over the populations and drop the terms of zero velocity
+// components at compile time, so swapping lattices is a type change.
+// D2Q9 keeps the population order of the shaders (the e_y = +1 directions
+// first): the CPU engine and GLSL agree on population indices.
+
+// Population rows are separate planes the compiler cannot prove disjoint;
+// this marks cell loops whose rows never overlap so they still vectorize.
+#if defined(__clang__)
+#define LATTICE_INDEPENDENT_CELLS _Pragma("clang loop vectorize(assume_safety)")
+#elif defined(__GNUC__)
+#define LATTICE_INDEPENDENT_CELLS _Pragma("GCC ivdep")
+#else
+#define LATTICE_INDEPENDENT_CELLS
+#endif
+
+// inline every unrolled call into a row kernel; for large Q the compiler
+// otherwise gives up on inlining and the cell loop stays scalar
+#if defined(__GNUC__)
+#define LATTICE_FLATTEN __attribute__((flatten))
+#else
+#define LATTICE_FLATTEN
+#endif
+
+namespace lattice {
+
+// index of the velocity pointing the other way, for bounce-back
+template <size_t Q>
+constexpr std::array<int, Q> opposites(const std::array<int, Q>& cx, const std::array<int, Q>& cy,
+                                       const std::array<int, Q>& cz) {
+    std::array<int, Q> opp{};
+    for (size_t i = 0; i < Q; i++) {
+        for (size_t j = 0; j < Q; j++) {
+            if (cx[j] == -cx[i] && cy[j] == -cy[i] && cz[j] == -cz[i]) opp[i] = int(j);
+        }
+    }
+    return opp;
+}
+
+struct D2Q9 {
+    static constexpr int D = 2;
+    static constexpr int Q = 9;
+    static constexpr const char* name = "D2Q9";
+    static constexpr std::array<int, Q> cx = {-1, 0, 1, -1, 0, 1, -1, 0, 1};
+    static constexpr std::array<int, Q> cy = { 1, 1, 1,  0, 0, 0, -1,-1,-1};
+    static constexpr std::array<int, Q> cz = {};
+    static constexpr std::array<float, Q> w = {
+        1.0f/36.0f, 1.0f/9.0f, 1.0f/36.0f,
+        1.0f/9.0f,  4.0f/9.0f, 1.0f/9.0f,
+        1.0f/36.0f, 1.0f/9.0f, 1.0f/36.0f
+    };
+    static constexpr std::array<int, Q> opp = opposites(cx, cy, cz);
+};
+
+// Five speeds are not isotropic enough for Navier-Stokes; D2Q5 is the lattice
+// for advected scalars (dye, temperature), where only rho matters.
+struct D2Q5 {
+    static constexpr int D = 2;
+    static constexpr int Q = 5;
+    static constexpr const char* name = "D2Q5";
+    static constexpr std::array<int, Q> cx = {0, 1, -1, 0,  0};
+    static constexpr std::array<int, Q> cy = {0, 0,  0, 1, -1};
+    static constexpr std::array<int, Q> cz = {};
+    static constexpr std::array<float, Q> w = {1.0f/3.0f, 1.0f/6.0f, 1.0f/6.0f, 1.0f/6.0f, 1.0f/6.0f};
+    static constexpr std::array<int, Q> opp = opposites(cx, cy, cz);
+};
+
+// rest, 6 faces (1/18) and 12 edges (1/36) of the unit cube
+struct D3Q19 {
+    static constexpr int D = 3;
+    static constexpr int Q = 19;
+    static constexpr const char* name = "D3Q19";
+    static constexpr std::array<int, Q> cx = {0, 1,-1, 0, 0, 0, 0, 1,-1, 1,-1, 1,-1, 1,-1, 0, 0, 0, 0};
+    static constexpr std::array<int, Q> cy = {0, 0, 0, 1,-1, 0, 0, 1,-1,-1, 1, 0, 0, 0, 0, 1,-1, 1,-1};
+    static constexpr std::array<int, Q> cz = {0, 0, 0, 0, 0, 1,-1, 0, 0, 0, 0, 1,-1,-1, 1, 1,-1,-1, 1};
+    static constexpr std::array<float, Q> w = {
+        1.0f/3.0f,
+        1.0f/18.0f, 1.0f/18.0f, 1.0f/18.0f, 1.0f/18.0f, 1.0f/18.0f, 1.0f/18.0f,
+        1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f,
+        1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f, 1.0f/36.0f
+    };
+    static constexpr std::array<int, Q> opp = opposites(cx, cy, cz);
+};
+
+// calls f(std::integral_constant<int, I>) for I = 0 .. N-1, fully unrolled
+template <typename F, int... I>
+inline void unrollImpl(F&& f, std::integer_sequence<int, I...>) {
+    (f(std::integral_constant<int, I>{}), ...);
+}
+
+template <int N, typename F>
+inline void unroll(F&& f) {
+    unrollImpl(f, std::make_integer_sequence<int, N>{});
+}
+
+// c_i . u with the zero components left out
+template <typename L, int I>
+inline float project(float ux, float uy, float uz) {
+    float eu = 0.0f;
+    if constexpr (L::cx[I] != 0) eu += float(L::cx[I]) * ux;
+    if constexpr (L::cy[I] != 0) eu += float(L::cy[I]) * uy;
+    if constexpr (L::cz[I] != 0) eu += float(L::cz[I]) * uz;
+    return eu;
+}
+
+// second-order equilibrium, same form as the shaders' equilibrium()
+template <typename L, int I>
+inline float equilibrium(float rho, float ux, float uy, float uz) {
+    float eu = project<L, I>(ux, uy, uz);
+    float u2 = ux * ux + uy * uy + uz * uz;
+    return L::w[I] * rho * (1.0f + 3.0f * eu + 4.5f * eu * eu - 1.5f * u2);
+}
+
+// density and velocity of one cell
+template <typename L>
+inline void moments(const float* f, float& rho, float& ux, float& uy, float& uz) {
+    float r = 0.0f, jx = 0.0f, jy = 0.0f, jz = 0.0f;
+    unroll<L::Q>([&](auto i) {
+        constexpr int I = decltype(i)::value;
+        r += f[I];
+        if constexpr (L::cx[I] != 0) jx += float(L::cx[I]) * f[I];
+        if constexpr (L::cy[I] != 0) jy += float(L::cy[I]) * f[I];
+        if constexpr (L::cz[I] != 0) jz += float(L::cz[I]) * f[I];
+    });
+    rho = r;
+    ux = jx / r;
+    uy = jy / r;
+    uz = jz / r;
+}
+
+// BGK relaxation of one cell in place
+template <typename L>
+inline void collideBGK(float* f, float omega) {
+    float rho, ux, uy, uz;
+    moments<L>(f, rho, ux, uy, uz);
+    unroll<L::Q>([&](auto i) {
+        constexpr int I = decltype(i)::value;
+        f[I] += (equilibrium<L, I>(rho, ux, uy, uz) - f[I]) * omega;
+    });
+}
+
+// sets a cell to equilibrium
+template <typename L>
+inline void setEquilibrium(float* f, float rho, float ux, float uy, float uz) {
+    unroll<L::Q>([&](auto i) {
+        constexpr int I = decltype(i)::value;
+        f[I] = equilibrium<L, I>(rho, ux, uy, uz);
+    });
+}
+
+} // namespace lattice
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef LBM_COLLISION_H
+#define LBM_COLLISION_H
+
+#include <lbm_simd.h>
+#include <lattice.h>
+#include <cstring>
+
+// Collision operators for the D2Q9 engines. All of them take the
+// CollisionKernel signature of lbm_simd.h, so every scheme, storage format
+// and tiling swaps them in without touching its memory layout; omega = 1/tau
+// sets the shear viscosity in each.
+//
+// BGK relaxes every moment with omega, so as tau approaches 1/2 the
+// non-hydrodynamic moments are barely damped and fast flows blow up.
+// MRT (Lallemand & Luo 2000) relaxes the moments individually: shear with
+// omega, energy, energy square and heat flux with fixed rates, so they stay
+// damped at any viscosity. This is the operator for low-tau runs.
+// TRT relaxes the even part of each (i, opp i) pair with omega and the odd
+// part with omega-, chosen so Lambda = (1/omega - 1/2)(1/omega- - 1/2) = 1/4;
+// steady flows and bounce-back wall positions then no longer depend on tau
+// (3/16 puts walls exactly half-way). It is cheaper than MRT but no more
+// stable than BGK close to tau = 1/2.
+// Neither needs memory beyond BGK. The shaders implement the same operators
+// behind their collisionModel uniform.
+
+enum class CollisionModel { BGK, TRT, MRT };
+
+inline const char* collisionModelName(CollisionModel model) {
+    switch (model) {
+        case CollisionModel::TRT: return "TRT";
+        case CollisionModel::MRT: return "MRT";
+        default: return "BGK";
+    }
+}
+
+// "bgk", "trt" or "mrt"; anything else is BGK
+inline CollisionModel parseCollisionModel(const char* name) {
+    if (name && !std::strcmp(name, "trt")) return CollisionModel::TRT;
+    if (name && !std::strcmp(name, "mrt")) return CollisionModel::MRT;
+    return CollisionModel::BGK;
+}
+
+namespace lbm_collision {
+
+using L = lattice::D2Q9;
+
+constexpr float TRTMagic = 0.25f;
+
+// MRT rates of the non-hydrodynamic moments
+constexpr float RateEnergy = 1.64f;
+constexpr float RateEnergySquare = 1.54f;
+constexpr float RateHeatFlux = 1.9f;
+
+// rows of the Lallemand-Luo moment matrix, built from the velocities so they
+// follow the lattice ordering; the rows are orthogonal with squared norms
+// 36 (energy, energy square), 12 (heat flux) and 4 (stresses)
+template <int I> constexpr float c2 = float(L::cx[I] * L::cx[I] + L::cy[I] * L::cy[I]);
+template <int I> constexpr float momentEnergy = -4.0f + 3.0f * c2<I>;
+template <int I> constexpr float momentEnergySquare = 4.0f - 10.5f * c2<I> + 4.5f * c2<I> * c2<I>;
+template <int I> constexpr float momentHeatX = (-5.0f + 3.0f * c2<I>) * float(L::cx[I]);
+template <int I> constexpr float momentHeatY = (-5.0f + 3.0f * c2<I>) * float(L::cy[I]);
+template <int I> constexpr float momentNormal = float(L::cx[I] * L::cx[I] - L::cy[I] * L::cy[I]);
+template <int I> constexpr float momentShear = float(L::cx[I] * L::cy[I]);
+
+inline void collideTRTCell(float* f, float omega, float omegaMinus) {
+    float rho, ux, uy, uz;
+    lattice::moments<L>(f, rho, ux, uy, uz);
+    float feq[L::Q];
+    lattice::setEquilibrium<L>(feq, rho, ux, uy, uz);
+    float out[L::Q];
+    lattice::unroll<L::Q>([&](auto i) {
+        constexpr int I = decltype(i)::value;
+        constexpr int O = L::opp[I];
+        float even = 0.5f * ((f[I] + f[O]) - (feq[I] + feq[O]));
+        float odd = 0.5f * ((f[I] - f[O]) - (feq[I] - feq[O]));
+        out[I] = f[I] - omega * even - omegaMinus * odd;
+    });
+    lattice::unroll<L::Q>([&](auto i) { f[decltype(i)::value] = out[decltype(i)::value]; });
+}
+
+// density and momentum are conserved and not relaxed; the shear moments
+// relax with omega, the rest with the fixed rates above
+inline void collideMRTCell(float* f, float omega) {
+    float rho = 0.0f, jx = 0.0f, jy = 0.0f;
+    float e = 0.0f, eps = 0.0f, qx = 0.0f, qy = 0.0f, pxx = 0.0f, pxy = 0.0f;
+    lattice::unroll<L::Q>([&](auto i) {
+        constexpr int I = decltype(i)::value;
+        rho += f[I];
+        if constexpr (L::cx[I] != 0) jx += float(L::cx[I]) * f[I];
+        if constexpr (L::cy[I] != 0) jy += float(L::cy[I]) * f[I];
+        e += momentEnergy<I> * f[I];
+        eps += momentEnergySquare<I> * f[I];
+        if constexpr (momentHeatX<I> != 0.0f) qx += momentHeatX<I> * f[I];
+        if constexpr (momentHeatY<I> != 0.0f) qy += momentHeatY<I> * f[I];
+        if constexpr (momentNormal<I> != 0.0f) pxx += momentNormal<I> * f[I];
+        if constexpr (momentShear<I> != 0.0f) pxy += momentShear<I> * f[I];
+    });
+
+    float inv = 1.0f / rho;
+    float j2 = (jx * jx + jy * jy) * inv;
+    // deviations from equilibrium, scaled by rate / squared row norm
+    float de = RateEnergy * (e - (-2.0f * rho + 3.0f * j2)) * (1.0f / 36.0f);
+    float deps = RateEnergySquare * (eps - (rho - 3.0f * j2)) * (1.0f / 36.0f);
+    float dqx = RateHeatFlux * (qx + jx) * (1.0f / 12.0f);
+    float dqy = RateHeatFlux * (qy + jy) * (1.0f / 12.0f);
+    float dxx = omega * (pxx - (jx * jx - jy * jy) * inv) * 0.25f;
+    float dxy = omega * (pxy - jx * jy * inv) * 0.25f;
+
+    lattice::unroll<L::Q>([&](auto i) {
+        constexpr int I = decltype(i)::value;
+        float d = momentEnergy<I> * de + momentEnergySquare<I> * deps;
+        if constexpr (momentHeatX<I> != 0.0f) d += momentHeatX<I> * dqx;
+        if constexpr (momentHeatY<I> != 0.0f) d += momentHeatY<I> * dqy;
+        if constexpr (momentNormal<I> != 0.0f) d += momentNormal<I> * dxx;
+        if constexpr (momentShear<I> != 0.0f) d += momentShear<I> * dxy;
+        f[I] -= d;
+    });
+}
+
+// cell loop shared by every ISA: each wrapper below flattens it, so the
+// wrapper's target attribute decides the vector width
+template <CollisionModel M>
+inline void collideRange(const float* const* src, float* const* dst,
+                         std::size_t begin, std::size_t end, float omega) {
+    const float* in[L::Q];
+    float* out[L::Q];
+    for (int i = 0; i < L::Q; i++) {
+        in[i] = src[i];
+        out[i] = dst[i];
+    }
+    float omegaMinus = 1.0f / (0.5f + TRTMagic / (1.0f / omega - 0.5f));
+
+    LATTICE_INDEPENDENT_CELLS
+    for (std::size_t c = begin; c < end; c++) {
+        float f[L::Q];
+        lattice::unroll<L::Q>([&](auto i) { f[decltype(i)::value] = in[decltype(i)::value][c]; });
+        if constexpr (M == CollisionModel::TRT) collideTRTCell(f, omega, omegaMinus);
+        else collideMRTCell(f, omega);
+        lattice::unroll<L::Q>([&](auto i) { out[decltype(i)::value][c] = f[decltype(i)::value]; });
+    }
+}
+
+LATTICE_FLATTEN
+inline void collideTRT_Scalar(const float* const* src, float* const* dst,
+                              std::size_t begin, std::size_t end, float omega) {
+    collideRange<CollisionModel::TRT>(src, dst, begin, end, omega);
+}
+
+LATTICE_FLATTEN
+inline void collideMRT_Scalar(const float* const* src, float* const* dst,
+                              std::size_t begin, std::size_t end, float omega) {
+    collideRange<CollisionModel::MRT>(src, dst, begin, end, omega);
+}
+
+#ifdef LBM_SIMD_X86
+
+LATTICE_FLATTEN __attribute__((target("avx2,fma")))
+inline void collideTRT_AVX2(const float* const* src, float* const* dst,
+                            std::size_t begin, std::size_t end, float omega) {
+    collideRange<CollisionModel::TRT>(src, dst, begin, end, omega);
+}
+
+LATTICE_FLATTEN __attribute__((target("avx2,fma")))
+inline void collideMRT_AVX2(const float* const* src, float* const* dst,
+                            std::size_t begin, std::size_t end, float omega) {
+    collideRange<CollisionModel::MRT>(src, dst, begin, end, omega);
+}
+
+LATTICE_FLATTEN __attribute__((target("avx512f")))
+inline void collideTRT_AVX512(const float* const* src, float* const* dst,
+                              std::size_t begin, std::size_t end, float omega) {
+    collideRange<CollisionModel::TRT>(src, dst, begin, end, omega);
+}
+
+LATTICE_FLATTEN __attribute__((target("avx512f")))
+inline void collideMRT_AVX512(const float* const* src, float* const* dst,
+                              std::size_t begin, std::size_t end, float omega) {
+    collideRange<CollisionModel::MRT>(src, dst, begin, end, omega);
+}
+
+#endif // LBM_SIMD_X86
+
+} // namespace lbm_collision
+
+// BGK keeps the hand-written kernels of lbm_simd.h; TRT and MRT share one
+// auto-vectorized body per ISA (SSE2 is the x86-64 baseline of the scalar build)
+inline CollisionKernel collisionKernelFor(SimdIsa isa, CollisionModel model) {
+    if (model == CollisionModel::BGK) return collisionKernelFor(isa);
+    bool trt = model == CollisionModel::TRT;
+#ifdef LBM_SIMD_X86
+    switch (isa) {
+        case SimdIsa::AVX512: return trt ? lbm_collision::collideTRT_AVX512 : lbm_collision::collideMRT_AVX512;
+        case SimdIsa::AVX2: return trt ? lbm_collision::collideTRT_AVX2 : lbm_collision::collideMRT_AVX2;
+        default: break;
+    }
+#endif
+    return trt ? lbm_collision::collideTRT_Scalar : lbm_collision::collideMRT_Scalar;
+}
+
+#endif
@@ -0,0 +1,163 @@
+#ifndef LBM_COMPUTE_H
+#define LBM_COMPUTE_H
+
+#include <glad/glad.h>
+#include <roofline.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Compute-shader backend (GL 4.3): the fused pull step of lbm_fused.frag as
+// one dispatch of lbm_compute.comp per step. The populations are two shader
+// storage buffers (ping-pong) in structure-of-arrays order, nine planes of
+// width * height floats; there is no rasterizer, no framebuffer and no limit
+// of eight color attachments, and storage is plain fp32 whatever the texture
+// formats of the fragment pipelines. Density and velocity are written to the
+// caller's R32F / RG32F textures, so display is shared with the other
+// pipelines. Parameters come from the LBMParams uniform block.
+class LBMComputeBackend {
+private:
+    static constexpr int GroupSize = 16;  // local_size of lbm_compute.comp
+
+    int width = 0;
+    int height = 0;
+    GLuint program = 0;
+    GLuint populations[2] = {0, 0};
+    int current = 0;  // buffer holding the latest populations
+
+    static bool readFile(const std::string& path, std::string& text) {
+        std::ifstream in(path);
+        if (!in) return false;
+        std::stringstream ss;
+        ss << in.rdbuf();
+        text = ss.str();
+        return true;
+    }
+
+public:
+    static bool supported() {
+#ifdef GL_VERSION_4_3
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        return major > 4 || (major == 4 && minor >= 3);
+#else
+        return false;
+#endif
+    }
+
+    // compiles the compute shader at path and allocates both buffers; on
+    // failure nothing is left allocated and dispatch() must not be called
+    bool create(const std::string& path, int w, int h) {
+#ifdef GL_VERSION_4_3
+        width = w;
+        height = h;
+        std::string source;
+        if (!readFile(path, source)) {
+            std::cerr << "ERROR: cannot read compute shader " << path << std::endl;
+            return false;
+        }
+        const char* text = source.c_str();
+        GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+        glShaderSource(shader, 1, &text, nullptr);
+        glCompileShader(shader);
+        GLint ok = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (!ok) {
+            char log[4096];
+            glGetShaderInfoLog(shader, sizeof(log), nullptr, log);
+            std::cerr << "ERROR: compute shader compilation failed:\n" << log << std::endl;
+            glDeleteShader(shader);
+            return false;
+        }
+        program = glCreateProgram();
+        glAttachShader(program, shader);
+        glLinkProgram(program);
+        glDeleteShader(shader);
+        glGetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (!ok) {
+            char log[4096];
+            glGetProgramInfoLog(program, sizeof(log), nullptr, log);
+            std::cerr << "ERROR: compute program link failed:\n" << log << std::endl;
+            destroy();
+            return false;
+        }
+
+        GLsizeiptr bytes = GLsizeiptr(sizeof(float)) * 9 * width * height;
+        while (glGetError() != GL_NO_ERROR) {}  // only the allocations below count
+        glGenBuffers(2, populations);
+        for (GLuint buffer : populations) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        GLenum error = glGetError();
+        if (error != GL_NO_ERROR) {
+            std::cerr << "ERROR: cannot allocate two " << bytes / (1024 * 1024)
+                      << " MiB population buffers (GL error 0x" << std::hex << error << std::dec << ")"
+                      << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+#else
+        (void)path; (void)w; (void)h;
+        return false;
+#endif
+    }
+
+    GLuint id() const { return program; }
+
+    // one dispatch reads and writes the nine fp32 planes and stores density
+    // and velocity through images
+    static PassTraffic traffic() {
+        double planes = 9.0 * sizeof(float);
+        return {"compute", planes, planes + 3.0 * sizeof(float)};
+    }
+
+    // uploads stored populations, plane by plane (SoA), into the current buffer
+    void upload(const std::vector<float>& planes) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, populations[current]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(planes.size() * sizeof(float)), planes.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // plane i (SoA, width * height floats) of the current buffer
+    void uploadPlane(int i, const float* plane) {
+        GLsizeiptr bytes = GLsizeiptr(sizeof(float)) * width * height;
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, populations[current]);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, bytes * i, bytes, plane);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+
+    // buffer holding the latest populations, plane i at byte i * width * height * 4
+    GLuint currentBuffer() const { return populations[current]; }
+
+    // one step; density and velocity are images 0 and 1 of the shader
+    void step(GLuint densityTex, GLuint velocityTex) {
+#ifdef GL_VERSION_4_3
+        glUseProgram(program);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, populations[current]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, populations[1 - current]);
+        glBindImageTexture(0, densityTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+        glBindImageTexture(1, velocityTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+        glDispatchCompute(GLuint((width + GroupSize - 1) / GroupSize), GLuint((height + GroupSize - 1) / GroupSize), 1);
+        // the next dispatch reads the buffer just written, the display samples the images
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+        current = 1 - current;
+#else
+        (void)densityTex; (void)velocityTex;
+#endif
+    }
+
+    void destroy() {
+        if (populations[0]) glDeleteBuffers(2, populations);
+        populations[0] = populations[1] = 0;
+        if (program) glDeleteProgram(program);
+        program = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,1245 @@
+#ifndef LBM_CPU_H
+#define LBM_CPU_H
+
+#include <thread_pool.h>
+#include <aligned_allocator.h>
+#include <lbm_simd.h>
+#include <lbm_collision.h>
+#include <tile_scheduler.h>
+#include <half_float.h>
+#include <lattice.h>
+#include <cell_flags.h>
+#include <roofline.h>
+#include <checkpoint.h>
+#include <checkpoint_chain.h>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <atomic>
+
+// mouse forcing of lbm_force.frag, positions and radius in normalized texture coordinates
+struct LBMForce {
+    float mouseX = 0.5f;
+    float mouseY = 0.5f;
+    float velX = 0.0f;
+    float velY = 0.0f;
+    float radius = 0.04f;
+    float strength = 0.15f;
+};
+
+// Split runs the four passes of LBMInteractive::update(); Fused is the
+// single-pass pull scheme of lbm_fused.frag. InPlace is the AA pattern of
+// lbm_inplace.frag: same physics as Fused but with one population buffer.
+enum class LBMScheme { Split, Fused, InPlace };
+
+inline const char* lbmSchemeName(LBMScheme scheme) {
+    switch (scheme) {
+        case LBMScheme::Fused: return "fused";
+        case LBMScheme::InPlace: return "in-place (AA)";
+        default: return "split";
+    }
+}
+
+// How populations are kept in memory between steps. Float16 stores IEEE half
+// floats (the CPU side of the RGBA16F textures) and converts every row to
+// float before computing on it. Float16Deviation stores f_i - w_i * rho0
+// (rho0 = 1) in half instead, like restOffset in the shaders: near rest the
+// stored values are small, so the 11-bit mantissa resolves the fluctuations
+// instead of the constant w_i. Only Fused and InPlace support fp16; the split
+// passes always run on float planes.
+enum class LBMStorage { Float32, Float16, Float16Deviation };
+
+inline const char* lbmStorageName(LBMStorage storage) {
+    switch (storage) {
+        case LBMStorage::Float16: return "fp16";
+        case LBMStorage::Float16Deviation: return "fp16 deviation";
+        default: return "fp32";
+    }
+}
+
+// CPU port of the fluid_sim_final shader pipeline. Each pass mirrors one
+// fragment shader and produces the same values per cell, so the physics
+// matches LBMInteractive without needing a GL context.
+class LBMCpuEngine {
+public:
+    // D2Q9 lattice from lattice.h, same population order as the shaders (the
+    // three e_y = +1 directions first). Grid rows go bottom to top: row 0 is
+    // the bottom row, texel row 0 of the GL textures.
+    using Lattice = lattice::D2Q9;
+    static constexpr int Q = Lattice::Q;
+    static constexpr const auto& w = Lattice::w;
+    static constexpr const auto& ex = Lattice::cx;
+    static constexpr const auto& ey = Lattice::cy;
+    static constexpr const auto& opp = Lattice::opp;
+
+    static float equilibrium(int i, float rho, float ux, float uy) {
+        float eu = float(ex[i]) * ux + float(ey[i]) * uy;
+        float u2 = ux * ux + uy * uy;
+        return w[i] * rho * (1.0f + 3.0f * eu + 4.5f * eu * eu - 1.5f * u2);
+    }
+
+private:
+    int NX;
+    int NY;
+    float tau;
+    ThreadPool pool;
+    SimdIsa isa;
+    CollisionKernel collisionKernel;
+    CollisionModel collision = CollisionModel::BGK;
+    LBMScheme scheme;
+    LBMStorage storage;
+    float storageBias[Q] = {};  // offset removed from direction i before it is stored
+
+    // populations as Q structure-of-arrays planes per buffer, each plane
+    // padded to a 64-byte multiple; ping-ponged like distTextures.
+    // dist holds fp32 planes, packed the fp16 ones; the other stays empty.
+    size_t planeStride;
+    AlignedVector<float> dist[2];
+    AlignedVector<uint16_t> packed[2];
+    std::vector<float> density;
+    std::vector<float> velocity;  // interleaved ux, uy
+
+    // per-worker row buffers for the fused and in-place passes
+    size_t rowStride;
+    std::vector<AlignedVector<float>> scratch;
+
+    // tiled execution on the work-stealing scheduler; tileHeight 0 disables it,
+    // tileWidth 0 makes tiles span whole rows
+    int tileWidth = 0;
+    int tileHeight = 0;
+    TileScheduler scheduler;
+
+    // temporal blocking depth for fused tiles and the per-worker local copies
+    int temporalDepth = 1;
+
+    // Sparse mode: the grid is cut into sparseTile^2 blocks. Dormant blocks
+    // hold exactly the rest state in every buffer and are not computed; a
+    // step only visits active blocks, their neighbours and blocks under the
+    // force. A computed block whose populations stay within sparseThreshold
+    // of rest is snapped back to rest and goes dormant.
+    int sparseTile = 0;
+    float sparseThreshold = 1e-5f;
+    int sparseTilesX = 0;
+    int sparseTilesY = 0;
+    std::vector<uint8_t> tileActive;
+    std::vector<uint8_t> tileVisit;
+    std::vector<int> visitList;
+    std::vector<float> tileDeviation;
+    long long tileUpdates = 0;
+    float restValue[Q] = {};  // rest state as the kernels see it after loading from storage
+    std::vector<AlignedVector<float>> blockScratch;
+
+    // Cell flags (cell_flags.h) compiled into per-row lists, so the span
+    // kernels keep their branch-free runs and only touch the listed cells
+    // afterwards: links are the (x, i) whose upstream cell x - e_i is solid
+    // and take the bounce-back value, runs are the non-solid spans the AA
+    // push is limited to, boundary cells are reset to their equilibrium
+    // every step. Row y owns entries [start[y], start[y + 1]); all lists are
+    // empty without flags. The box walls stay implicit in the span bounds.
+    struct BoundaryLink {
+        int x;
+        int i;
+    };
+    struct BoundaryCell {
+        int x;
+        CellType type;
+    };
+    std::vector<size_t> linkStart;
+    std::vector<BoundaryLink> links;
+    std::vector<size_t> runStart;
+    std::vector<std::pair<int, int>> fluidRuns;
+    std::vector<size_t> cellStart;
+    std::vector<BoundaryCell> boundaryCells;
+    float inletVelocity[2] = {0.05f, 0.0f};
+
+    bool pingPong = false;
+    bool oddStep = false;  // AA pattern phase of the next in-place step
+    long long stepCount = 0;
+
+    bool passTiming = false;
+    std::vector<PassTime> passTimes;  // indexed like passTraffic()
+
+    // runs one pass of step(), timed into passTimes[index] when enabled
+    template <typename F>
+    void timedPass(size_t index, F&& pass) {
+        if (!passTiming) {
+            pass();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        pass();
+        passTimes[index].seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        passTimes[index].runs++;
+    }
+
+    float* plane(int buffer, int i) { return dist[buffer].data() + size_t(i) * planeStride; }
+
+    // plane i of the storage buffer, as float or packed half
+    template <typename T>
+    T* storagePlane(int buffer, int i) {
+        if constexpr (std::is_same<T, uint16_t>::value) {
+            return packed[buffer].data() + size_t(i) * planeStride;
+        } else {
+            return plane(buffer, i);
+        }
+    }
+
+    // contiguous runs of direction i between storage and the float rows the
+    // kernels use. Opposite directions share a weight, so a bounce-back or
+    // swapped-slot run uses the same bias as a plain one. fp32 has no bias.
+    void loadRun(const float* src, float* dst, size_t n, int) const { std::copy(src, src + n, dst); }
+    void loadRun(const uint16_t* src, float* dst, size_t n, int i) const {
+        half_float::toFloatRow(src, dst, n, storageBias[i]);
+    }
+    void storeRun(const float* src, float* dst, size_t n, int) const { std::copy(src, src + n, dst); }
+    void storeRun(const float* src, uint16_t* dst, size_t n, int i) const {
+        half_float::fromFloatRow(src, dst, n, storageBias[i]);
+    }
+    // rounds fp32 values of plane i as a storeRun() + loadRun() through T would
+    template <typename T>
+    void roundRun(float* run, size_t n, int i) const {
+        if (std::is_same<T, float>::value) return;
+        uint16_t chunk[64];
+        for (size_t k = 0; k < n; k += 64) {
+            size_t m = std::min(n - k, size_t(64));
+            half_float::fromFloatRow(run + k, chunk, m, storageBias[i]);
+            half_float::toFloatRow(chunk, run + k, m, storageBias[i]);
+        }
+    }
+
+    // The row helpers below work on the span [x0, x1) of row y, so whole rows
+    // and tiles share one implementation.
+
+    // lbm_force.frag; populations of cell x live at f[i][offset + x]
+    void forceRow(float* const* f, ptrdiff_t offset, int y, int x0, int x1,
+                  const LBMForce& force) const {
+        float ty = (float(y) + 0.5f) / float(NY);
+        for (int x = x0; x < x1; x++) {
+            float tx = (float(x) + 0.5f) / float(NX);
+            float dx = tx - force.mouseX;
+            float dy = ty - force.mouseY;
+            float dist2 = dx * dx + dy * dy;
+            if (std::sqrt(dist2) >= force.radius) continue;
+
+            float strength = force.strength * std::exp(-dist2 / (force.radius * force.radius * 0.1f));
+            ptrdiff_t c = offset + x;
+
+            float rho = 0.0f;
+            for (int i = 0; i < Q; i++) rho += f[i][c];
+            rho += strength * 0.1f;
+            float ux = force.velX * strength * 0.005f;
+            float uy = force.velY * strength * 0.005f;
+
+            for (int i = 0; i < Q; i++) f[i][c] = equilibrium(i, rho, ux, uy);
+        }
+    }
+
+    // where a population buffer keeps its cells: cell (x, y) lives at
+    // plane[(y - y0) * pitch + x - x0]. The global planes use {0, 0, NX};
+    // temporal blocking pulls from small local copies of a tile.
+    struct Window {
+        int x0;
+        int y0;
+        size_t pitch;
+    };
+
+    // lbm_streaming.frag: pull every population of the span from x - e_i into
+    // out[i][x - x0], with half-way bounce-back at the walls. The interior
+    // value comes from plane from[i] of the upstream cell, the bounce-back
+    // value from plane back[i] of the cell itself. Spans are shifted at once;
+    // only the wall cells take the bounce-back path.
+    template <typename T>
+    void pullRow(const T* const* from, const T* const* back, const Window& win,
+                 int y, int x0, int x1, float* const* out) const {
+        ptrdiff_t row = ptrdiff_t(y - win.y0) * ptrdiff_t(win.pitch) - win.x0;
+        int n = x1 - x0;
+        for (int i = 0; i < Q; i++) {
+            const T* own = back[i] + row + x0;
+            float* dst = out[i];
+
+            int sy = y - ey[i];
+            if (sy < 0 || sy >= NY) {
+                loadRun(own, dst, n, i);
+                continue;
+            }
+            // columns whose source x - ex stays inside the grid
+            int xBegin = std::min(std::max(x0, ex[i]) - x0, n);
+            int xEnd = std::max(std::min(x1, NX + ex[i]) - x0, xBegin);
+            ptrdiff_t srcBase = row - ptrdiff_t(ey[i]) * ptrdiff_t(win.pitch) + x0 - ex[i];
+            loadRun(own, dst, xBegin, i);
+            loadRun(from[i] + (srcBase + xBegin), dst + xBegin, xEnd - xBegin, i);
+            loadRun(own + xEnd, dst + xEnd, n - xEnd, i);
+        }
+        // populations coming from solid cells bounce back
+        if (linkStart.empty()) return;
+        for (size_t k = linkStart[y]; k < linkStart[y + 1]; k++) {
+            const BoundaryLink& link = links[k];
+            if (link.x < x0 || link.x >= x1) continue;
+            loadRun(back[link.i] + row + link.x, out[link.i] + (link.x - x0), 1, link.i);
+        }
+    }
+
+    template <typename T>
+    void pullRow(const T* const* from, const T* const* back, int y, int x0, int x1,
+                 float* const* out) const {
+        pullRow(from, back, Window{0, 0, size_t(NX)}, y, x0, x1, out);
+    }
+
+    // mirror of pullRow for the AA pattern: push row[i][x - rowX0] of the
+    // span [x0, x1) to x + e_i in plane to[i], or back into plane back[i] of
+    // the cell itself at a wall. Targets on solid cells are skipped; pushRow
+    // keeps those populations through the links.
+    template <typename T>
+    void pushSpan(const float* const* row, int y, int rowX0, int x0, int x1,
+                  T* const* to, T* const* back) const {
+        size_t own = size_t(y) * NX + x0;
+        int n = x1 - x0;
+        for (int i = 0; i < Q; i++) {
+            const float* src = row[i] + (x0 - rowX0);
+            T* wall = back[i] + own;
+
+            int ty = y + ey[i];
+            if (ty < 0 || ty >= NY) {
+                storeRun(src, wall, n, i);
+                continue;
+            }
+            // columns whose target x + ex stays inside the grid
+            int xBegin = std::min(std::max(x0, -ex[i]) - x0, n);
+            int xEnd = std::max(std::min(x1, NX - ex[i]) - x0, xBegin);
+            storeRun(src, wall, xBegin, i);
+            storeRun(src + xEnd, wall + xEnd, n - xEnd, i);
+            T* target = to[i] + size_t(ty) * NX + ex[i];  // column x lands in target[x]
+            if (runStart.empty()) {
+                storeRun(src + xBegin, target + x0 + xBegin, xEnd - xBegin, i);
+                continue;
+            }
+            // only the columns whose target is in a non-solid run of row ty
+            for (size_t k = runStart[ty]; k < runStart[ty + 1]; k++) {
+                int a = std::max(fluidRuns[k].first - ex[i], x0 + xBegin);
+                int b = std::min(fluidRuns[k].second - ex[i], x0 + xEnd);
+                if (a < b) storeRun(src + (a - x0), target + a, b - a, i);
+            }
+        }
+    }
+
+    // Solid cells do not push: their stores would land in slots their fluid
+    // neighbours fill by bounce-back. A fluid cell pushing towards a solid
+    // one, i.e. with a link (x, opp i), keeps population i itself; pushSpan
+    // skips that target, so solid cells keep the rest values of the last
+    // even step and in-place checkpoints hold no stray fluid values there.
+    template <typename T>
+    void pushRow(const float* const* row, int y, int x0, int x1,
+                 T* const* to, T* const* back) const {
+        if (runStart.empty()) {
+            pushSpan(row, y, x0, x0, x1, to, back);
+            return;
+        }
+        for (size_t k = runStart[y]; k < runStart[y + 1]; k++) {
+            int a = std::max(fluidRuns[k].first, x0);
+            int b = std::min(fluidRuns[k].second, x1);
+            if (a < b) pushSpan(row, y, x0, a, b, to, back);
+        }
+        for (size_t k = linkStart[y]; k < linkStart[y + 1]; k++) {
+            const BoundaryLink& link = links[k];
+            if (link.x < x0 || link.x >= x1) continue;
+            int i = opp[link.i];
+            storeRun(row[i] + (link.x - x0), back[i] + size_t(y) * NX + link.x, 1, i);
+        }
+    }
+
+    // solid cells to rest, inlets to the inlet velocity, outlets to rho = 1
+    // with their own velocity; populations of cell x live at f[i][offset + x]
+    void boundaryRow(float* const* f, ptrdiff_t offset, int y, int x0, int x1) const {
+        if (cellStart.empty()) return;
+        for (size_t k = cellStart[y]; k < cellStart[y + 1]; k++) {
+            const BoundaryCell& cell = boundaryCells[k];
+            if (cell.x < x0 || cell.x >= x1) continue;
+            ptrdiff_t c = offset + cell.x;
+            if (cell.type == CellType::Solid) {
+                for (int i = 0; i < Q; i++) f[i][c] = restValue[i];
+                continue;
+            }
+            float ux = inletVelocity[0];
+            float uy = inletVelocity[1];
+            if (cell.type == CellType::Outlet) {
+                float rho = 0.0f, jx = 0.0f, jy = 0.0f;
+                for (int i = 0; i < Q; i++) {
+                    rho += f[i][c];
+                    jx += float(ex[i]) * f[i][c];
+                    jy += float(ey[i]) * f[i][c];
+                }
+                ux = jx / rho;
+                uy = jy / rho;
+            }
+            for (int i = 0; i < Q; i++) f[i][c] = equilibrium(i, 1.0f, ux, uy);
+        }
+    }
+
+    // collide the scratch row and write it to storage
+    void collideStore(float* const* row, float* const* out, size_t n, float omega) const {
+        collisionKernel(row, out, 0, n, omega);
+    }
+
+    void collideStore(float* const* row, uint16_t* const* out, size_t n, float omega) const {
+        collisionKernel(row, row, 0, n, omega);
+        for (int i = 0; i < Q; i++) storeRun(row[i], out[i], n, i);
+    }
+
+    // lbm_macro.frag; populations of cell x live at f[i][offset + x]
+    void macroRow(const float* const* f, ptrdiff_t offset, int y, int x0, int x1) {
+        size_t row = size_t(y) * NX;
+        for (int x = x0; x < x1; x++) {
+            ptrdiff_t c = offset + x;
+            float rho = f[0][c] + f[1][c] + f[2][c] + f[3][c] + f[4][c] +
+                        f[5][c] + f[6][c] + f[7][c] + f[8][c];
+            float ux = (f[2][c] + f[5][c] + f[8][c]) - (f[0][c] + f[3][c] + f[6][c]);
+            float uy = (f[0][c] + f[1][c] + f[2][c]) - (f[6][c] + f[7][c] + f[8][c]);
+            density[row + x] = rho;
+            velocity[(row + x) * 2 + 0] = ux / rho;
+            velocity[(row + x) * 2 + 1] = uy / rho;
+        }
+    }
+
+    // scratch rows for one worker, Q planes of rowStride floats
+    float* scratchFor(int worker) {
+        AlignedVector<float>& buffer = scratch[worker];
+        if (buffer.size() < rowStride * Q) buffer.resize(rowStride * Q);
+        return buffer.data();
+    }
+
+    // fused pull step over the rectangle [x0, x1) x [y0, y1)
+    template <typename T>
+    void fusedBlockAs(int src, int dst, int x0, int x1, int y0, int y1,
+                      const LBMForce* force, int worker, float* deviation) {
+        float omega = 1.0f / tau;
+        float* buffer = scratchFor(worker);
+        const T* from[Q];
+        const T* back[Q];
+        float* row[Q];
+        T* out[Q];
+        for (int i = 0; i < Q; i++) {
+            from[i] = storagePlane<T>(src, i);
+            back[i] = storagePlane<T>(src, opp[i]);
+            row[i] = buffer + i * rowStride;
+        }
+
+        for (int y = y0; y < y1; y++) {
+            pullRow(from, back, y, x0, x1, row);
+            boundaryRow(row, -ptrdiff_t(x0), y, x0, x1);
+            macroRow(row, -ptrdiff_t(x0), y, x0, x1);
+            if (force) forceRow(row, -ptrdiff_t(x0), y, x0, x1, *force);
+            if (deviation) *deviation = std::max(*deviation, rowDeviation(row, size_t(x1 - x0)));
+            for (int i = 0; i < Q; i++) out[i] = storagePlane<T>(dst, i) + size_t(y) * NX + x0;
+            collideStore(row, out, size_t(x1 - x0), omega);
+        }
+    }
+
+    // one AA-pattern phase over the rectangle [x0, x1) x [y0, y1)
+    template <typename T>
+    void inPlaceBlockAs(bool odd, int x0, int x1, int y0, int y1,
+                        const LBMForce* force, int worker, float* deviation) {
+        float omega = 1.0f / tau;
+        T* f[Q];
+        T* swapped[Q];
+        for (int i = 0; i < Q; i++) {
+            f[i] = storagePlane<T>(0, i);
+            swapped[i] = storagePlane<T>(0, opp[i]);
+        }
+
+        if constexpr (std::is_same<T, float>::value) {
+            // fp32 even steps collide straight from storage into the swapped slots
+            if (!odd) {
+                const float* in[Q];
+                float* out[Q];
+                for (int y = y0; y < y1; y++) {
+                    size_t row = size_t(y) * NX;
+                    for (int i = 0; i < Q; i++) {
+                        in[i] = f[i] + row + x0;
+                        out[i] = swapped[i] + row + x0;
+                    }
+                    boundaryRow(f, ptrdiff_t(row), y, x0, x1);
+                    macroRow(in, -ptrdiff_t(x0), y, x0, x1);
+                    if (force) forceRow(f, ptrdiff_t(row), y, x0, x1, *force);
+                    if (deviation) *deviation = std::max(*deviation, rowDeviation(in, size_t(x1 - x0)));
+                    collisionKernel(in, out, 0, size_t(x1 - x0), omega);
+                }
+                return;
+            }
+        }
+
+        float* buffer = scratchFor(worker);
+        float* row[Q];
+        T* out[Q];
+        for (int i = 0; i < Q; i++) row[i] = buffer + i * rowStride;
+
+        for (int y = y0; y < y1; y++) {
+            if (odd) {
+                pullRow<T>(swapped, f, y, x0, x1, row);
+            } else {
+                for (int i = 0; i < Q; i++) loadRun(f[i] + size_t(y) * NX + x0, row[i], size_t(x1 - x0), i);
+            }
+            boundaryRow(row, -ptrdiff_t(x0), y, x0, x1);
+            macroRow(row, -ptrdiff_t(x0), y, x0, x1);
+            if (force) forceRow(row, -ptrdiff_t(x0), y, x0, x1, *force);
+            if (deviation) *deviation = std::max(*deviation, rowDeviation(row, size_t(x1 - x0)));
+            if (odd) {
+                collisionKernel(row, row, 0, size_t(x1 - x0), omega);
+                pushRow(row, y, x0, x1, f, swapped);
+            } else {
+                for (int i = 0; i < Q; i++) out[i] = swapped[i] + size_t(y) * NX + x0;
+                collideStore(row, out, size_t(x1 - x0), omega);
+            }
+        }
+    }
+
+    // Temporal blocking: advance the tile [x0, x1) x [y0, y1) by `depth`
+    // fused steps while its cells are in cache. The tile plus a halo of
+    // `depth` cells is copied out of buffer src; every step the still-valid
+    // region shrinks by one cell, so the last step covers exactly the tile,
+    // which is written to buffer dst. Halo cells are recomputed by every tile
+    // that needs them instead of being exchanged between steps. Walls and the
+    // force use global coordinates, so the result equals `depth` plain steps.
+    // The local copy is fp32, but with fp16 storage every intermediate step is
+    // rounded as step() would store and reload it.
+    template <typename T>
+    void temporalBlockAs(int src, int dst, int x0, int x1, int y0, int y1, int depth,
+                         const LBMForce* force, int worker) {
+        float omega = 1.0f / tau;
+        int lx0 = std::max(x0 - depth, 0);
+        int ly0 = std::max(y0 - depth, 0);
+        int lx1 = std::min(x1 + depth, NX);
+        int ly1 = std::min(y1 + depth, NY);
+        size_t pitch = size_t(lx1 - lx0);
+        size_t localStride = (pitch * size_t(ly1 - ly0) + 15) / 16 * 16;
+
+        AlignedVector<float>& local = blockScratch[worker];
+        if (local.size() < localStride * Q * 2) local.resize(localStride * Q * 2);
+        Window win{lx0, ly0, pitch};
+        float* buffer = scratchFor(worker);
+
+        float* planes[2][Q];
+        float* row[Q];
+        for (int i = 0; i < Q; i++) {
+            planes[0][i] = local.data() + i * localStride;
+            planes[1][i] = local.data() + (Q + i) * localStride;
+            row[i] = buffer + i * rowStride;
+        }
+
+        for (int y = ly0; y < ly1; y++) {
+            for (int i = 0; i < Q; i++) {
+                const T* from = storagePlane<T>(src, i) + size_t(y) * NX;
+                loadRun(from + lx0, planes[0][i] + size_t(y - ly0) * pitch, pitch, i);
+            }
+        }
+
+        int current = 0;
+        for (int s = 1; s <= depth; s++) {
+            int halo = depth - s;
+            int rx0 = std::max(x0 - halo, 0);
+            int ry0 = std::max(y0 - halo, 0);
+            int rx1 = std::min(x1 + halo, NX);
+            int ry1 = std::min(y1 + halo, NY);
+            bool last = s == depth;
+
+            const float* from[Q];
+            const float* back[Q];
+            float* out[Q];
+            T* result[Q];
+            for (int i = 0; i < Q; i++) {
+                from[i] = planes[current][i];
+                back[i] = planes[current][opp[i]];
+            }
+
+            for (int y = ry0; y < ry1; y++) {
+                pullRow(from, back, win, y, rx0, rx1, row);
+                boundaryRow(row, -ptrdiff_t(rx0), y, rx0, rx1);
+                // density/velocity are only published for the final state
+                if (last) macroRow(row, -ptrdiff_t(rx0), y, rx0, rx1);
+                if (force) forceRow(row, -ptrdiff_t(rx0), y, rx0, rx1, *force);
+                if (last) {
+                    for (int i = 0; i < Q; i++) result[i] = storagePlane<T>(dst, i) + size_t(y) * NX + rx0;
+                    collideStore(row, result, size_t(rx1 - rx0), omega);
+                } else {
+                    for (int i = 0; i < Q; i++) out[i] = planes[1 - current][i] + size_t(y - ly0) * pitch + (rx0 - lx0);
+                    collisionKernel(row, out, 0, size_t(rx1 - rx0), omega);
+                    for (int i = 0; i < Q; i++) roundRun<T>(out[i], size_t(rx1 - rx0), i);
+                }
+            }
+            current = 1 - current;
+        }
+    }
+
+    // deviation, if given, receives the largest |f_i - rest| seen before collision
+    void fusedBlock(int src, int dst, int x0, int x1, int y0, int y1,
+                    const LBMForce* force, int worker, float* deviation = nullptr) {
+        if (storage != LBMStorage::Float32) fusedBlockAs<uint16_t>(src, dst, x0, x1, y0, y1, force, worker, deviation);
+        else fusedBlockAs<float>(src, dst, x0, x1, y0, y1, force, worker, deviation);
+    }
+
+    void inPlaceBlock(bool odd, int x0, int x1, int y0, int y1,
+                      const LBMForce* force, int worker, float* deviation = nullptr) {
+        if (storage != LBMStorage::Float32) inPlaceBlockAs<uint16_t>(odd, x0, x1, y0, y1, force, worker, deviation);
+        else inPlaceBlockAs<float>(odd, x0, x1, y0, y1, force, worker, deviation);
+    }
+
+    // largest |f_i - rest_i| over n cells of scratch or storage rows
+    float rowDeviation(const float* const* f, size_t n) const {
+        // eight independent lanes so the compiler can keep this in vector registers
+        float lane[8] = {};
+        for (int i = 0; i < Q; i++) {
+            float rest = restValue[i];
+            size_t c = 0;
+            for (; c + 8 <= n; c += 8) {
+                for (int k = 0; k < 8; k++) lane[k] = std::max(lane[k], std::fabs(f[i][c + k] - rest));
+            }
+            for (; c < n; c++) lane[0] = std::max(lane[0], std::fabs(f[i][c] - rest));
+        }
+        return *std::max_element(lane, lane + 8);
+    }
+
+    // write the rest state into block [x0, x1) x [y0, y1) of every buffer
+    void restBlock(int x0, int x1, int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            size_t row = size_t(y) * NX;
+            for (int b = 0; b < 2; b++) {
+                for (int i = 0; i < Q && !dist[b].empty(); i++) {
+                    std::fill(plane(b, i) + row + x0, plane(b, i) + row + x1, restValue[i]);
+                }
+                for (int i = 0; i < Q && !packed[b].empty(); i++) {
+                    uint16_t* h = storagePlane<uint16_t>(b, i) + row;
+                    std::fill(h + x0, h + x1, half_float::fromFloat(restValue[i] - storageBias[i]));
+                }
+            }
+            std::fill(density.begin() + row + x0, density.begin() + row + x1, 1.0f);
+            std::fill(velocity.begin() + (row + x0) * 2, velocity.begin() + (row + x1) * 2, 0.0f);
+        }
+    }
+
+    // one fused or AA step over the blocks that can change this step
+    void runSparseStep(const LBMForce* force) {
+        std::fill(tileVisit.begin(), tileVisit.end(), 0);
+        for (int ty = 0; ty < sparseTilesY; ty++) {
+            for (int tx = 0; tx < sparseTilesX; tx++) {
+                if (!tileActive[ty * sparseTilesX + tx]) continue;
+                // populations move one cell per step, so only direct neighbours can wake
+                for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, sparseTilesY - 1); ny++) {
+                    for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, sparseTilesX - 1); nx++) {
+                        tileVisit[ny * sparseTilesX + nx] = 1;
+                    }
+                }
+            }
+        }
+        if (force) {
+            // bounding box of the force circle in cells (texCoord = (x + 0.5) / NX)
+            int fx0 = int(std::floor((force->mouseX - force->radius) * NX - 0.5f));
+            int fx1 = int(std::ceil((force->mouseX + force->radius) * NX - 0.5f));
+            int fy0 = int(std::floor((force->mouseY - force->radius) * NY - 0.5f));
+            int fy1 = int(std::ceil((force->mouseY + force->radius) * NY - 0.5f));
+            fx0 = std::max(fx0, 0);
+            fy0 = std::max(fy0, 0);
+            fx1 = std::min(fx1, NX - 1);
+            fy1 = std::min(fy1, NY - 1);
+            for (int ty = fy0 / sparseTile; fy0 <= fy1 && ty <= fy1 / sparseTile; ty++) {
+                for (int tx = fx0 / sparseTile; fx0 <= fx1 && tx <= fx1 / sparseTile; tx++) {
+                    tileVisit[ty * sparseTilesX + tx] = 1;
+                }
+            }
+        }
+
+        // inlets drive the flow even when everything around them is at rest
+        for (int y = 0; !cellStart.empty() && y < NY; y++) {
+            for (size_t k = cellStart[y]; k < cellStart[y + 1]; k++) {
+                if (boundaryCells[k].type != CellType::Inlet) continue;
+                tileVisit[(y / sparseTile) * sparseTilesX + boundaryCells[k].x / sparseTile] = 1;
+            }
+        }
+
+        visitList.clear();
+        for (int t = 0; t < sparseTilesX * sparseTilesY; t++) {
+            if (tileVisit[t]) visitList.push_back(t);
+        }
+
+        int src = pingPong ? 1 : 0;
+        bool odd = oddStep;
+        std::atomic<size_t> next{0};
+        pool.run([&](int worker) {
+            for (size_t k = next++; k < visitList.size(); k = next++) {
+                int t = visitList[k];
+                int x0 = (t % sparseTilesX) * sparseTile;
+                int y0 = (t / sparseTilesX) * sparseTile;
+                int x1 = std::min(x0 + sparseTile, NX);
+                int y1 = std::min(y0 + sparseTile, NY);
+                float deviation = 0.0f;
+                if (scheme == LBMScheme::Fused) fusedBlock(src, 1 - src, x0, x1, y0, y1, force, worker, &deviation);
+                else inPlaceBlock(odd, x0, x1, y0, y1, force, worker, &deviation);
+                tileDeviation[t] = deviation;
+            }
+        });
+
+        for (int t : visitList) tileActive[t] = tileDeviation[t] > sparseThreshold;
+        // snap quiet blocks to rest, but not next to an active block: its AA
+        // pushes (or next step's pulls) already carry real incoming populations
+        for (int t : visitList) {
+            int tx = t % sparseTilesX;
+            int ty = t / sparseTilesX;
+            bool quiet = true;
+            for (int ny = std::max(ty - 1, 0); ny <= std::min(ty + 1, sparseTilesY - 1); ny++) {
+                for (int nx = std::max(tx - 1, 0); nx <= std::min(tx + 1, sparseTilesX - 1); nx++) {
+                    quiet = quiet && !tileActive[ny * sparseTilesX + nx];
+                }
+            }
+            if (!quiet) continue;
+            int x0 = tx * sparseTile;
+            int y0 = ty * sparseTile;
+            restBlock(x0, std::min(x0 + sparseTile, NX), y0, std::min(y0 + sparseTile, NY));
+        }
+        tileUpdates += (long long)visitList.size();
+
+        if (scheme == LBMScheme::Fused) pingPong = !pingPong;
+        else oddStep = !oddStep;
+    }
+
+    void temporalBlock(int src, int dst, int x0, int x1, int y0, int y1, int depth,
+                       const LBMForce* force, int worker) {
+        if (storage != LBMStorage::Float32) temporalBlockAs<uint16_t>(src, dst, x0, x1, y0, y1, depth, force, worker);
+        else temporalBlockAs<float>(src, dst, x0, x1, y0, y1, depth, force, worker);
+    }
+
+public:
+    LBMCpuEngine(int nx, int ny, float tau, int threads = 0, SimdIsa isa = detectSimdIsa(),
+                 LBMScheme scheme = LBMScheme::Split, LBMStorage storage = LBMStorage::Float32)
+        : NX(nx), NY(ny), tau(tau), pool(threads), isa(isa),
+          collisionKernel(collisionKernelFor(isa)), scheme(scheme),
+          storage(scheme == LBMScheme::Split ? LBMStorage::Float32 : storage), scheduler(pool) {
+        size_t cells = size_t(NX) * NY;
+        rowStride = (size_t(NX) + 15) / 16 * 16;
+        scratch.resize(pool.size());
+        blockScratch.resize(pool.size());
+        planeStride = (cells + 15) / 16 * 16;
+        if (this->storage == LBMStorage::Float16Deviation) {
+            for (int i = 0; i < Q; i++) storageBias[i] = w[i];
+        }
+        for (int i = 0; i < Q; i++) {
+            restValue[i] = equilibrium(i, 1.0f, 0.0f, 0.0f);
+            if (this->storage != LBMStorage::Float32) {
+                restValue[i] = half_float::toFloat(half_float::fromFloat(restValue[i] - storageBias[i])) +
+                               storageBias[i];
+            }
+        }
+        int buffers = scheme == LBMScheme::InPlace ? 1 : 2;
+        for (int b = 0; b < buffers; b++) {
+            if (this->storage != LBMStorage::Float32) packed[b].resize(planeStride * Q);
+            else dist[b].resize(planeStride * Q);
+        }
+        density.resize(cells);
+        velocity.resize(cells * 2);
+    }
+
+    int width() const { return NX; }
+    int height() const { return NY; }
+    int threads() const { return pool.size(); }
+    ThreadPool& threadPool() { return pool; }
+    long long steps() const { return stepCount; }
+    SimdIsa simdIsa() const { return isa; }
+    LBMScheme lbmScheme() const { return scheme; }
+    LBMStorage storageFormat() const { return storage; }
+    CollisionModel collisionModel() const { return collision; }
+
+    // Bytes per cell each pass of a dense step must move (roofline.h), in
+    // step() order. Collision and streaming read and write the Q planes,
+    // macro reads them and writes density and velocity; the fused and
+    // in-place passes do all of it with one read and one write per plane.
+    // The force only touches the cells under the brush and counts as free.
+    std::vector<PassTraffic> passTraffic() const {
+        double planes = double(Q) * (storage == LBMStorage::Float32 ? sizeof(float) : sizeof(uint16_t));
+        double fields = 3.0 * sizeof(float);
+        if (scheme == LBMScheme::Fused) return {{"fused", planes, planes + fields}};
+        if (scheme == LBMScheme::InPlace) return {{"inplace", planes, planes + fields}};
+        return {{"force", 0.0, 0.0},
+                {"collision", planes, planes},
+                {"streaming", planes, planes},
+                {"macro", planes, fields}};
+    }
+
+    // minimum memory traffic of one dense step per cell
+    double bytesPerCellStep() const {
+        double bytes = 0.0;
+        for (const PassTraffic& t : passTraffic()) bytes += t.bytes();
+        return bytes;
+    }
+
+    // Wall time per pass of step(), in passTraffic() order; off by default.
+    // Tiled advance() and sparse steps mix the passes and are not timed.
+    void setPassTiming(bool enabled) {
+        passTiming = enabled;
+        passTimes.clear();
+        if (enabled) {
+            for (const PassTraffic& t : passTraffic()) passTimes.push_back({t.name, 0.0, 0});
+        }
+    }
+    const std::vector<PassTime>& passTimings() const { return passTimes; }
+
+    // BGK, TRT or MRT (lbm_collision.h); MRT stays stable at tau close to 1/2
+    void setCollisionModel(CollisionModel model) {
+        collision = model;
+        collisionKernel = collisionKernelFor(isa, model);
+    }
+
+    // Obstacles, inlets and outlets; an empty field (or one of another size)
+    // removes them. The walls around the box bounce back either way.
+    void setCellFlags(const CellFlags& flags) {
+        linkStart.clear();
+        links.clear();
+        runStart.clear();
+        fluidRuns.clear();
+        cellStart.clear();
+        boundaryCells.clear();
+        if (flags.width() != NX || flags.height() != NY || !flags.hasBoundaries()) return;
+
+        for (int y = 0; y < NY; y++) {
+            linkStart.push_back(links.size());
+            runStart.push_back(fluidRuns.size());
+            cellStart.push_back(boundaryCells.size());
+            for (int x = 0; x < NX; x++) {
+                CellType type = flags.at(x, y);
+                if (type != CellType::Fluid) boundaryCells.push_back({x, type});
+                if (type == CellType::Solid) continue;
+                if (x == 0 || flags.at(x - 1, y) == CellType::Solid) fluidRuns.push_back({x, x + 1});
+                else fluidRuns.back().second = x + 1;
+                for (int i = 0; i < Q; i++) {
+                    int sx = x - ex[i];
+                    int sy = y - ey[i];
+                    if (sx < 0 || sx >= NX || sy < 0 || sy >= NY) continue;
+                    if (flags.at(sx, sy) == CellType::Solid) links.push_back({x, i});
+                }
+            }
+        }
+        linkStart.push_back(links.size());
+        runStart.push_back(fluidRuns.size());
+        cellStart.push_back(boundaryCells.size());
+    }
+
+    // velocity the inlet cells are held at, in lattice units
+    void setInletVelocity(float ux, float uy) {
+        inletVelocity[0] = ux;
+        inletVelocity[1] = uy;
+    }
+
+    const std::vector<float>& densityField() const { return density; }
+    const std::vector<float>& velocityField() const { return velocity; }
+    // plane i of the current populations, NX*NY values row by row
+    // (for InPlace after an odd number of steps these are the swapped slots).
+    // population() is for Float32 storage, packedPopulation() for the fp16 modes.
+    const float* population(int i) const {
+        return dist[pingPong ? 1 : 0].data() + size_t(i) * planeStride;
+    }
+    // writable Float32 plane for couplings like grid refinement; call
+    // computeMacroscopic() after changing it
+    float* population(int i) { return dist[pingPong ? 1 : 0].data() + size_t(i) * planeStride; }
+    const uint16_t* packedPopulation(int i) const {
+        return packed[pingPong ? 1 : 0].data() + size_t(i) * planeStride;
+    }
+
+    // what the current planes hold between steps (checkpoint.h)
+    checkpoint::State checkpointState() const {
+        if (scheme == LBMScheme::Fused) return checkpoint::State::PostCollision;
+        if (scheme == LBMScheme::InPlace && oddStep) return checkpoint::State::Swapped;
+        return checkpoint::State::Streamed;
+    }
+
+    checkpoint::Header checkpointHeader() const {
+        checkpoint::Header header = checkpoint::makeHeader(Lattice::name, Q, NX, NY, 1, tau, stepCount,
+                                                           checkpoint::Precision(storage), checkpointState());
+        for (int i = 0; i < Q; i++) header.bias[i] = storageBias[i];
+        return header;
+    }
+
+    // current plane i as stored, fp32 or fp16
+    const void* storedPopulation(int i) const {
+        return storage == LBMStorage::Float32 ? static_cast<const void*>(population(i))
+                                              : static_cast<const void*>(packedPopulation(i));
+    }
+
+    // Writes the current planes to a checkpoint as they are stored, fp16
+    // included, straight from the engine's memory.
+    bool saveCheckpoint(const std::string& path) const {
+        checkpoint::Writer file;
+        if (!file.open(path, checkpointHeader())) return false;
+        for (int i = 0; i < Q; i++) {
+            if (!file.writePlane(i, storedPopulation(i))) return false;
+        }
+        return file.commit();
+    }
+
+    // Appends the current planes to a checkpoint chain (checkpoint_chain.h):
+    // a keyframe, or only the tiles that changed since the previous save.
+    bool saveCheckpoint(checkpoint::ChainWriter& chain, checkpoint::ChainStats* stats = nullptr) {
+        const void* planes[Q];
+        for (int i = 0; i < Q; i++) planes[i] = storedPopulation(i);
+        return chain.save(pool, checkpointHeader(), planes, stats);
+    }
+
+    // Restarts from a checkpoint of the same grid and storage format. The
+    // file is mapped and each worker copies its rows of every plane straight
+    // into the current buffer. Split needs a streamed state, Fused a
+    // (possibly swapped) post-collision one; InPlace takes any and resumes
+    // in the matching AA phase. Swapped and plain post-collision states only
+    // differ in which plane holds which direction, so reading plane opp(i)
+    // converts between them for free.
+    bool loadCheckpoint(const std::string& path) {
+        checkpoint::Reader file;
+        if (!file.open(path)) return false;
+        const checkpoint::Header& h = file.header();
+        bool swap = false;  // engine plane i comes from file plane opp(i)
+        bool odd = false;
+        if (!resumeMapping(h, path, swap, odd)) return false;
+        if (h.tau != tau) {
+            std::cerr << "WARNING: checkpoint was run at tau " << h.tau << ", continuing at " << tau << std::endl;
+        }
+
+        int current = pingPong ? 1 : 0;
+        pool.parallelFor(0, NY, [&](int y0, int y1) {
+            size_t c0 = size_t(y0) * NX;
+            size_t c1 = size_t(y1) * NX;
+            for (int i = 0; i < Q; i++) {
+                const void* from = file.plane(swap ? opp[i] : i);
+                if (storage == LBMStorage::Float32) {
+                    const float* src = static_cast<const float*>(from);
+                    std::copy(src + c0, src + c1, plane(current, i) + c0);
+                } else {
+                    const uint16_t* src = static_cast<const uint16_t*>(from);
+                    std::copy(src + c0, src + c1, storagePlane<uint16_t>(current, i) + c0);
+                }
+            }
+        });
+        oddStep = odd;
+        stepCount = h.step;
+        std::fill(tileActive.begin(), tileActive.end(), 1);  // sparse blocks start active again
+        computeMacroscopic();
+        return true;
+    }
+
+    // Restarts from the newest state of a checkpoint chain: the keyframe it
+    // descends from, then the tiles of each delta on the way copied over the
+    // current buffer in order.
+    bool loadCheckpointChain(const std::string& manifest) {
+        std::string keyframe;
+        std::vector<std::string> deltas;
+        if (!checkpoint::resolveChain(manifest, keyframe, deltas) || !loadCheckpoint(keyframe)) return false;
+        checkpoint::Reader key;
+        if (!key.open(keyframe)) return false;
+        uint32_t state = key.header().state;  // every delta continues it
+        key.close();
+
+        int current = pingPong ? 1 : 0;
+        char* planes[Q];
+        for (int i = 0; i < Q; i++) {
+            planes[i] = storage == LBMStorage::Float32 ? reinterpret_cast<char*>(plane(current, i))
+                                                       : reinterpret_cast<char*>(storagePlane<uint16_t>(current, i));
+        }
+        for (const std::string& path : deltas) {
+            checkpoint::DeltaReader delta;
+            if (!delta.open(path)) return false;
+            const checkpoint::Header& h = delta.header().base;
+            bool swap = false;
+            bool odd = false;
+            if (!resumeMapping(h, path, swap, odd)) return false;
+            if (h.state != state) {
+                std::cerr << "ERROR: " << path << " does not continue " << keyframe << std::endl;
+                return false;
+            }
+            checkpoint::applyDelta(pool, delta, planes, [&](int i) { return swap ? opp[i] : i; });
+            stepCount = h.step;
+        }
+        computeMacroscopic();
+        return true;
+    }
+
+private:
+    // How a checkpoint of state h maps onto this engine: swap when engine
+    // plane i comes from file plane opp(i), odd for the in-place phase.
+    bool resumeMapping(const checkpoint::Header& h, const std::string& path, bool& swap, bool& odd) const {
+        if (h.q != uint32_t(Q) || h.nx != uint32_t(NX) || h.ny != uint32_t(NY) || h.nz != 1) {
+            std::cerr << "ERROR: checkpoint " << path << " is " << h.lattice << " " << h.nx << "x" << h.ny
+                      << ", the engine runs " << Lattice::name << " " << NX << "x" << NY << std::endl;
+            return false;
+        }
+        if (h.precision != uint32_t(storage)) {
+            std::cerr << "ERROR: checkpoint " << path << " stores "
+                      << lbmStorageName(LBMStorage(h.precision)) << " populations, the engine "
+                      << lbmStorageName(storage) << std::endl;
+            return false;
+        }
+
+        checkpoint::State state = checkpoint::State(h.state);
+        swap = false;
+        odd = false;
+        if (scheme == LBMScheme::InPlace) {
+            odd = state != checkpoint::State::Streamed;
+            swap = state == checkpoint::State::PostCollision;
+        } else if (scheme == LBMScheme::Fused && state != checkpoint::State::Streamed) {
+            swap = state == checkpoint::State::Swapped;
+        } else if (scheme != LBMScheme::Split || state != checkpoint::State::Streamed) {
+            std::cerr << "ERROR: checkpoint " << path << " holds the " << checkpoint::stateName(state)
+                      << " state, the " << lbmSchemeName(scheme) << " scheme resumes from the "
+                      << checkpoint::stateName(checkpointState()) << " one" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+public:
+
+    // lbm_init_multi.frag: rest state at rho = 1 in both buffers
+    void initialize() {
+        pool.parallelFor(0, NY, [&](int y0, int y1) {
+            size_t c0 = size_t(y0) * NX;
+            size_t c1 = size_t(y1) * NX;
+            for (int i = 0; i < Q; i++) {
+                for (int b = 0; b < 2; b++) {
+                    if (!dist[b].empty()) std::fill(plane(b, i) + c0, plane(b, i) + c1, restValue[i]);
+                    if (!packed[b].empty()) {
+                        uint16_t* h = storagePlane<uint16_t>(b, i);
+                        std::fill(h + c0, h + c1, half_float::fromFloat(restValue[i] - storageBias[i]));
+                    }
+                }
+            }
+        });
+        pingPong = false;
+        oddStep = false;
+        stepCount = 0;
+        std::fill(tileActive.begin(), tileActive.end(), 0);  // everything is at rest
+        tileUpdates = 0;
+        computeMacroscopic();
+    }
+
+    // lbm_force.frag: mouse position/velocity in normalized texture coordinates.
+    // Cells outside the radius pass through unchanged, so this updates in place.
+    void applyForce(const LBMForce& force) {
+        int current = pingPong ? 1 : 0;
+        float* f[Q];
+        for (int i = 0; i < Q; i++) f[i] = plane(current, i);
+
+        pool.parallelFor(0, NY, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) forceRow(f, ptrdiff_t(y) * NX, y, 0, NX, force);
+        });
+    }
+
+    // lbm_collision.frag: BGK relaxation towards equilibrium, vectorized
+    // across cells with the kernel picked for this CPU
+    void runCollision() {
+        int src = pingPong ? 1 : 0;
+        int dst = pingPong ? 0 : 1;
+        const float* in[Q];
+        float* out[Q];
+        for (int i = 0; i < Q; i++) {
+            in[i] = plane(src, i);
+            out[i] = plane(dst, i);
+        }
+        float omega = 1.0f / tau;
+
+        pool.parallelFor(0, NY, [&](int y0, int y1) {
+            collisionKernel(in, out, size_t(y0) * NX, size_t(y1) * NX, omega);
+        });
+        pingPong = !pingPong;
+    }
+
+    // lbm_streaming.frag: pull from x - e_i, half-way bounce-back at the walls
+    // and solid cells, then the boundary cells' equilibria
+    void runStreamingWithBoundaries() {
+        int src = pingPong ? 1 : 0;
+        int dst = pingPong ? 0 : 1;
+
+        pool.parallelFor(0, NY, [&](int y0, int y1) {
+            const float* from[Q];
+            const float* back[Q];
+            float* out[Q];
+            for (int i = 0; i < Q; i++) {
+                from[i] = plane(src, i);
+                back[i] = plane(src, opp[i]);
+            }
+            for (int y = y0; y < y1; y++) {
+                for (int i = 0; i < Q; i++) out[i] = plane(dst, i) + size_t(y) * NX;
+                pullRow(from, back, y, 0, NX, out);
+                boundaryRow(out, 0, y, 0, NX);
+            }
+        });
+        pingPong = !pingPong;
+    }
+
+    // lbm_macro.frag: density and velocity of the current populations
+    void computeMacroscopic() {
+        int current = pingPong ? 1 : 0;
+        if (storage != LBMStorage::Float32) {
+            pool.run([&](int worker) {
+                int y0 = int((long long)NY * worker / pool.size());
+                int y1 = int((long long)NY * (worker + 1) / pool.size());
+                float* buffer = scratchFor(worker);
+                const float* row[Q];
+                for (int i = 0; i < Q; i++) row[i] = buffer + i * rowStride;
+                for (int y = y0; y < y1; y++) {
+                    for (int i = 0; i < Q; i++) {
+                        loadRun(storagePlane<uint16_t>(current, i) + size_t(y) * NX,
+                                buffer + i * rowStride, size_t(NX), i);
+                    }
+                    macroRow(row, 0, y, 0, NX);
+                }
+            });
+            return;
+        }
+
+        const float* f[Q];
+        for (int i = 0; i < Q; i++) f[i] = plane(current, i);
+
+        pool.parallelFor(0, NY, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) macroRow(f, ptrdiff_t(y) * NX, y, 0, NX);
+        });
+    }
+
+    // lbm_fused.frag: stream, macroscopic, force and collision in a single
+    // sweep. Each row is pulled into a small per-worker buffer that stays in
+    // L1, so the populations are read once and written once per step.
+    // The buffers hold post-collision values between fused steps.
+    void runFusedStep(const LBMForce* force) {
+        int src = pingPong ? 1 : 0;
+        pool.run([&](int worker) {
+            int y0 = int((long long)NY * worker / pool.size());
+            int y1 = int((long long)NY * (worker + 1) / pool.size());
+            fusedBlock(src, 1 - src, 0, NX, y0, y1, force, worker);
+        });
+        pingPong = !pingPong;
+    }
+
+    // lbm_inplace.frag: AA-pattern streaming on a single population buffer.
+    // Even steps read slot i of each cell and write the collided value back
+    // to slot opp(i) of the same cell. Odd steps pull slot opp(i) from x - e_i
+    // and push the collided value to slot i of x + e_i. Each memory location
+    // is read and written by the same cell, so rows can run in any order.
+    // Between an even and an odd step the planes hold swapped post-collision
+    // values; after an odd step they hold the plain streamed state.
+    void runInPlaceStep(const LBMForce* force) {
+        pool.run([&](int worker) {
+            int y0 = int((long long)NY * worker / pool.size());
+            int y1 = int((long long)NY * (worker + 1) / pool.size());
+            inPlaceBlock(oddStep, 0, NX, y0, y1, force, worker);
+        });
+        oddStep = !oddStep;
+    }
+
+    // tile shape for advance(). Short tiles keep the rows a worker touches in
+    // cache; narrow tiles only pay off when rows are very long, because
+    // short column runs defeat the hardware prefetcher.
+    void setTileSize(int height, int width = 0) {
+        tileHeight = std::max(height, 0);
+        tileWidth = std::max(width, 0);
+    }
+
+    // steps each fused tile advances per visit (temporal blocking); 1 = off.
+    // Only used by advance() with Fused and a tile shape set.
+    void setTemporalDepth(int depth) { temporalDepth = std::max(depth, 1); }
+
+    // Skip blocks of size x size cells that are at rest (Fused and InPlace;
+    // 0 turns it off). A block goes dormant once no population deviates more
+    // than `threshold` from rest; it is then reset to rest exactly, so the
+    // skipped work costs at most that much accuracy. This call marks
+    // every block active, but the usual set-then-initialize() order leaves
+    // them all dormant (the lattice is at rest) until a force or boundary
+    // cell wakes them; loadCheckpoint() marks every block active again.
+    void setSparseTiles(int size, float threshold = 1e-5f) {
+        sparseTile = scheme == LBMScheme::Split ? 0 : std::max(size, 0);
+        sparseThreshold = threshold;
+        sparseTilesX = sparseTile > 0 ? (NX + sparseTile - 1) / sparseTile : 0;
+        sparseTilesY = sparseTile > 0 ? (NY + sparseTile - 1) / sparseTile : 0;
+        size_t tiles = size_t(sparseTilesX) * sparseTilesY;
+        tileActive.assign(tiles, 1);
+        tileVisit.assign(tiles, 0);
+        tileDeviation.assign(tiles, 0.0f);
+        tileUpdates = 0;
+    }
+
+    // blocks computed per step relative to the whole grid, since initialize()
+    double sparseActiveFraction() const {
+        size_t tiles = tileActive.size();
+        if (tiles == 0 || stepCount == 0) return 1.0;
+        return double(tileUpdates) / (double(tiles) * double(stepCount));
+    }
+
+    // `steps` LBM steps under one force (nullptr when not dragging).
+    // Fused and InPlace run as tiles on the work-stealing scheduler: a tile
+    // starts step s + 1 as soon as it and its neighbours are done with step s,
+    // so there is no grid-wide barrier per step and a tile tends to stay on
+    // the worker (and in the cache) that ran it last. With a temporal depth
+    // k > 1 a fused tile does k steps per task, reading each cell from DRAM
+    // once per k steps instead of once per step.
+    // Results match the same number of step() calls, fp16 storage included
+    // (temporal blocks round every intermediate step through it); tile edges
+    // that are not a multiple of the vector width only change how often the
+    // collision kernel falls back to its scalar tail, which rounds slightly
+    // differently.
+    void advance(int steps, const LBMForce* force = nullptr) {
+        if (steps <= 0) return;
+        if (tileHeight <= 0 || scheme == LBMScheme::Split || sparseTile > 0) {
+            for (int s = 0; s < steps; s++) step(force);
+            return;
+        }
+
+        int width = tileWidth > 0 ? std::min(tileWidth, NX) : NX;
+        int height = std::min(tileHeight, NY);
+        int tilesX = (NX + width - 1) / width;
+        int tilesY = (NY + height - 1) / height;
+        bool startPing = pingPong;
+        bool startOdd = oddStep;
+
+        // the halo must stay within the neighbouring tiles the scheduler tracks
+        int depth = scheme == LBMScheme::Fused ? std::min({temporalDepth, width, height}) : 1;
+        int passes = (steps + depth - 1) / depth;
+
+        scheduler.run(tilesX, tilesY, passes, [&](int tile, int p, int worker) {
+            int x0 = (tile % tilesX) * width;
+            int y0 = (tile / tilesX) * height;
+            int x1 = std::min(x0 + width, NX);
+            int y1 = std::min(y0 + height, NY);
+            if (scheme == LBMScheme::Fused) {
+                // every pass reads one buffer and writes the other, whatever its length
+                int src = (startPing != bool(p & 1)) ? 1 : 0;
+                int n = std::min(depth, steps - p * depth);
+                if (n > 1) temporalBlock(src, 1 - src, x0, x1, y0, y1, n, force, worker);
+                else fusedBlock(src, 1 - src, x0, x1, y0, y1, force, worker);
+            } else {
+                inPlaceBlock(startOdd != bool(p & 1), x0, x1, y0, y1, force, worker);
+            }
+        });
+
+        if (passes & 1) {
+            if (scheme == LBMScheme::Fused) pingPong = !pingPong;
+            else oddStep = !oddStep;
+        }
+        stepCount += steps;
+    }
+
+    // one LBM step with the configured scheme; force is nullptr when not dragging.
+    // Split follows LBMInteractive::update(), the others their run*Step().
+    void step(const LBMForce* force = nullptr) {
+        if (sparseTile > 0) {
+            runSparseStep(force);
+        } else if (scheme == LBMScheme::Fused) {
+            timedPass(0, [&]() { runFusedStep(force); });
+        } else if (scheme == LBMScheme::InPlace) {
+            timedPass(0, [&]() { runInPlaceStep(force); });
+        } else {
+            if (force) timedPass(0, [&]() { applyForce(*force); });
+            timedPass(1, [&]() { runCollision(); });
+            timedPass(2, [&]() { runStreamingWithBoundaries(); });
+            timedPass(3, [&]() { computeMacroscopic(); });
+        }
+        stepCount++;
+    }
+};
+
+#endif
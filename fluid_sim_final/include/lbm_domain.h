@@ -0,0 +1,470 @@
+#ifndef LBM_DOMAIN_H
+#define LBM_DOMAIN_H
+
+#include <lbm_cpu.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Multi-process domain decomposition for the CPU engine. The lattice is cut
+// into horizontal slabs, one per worker process on this host. Every step a
+// slab sends the populations leaving through its top and bottom rows to its
+// neighbours and computes its inner rows while they are in flight; only the
+// two edge rows wait for the halo. Halos travel through POSIX shared-memory
+// rings, or through a socket pair when shared memory is unavailable (the
+// socket path is what a multi-node transport would plug into).
+//
+// A slab runs the fused pull scheme of lbm_fused.frag, so a decomposed run
+// reproduces LBMCpuEngine with LBMScheme::Fused.
+
+enum class HaloTransport { SharedMemory, Socket };
+
+inline const char* haloTransportName(HaloTransport transport) {
+    return transport == HaloTransport::Socket ? "socket" : "shared memory";
+}
+
+// Single-producer single-consumer ring of fixed-size messages in memory shared
+// by two processes. head and tail count messages and live on their own cache
+// lines; the producer only writes head, the consumer only writes tail.
+class ShmHaloRing {
+private:
+    struct Header {
+        alignas(64) std::atomic<uint64_t> head;
+        alignas(64) std::atomic<uint64_t> tail;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring counters must be lock-free across processes");
+
+    Header* header = nullptr;
+    float* slots = nullptr;
+    size_t messageFloats = 0;
+    size_t capacity = 0;
+
+public:
+    static constexpr size_t Capacity = 4;
+
+    static size_t bytesFor(size_t messageFloats) {
+        return sizeof(Header) + Capacity * messageFloats * sizeof(float);
+    }
+
+    // memory must be bytesFor(messageFloats) bytes of the shared mapping, 64-byte aligned
+    void attach(void* memory, size_t messageFloats, bool reset) {
+        header = static_cast<Header*>(memory);
+        slots = reinterpret_cast<float*>(static_cast<char*>(memory) + sizeof(Header));
+        this->messageFloats = messageFloats;
+        capacity = Capacity;
+        if (reset) {
+            new (&header->head) std::atomic<uint64_t>(0);
+            new (&header->tail) std::atomic<uint64_t>(0);
+        }
+    }
+
+    void send(const float* data) {
+        uint64_t head = header->head.load(std::memory_order_relaxed);
+        while (head - header->tail.load(std::memory_order_acquire) >= capacity) sched_yield();
+        std::memcpy(slots + (head % capacity) * messageFloats, data, messageFloats * sizeof(float));
+        header->head.store(head + 1, std::memory_order_release);
+    }
+
+    void receive(float* data) {
+        uint64_t tail = header->tail.load(std::memory_order_relaxed);
+        while (header->head.load(std::memory_order_acquire) == tail) sched_yield();
+        std::memcpy(data, slots + (tail % capacity) * messageFloats, messageFloats * sizeof(float));
+        header->tail.store(tail + 1, std::memory_order_release);
+    }
+};
+
+// one direction of a halo link: a shared-memory ring or one end of a socket pair
+class HaloChannel {
+private:
+    HaloTransport transport = HaloTransport::SharedMemory;
+    ShmHaloRing ring;
+    int fd = -1;
+    size_t bytes = 0;
+
+public:
+    void useRing(const ShmHaloRing& r, size_t messageFloats) {
+        transport = HaloTransport::SharedMemory;
+        ring = r;
+        bytes = messageFloats * sizeof(float);
+    }
+
+    void useSocket(int socket, size_t messageFloats) {
+        transport = HaloTransport::Socket;
+        fd = socket;
+        bytes = messageFloats * sizeof(float);
+    }
+
+    bool send(const float* data) {
+        if (transport == HaloTransport::SharedMemory) {
+            ring.send(data);
+            return true;
+        }
+        const char* p = reinterpret_cast<const char*>(data);
+        for (size_t done = 0; done < bytes;) {
+            ssize_t n = ::write(fd, p + done, bytes - done);
+            if (n <= 0) return false;
+            done += size_t(n);
+        }
+        return true;
+    }
+
+    bool receive(float* data) {
+        if (transport == HaloTransport::SharedMemory) {
+            ring.receive(data);
+            return true;
+        }
+        char* p = reinterpret_cast<char*>(data);
+        for (size_t done = 0; done < bytes;) {
+            ssize_t n = ::read(fd, p + done, bytes - done);
+            if (n <= 0) return false;
+            done += size_t(n);
+        }
+        return true;
+    }
+};
+
+// Rows [y0, y1) of an NX x NY lattice with one ghost row on each side. Local
+// row r holds global row y0 + r - 1; planes keep post-collision values.
+class LBMSubdomain {
+public:
+    static constexpr int Q = LBMCpuEngine::Q;
+    // populations that cross a slab edge: ey = +1 leave through the top row,
+    // ey = -1 through the bottom row
+    static constexpr int Up[3] = {0, 1, 2};
+    static constexpr int Down[3] = {6, 7, 8};
+
+private:
+    int NX;
+    int NY;
+    int y0;
+    int y1;
+    int rows;
+    float tau;
+    CollisionKernel collisionKernel;
+    AlignedVector<float> dist[2];
+    AlignedVector<float> row;  // Q streamed rows for the collision kernel
+    std::vector<float> density;
+    std::vector<float> velocity;
+    std::vector<float> message;
+    int current = 0;
+
+    float* plane(int buffer, int i, int localRow) {
+        return dist[buffer].data() + (size_t(i) * (rows + 2) + localRow) * NX;
+    }
+
+    // lbm_fused.frag for one global row: pull, macroscopic output, force, BGK
+    void updateRow(int y, const LBMForce* force) {
+        int r = y - y0 + 1;
+        float* in[Q];
+        for (int i = 0; i < Q; i++) {
+            in[i] = row.data() + size_t(i) * NX;
+            const float* self = plane(current, LBMCpuEngine::opp[i], r);
+            int ex = LBMCpuEngine::ex[i];
+            int sy = y - LBMCpuEngine::ey[i];
+            if (sy < 0 || sy >= NY) {
+                std::copy(self, self + NX, in[i]);
+                continue;
+            }
+            const float* src = plane(current, i, sy - y0 + 1);
+            int x0 = std::max(ex, 0);
+            int x1 = NX + std::min(ex, 0);
+            std::copy(src + x0 - ex, src + x1 - ex, in[i] + x0);
+            if (ex > 0) in[i][0] = self[0];
+            if (ex < 0) in[i][NX - 1] = self[NX - 1];
+        }
+
+        float ty = (float(y) + 0.5f) / float(NY);
+        size_t out = size_t(y - y0) * NX;
+        for (int x = 0; x < NX; x++) {
+            float rho = 0.0f, jx = 0.0f, jy = 0.0f;
+            for (int i = 0; i < Q; i++) {
+                rho += in[i][x];
+                jx += in[i][x] * float(LBMCpuEngine::ex[i]);
+                jy += in[i][x] * float(LBMCpuEngine::ey[i]);
+            }
+            density[out + x] = rho;
+            velocity[(out + x) * 2] = jx / rho;
+            velocity[(out + x) * 2 + 1] = jy / rho;
+
+            if (!force) continue;
+            float dx = (float(x) + 0.5f) / float(NX) - force->mouseX;
+            float dy = ty - force->mouseY;
+            float dist2 = dx * dx + dy * dy;
+            if (std::sqrt(dist2) >= force->radius) continue;
+            float strength = force->strength * std::exp(-dist2 / (force->radius * force->radius * 0.1f));
+            float ux = force->velX * strength * 0.005f;
+            float uy = force->velY * strength * 0.005f;
+            rho += strength * 0.1f;
+            for (int i = 0; i < Q; i++) in[i][x] = LBMCpuEngine::equilibrium(i, rho, ux, uy);
+        }
+
+        float* dst[Q];
+        for (int i = 0; i < Q; i++) dst[i] = plane(1 - current, i, r);
+        collisionKernel(in, dst, 0, size_t(NX), 1.0f / tau);
+    }
+
+    void pack(int localRow, const int (&dirs)[3]) {
+        for (int k = 0; k < 3; k++) {
+            const float* src = plane(current, dirs[k], localRow);
+            std::copy(src, src + NX, message.data() + size_t(k) * NX);
+        }
+    }
+
+    void unpack(int localRow, const int (&dirs)[3]) {
+        for (int k = 0; k < 3; k++) {
+            std::copy(message.data() + size_t(k) * NX, message.data() + size_t(k + 1) * NX,
+                      plane(current, dirs[k], localRow));
+        }
+    }
+
+public:
+    LBMSubdomain(int nx, int ny, int y0, int y1, float tau, SimdIsa isa)
+        : NX(nx), NY(ny), y0(y0), y1(y1), rows(y1 - y0), tau(tau),
+          collisionKernel(collisionKernelFor(isa)) {
+        for (auto& buffer : dist) buffer.assign(size_t(Q) * (rows + 2) * NX, 0.0f);
+        row.resize(size_t(Q) * NX);
+        density.assign(size_t(rows) * NX, 1.0f);
+        velocity.assign(size_t(rows) * NX * 2, 0.0f);
+        message.resize(3 * size_t(NX));
+    }
+
+    static size_t haloFloats(int nx) { return 3 * size_t(nx); }
+
+    void setCollisionKernel(CollisionKernel kernel) { collisionKernel = kernel; }
+
+    // lbm_init_multi.frag: rest state at rho = 1
+    void initialize() {
+        for (int b = 0; b < 2; b++) {
+            for (int i = 0; i < Q; i++) {
+                float feq = LBMCpuEngine::equilibrium(i, 1.0f, 0.0f, 0.0f);
+                std::fill(plane(b, i, 0), plane(b, i, 0) + size_t(rows + 2) * NX, feq);
+            }
+        }
+        current = 0;
+    }
+
+    // One fused step. below/above are nullptr at the walls. Halos leave first,
+    // the inner rows run while they travel, then the edge rows take them in.
+    bool step(HaloChannel* sendBelow, HaloChannel* recvBelow, HaloChannel* sendAbove,
+              HaloChannel* recvAbove, const LBMForce* force) {
+        if (sendAbove) {
+            pack(rows, Up);
+            if (!sendAbove->send(message.data())) return false;
+        }
+        if (sendBelow) {
+            pack(1, Down);
+            if (!sendBelow->send(message.data())) return false;
+        }
+
+        for (int y = y0 + 1; y < y1 - 1; y++) updateRow(y, force);
+
+        if (recvBelow) {
+            if (!recvBelow->receive(message.data())) return false;
+            unpack(0, Up);
+        }
+        if (recvAbove) {
+            if (!recvAbove->receive(message.data())) return false;
+            unpack(rows + 1, Down);
+        }
+        updateRow(y0, force);
+        if (rows > 1) updateRow(y1 - 1, force);
+
+        current = 1 - current;
+        return true;
+    }
+
+    const std::vector<float>& densityField() const { return density; }
+    const std::vector<float>& velocityField() const { return velocity; }
+};
+
+// Forks one worker process per slab, wires the halo links and gathers the
+// macroscopic fields of every slab into shared memory when all are done.
+class LBMProcessGroup {
+public:
+    // force for a step; returns false when nothing is dragging
+    using ForceSchedule = std::function<bool(int step, LBMForce& force)>;
+
+private:
+    int NX;
+    int NY;
+    float tau;
+    int ranks;
+    SimdIsa isa;
+    CollisionModel collision = CollisionModel::BGK;
+    HaloTransport transport;
+    std::vector<float> density;
+    std::vector<float> velocity;
+    std::vector<double> rankSeconds;
+
+    // MAP_SHARED memory that survives fork(); shm_open gives it a POSIX name
+    // so the halo rings live in a real shared-memory object
+    static void* mapShared(size_t bytes, bool named) {
+        if (!named) {
+            void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            return p == MAP_FAILED ? nullptr : p;
+        }
+        std::string name = "/lbm_halo_" + std::to_string(getpid());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0) return nullptr;
+        shm_unlink(name.c_str());  // the mapping stays valid, nothing is left behind
+        void* p = nullptr;
+        if (ftruncate(fd, off_t(bytes)) == 0) {
+            p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) p = nullptr;
+        }
+        close(fd);
+        return p;
+    }
+
+public:
+    LBMProcessGroup(int nx, int ny, float tau, int ranks, HaloTransport transport,
+                    SimdIsa isa = detectSimdIsa())
+        : NX(nx), NY(ny), tau(tau), ranks(std::max(1, std::min(ranks, ny))), isa(isa),
+          transport(transport) {}
+
+    int processes() const { return ranks; }
+    HaloTransport haloTransport() const { return transport; }
+    // takes effect on the next run()
+    void setCollisionModel(CollisionModel model) { collision = model; }
+    const std::vector<float>& densityField() const { return density; }
+    const std::vector<float>& velocityField() const { return velocity; }
+    // wall time of each worker's step loop
+    const std::vector<double>& workerSeconds() const { return rankSeconds; }
+
+    // first global row of slab r
+    int slabStart(int r) const { return int((long long)NY * r / ranks); }
+
+    bool run(int steps, const ForceSchedule& forceAt) {
+        size_t cells = size_t(NX) * NY;
+        size_t resultBytes = size_t(ranks) * sizeof(double) + cells * 3 * sizeof(float);
+        void* results = mapShared(resultBytes, false);
+        if (!results) {
+            std::cerr << "ERROR: could not map the result buffer" << std::endl;
+            return false;
+        }
+        double* seconds = static_cast<double*>(results);
+        float* outDensity = reinterpret_cast<float*>(seconds + ranks);
+        float* outVelocity = outDensity + cells;
+
+        // link k joins slab k (below) and slab k + 1 (above): ring 2k carries
+        // k -> k+1, ring 2k + 1 carries k+1 -> k
+        int links = ranks - 1;
+        size_t halo = LBMSubdomain::haloFloats(NX);
+        size_t ringBytes = (ShmHaloRing::bytesFor(halo) + 63) / 64 * 64;
+        void* rings = nullptr;
+        std::vector<int> sockets;
+        if (links > 0 && transport == HaloTransport::SharedMemory) {
+            rings = mapShared(ringBytes * 2 * links, true);
+            if (!rings) {
+                std::cout << "WARNING: shm_open failed, falling back to socket halos" << std::endl;
+                transport = HaloTransport::Socket;
+            }
+        }
+        std::vector<HaloChannel> channels(2 * size_t(links));
+        for (int k = 0; k < 2 * links; k++) {
+            if (transport == HaloTransport::SharedMemory) {
+                ShmHaloRing ring;
+                ring.attach(static_cast<char*>(rings) + ringBytes * k, halo, true);
+                channels[k].useRing(ring, halo);
+            }
+        }
+        if (transport == HaloTransport::Socket) {
+            // one socket pair per link; channels hold the end each side uses
+            sockets.assign(2 * size_t(links), -1);
+            for (int k = 0; k < links; k++) {
+                int pair[2];
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+                    std::cerr << "ERROR: socketpair failed" << std::endl;
+                    return false;
+                }
+                sockets[2 * k] = pair[0];      // slab k's end
+                sockets[2 * k + 1] = pair[1];  // slab k + 1's end
+            }
+        }
+
+        std::vector<pid_t> children;
+        for (int r = 0; r < ranks; r++) {
+            pid_t pid = fork();
+            if (pid < 0) {
+                std::cerr << "ERROR: fork failed" << std::endl;
+                for (pid_t c : children) kill(c, SIGTERM);
+                break;
+            }
+            if (pid > 0) {
+                children.push_back(pid);
+                continue;
+            }
+
+            // worker r
+            HaloChannel below[2], above[2];  // [0] sends, [1] receives
+            HaloChannel* link[4] = {nullptr, nullptr, nullptr, nullptr};
+            if (transport == HaloTransport::SharedMemory) {
+                if (r > 0) {
+                    link[0] = &channels[2 * (r - 1) + 1];
+                    link[1] = &channels[2 * (r - 1)];
+                }
+                if (r < ranks - 1) {
+                    link[2] = &channels[2 * r];
+                    link[3] = &channels[2 * r + 1];
+                }
+            } else {
+                if (r > 0) {
+                    below[0].useSocket(sockets[2 * (r - 1) + 1], halo);
+                    below[1].useSocket(sockets[2 * (r - 1) + 1], halo);
+                    link[0] = &below[0];
+                    link[1] = &below[1];
+                }
+                if (r < ranks - 1) {
+                    above[0].useSocket(sockets[2 * r], halo);
+                    above[1].useSocket(sockets[2 * r], halo);
+                    link[2] = &above[0];
+                    link[3] = &above[1];
+                }
+            }
+
+            int y0 = slabStart(r), y1 = slabStart(r + 1);
+            LBMSubdomain slab(NX, NY, y0, y1, tau, isa);
+            slab.setCollisionKernel(collisionKernelFor(isa, collision));
+            slab.initialize();
+            bool ok = true;
+            auto start = std::chrono::steady_clock::now();
+            for (int s = 0; s < steps && ok; s++) {
+                LBMForce force;
+                bool active = forceAt && forceAt(s, force);
+                ok = slab.step(link[0], link[1], link[2], link[3], active ? &force : nullptr);
+            }
+            seconds[r] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::copy(slab.densityField().begin(), slab.densityField().end(), outDensity + size_t(y0) * NX);
+            std::copy(slab.velocityField().begin(), slab.velocityField().end(), outVelocity + size_t(y0) * NX * 2);
+            _exit(ok ? 0 : 1);
+        }
+
+        for (int fd : sockets) close(fd);
+        bool ok = int(children.size()) == ranks;
+        for (pid_t c : children) {
+            int status = 0;
+            if (waitpid(c, &status, 0) != c || !WIFEXITED(status) || WEXITSTATUS(status) != 0) ok = false;
+        }
+        if (!ok) std::cerr << "ERROR: a worker process failed" << std::endl;
+
+        density.assign(outDensity, outDensity + cells);
+        velocity.assign(outVelocity, outVelocity + cells * 2);
+        rankSeconds.assign(seconds, seconds + ranks);
+        munmap(results, resultBytes);
+        if (rings) munmap(rings, ringBytes * 2 * links);
+        return ok;
+    }
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef LBM_LATTICE_H
+#define LBM_LATTICE_H
+
+#include <lattice.h>
+#include <lbm_cpu.h>
+#include <thread_pool.h>
+#include <aligned_allocator.h>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Fused pull-scheme engine templated on a lattice descriptor (lattice.h):
+// the same step as lbm_fused.frag, but for any DdQq and for 3D boxes. Every
+// loop over the populations is unrolled for L and velocity components that
+// are zero never reach the generated code. Walls on all sides use half-way
+// bounce-back; the mouse force acts on (x, y) through the whole depth.
+// LBMCpuEngine stays the D2Q9 engine with hand-written SIMD collision; this
+// one is the path to other lattices and to 3D.
+template <typename L>
+class LBMLatticeEngine {
+public:
+    static constexpr int Q = L::Q;
+
+private:
+    int NX;
+    int NY;
+    int NZ;
+    float tau;
+    ThreadPool pool;
+    size_t cells;
+    AlignedVector<float> dist[2];  // Q planes of cells floats, x fastest, then y, then z
+    std::vector<AlignedVector<float>> scratch;  // per worker: Q pulled rows
+    std::vector<float> density;
+    std::vector<float> velocity;  // D components per cell
+    bool pingPong = false;
+    long long stepCount = 0;
+
+    float* plane(int buffer, int i) { return dist[buffer].data() + size_t(i) * cells; }
+
+    // pull row (y, z) into rows[i][x], bounce-back where x - c_i leaves the box
+    void pullRow(int src, int y, int z, float* const* rows) {
+        size_t row = (size_t(z) * NY + y) * NX;
+        lattice::unroll<Q>([&](auto i) {
+            constexpr int I = decltype(i)::value;
+            constexpr int cx = L::cx[I];
+            const float* self = plane(src, L::opp[I]) + row;
+            int sy = y - L::cy[I];
+            int sz = z - L::cz[I];
+            if (sy < 0 || sy >= NY || sz < 0 || sz >= NZ) {
+                std::copy(self, self + NX, rows[I]);
+                return;
+            }
+            const float* from = plane(src, I) + (size_t(sz) * NY + sy) * NX;
+            constexpr int lo = cx > 0 ? cx : 0;
+            int hi = NX + (cx < 0 ? cx : 0);
+            std::copy(from + lo - cx, from + hi - cx, rows[I] + lo);
+            if constexpr (cx > 0) rows[I][0] = self[0];
+            if constexpr (cx < 0) rows[I][NX - 1] = self[NX - 1];
+        });
+    }
+
+    // Three sweeps over the pulled row keep the per-cell loops branch-free so
+    // they vectorize: macroscopic output, the force on the cells it covers,
+    // then collision and store.
+    LATTICE_FLATTEN void updateRow(int src, int y, int z, float* const* rows, const LBMForce* force) {
+        pullRow(src, y, z, rows);
+        size_t row = (size_t(z) * NY + y) * NX;
+        // hoisted so stores through them cannot alias the vectors' own pointers
+        float* in[Q];
+        float* out[Q];
+        for (int i = 0; i < Q; i++) {
+            in[i] = rows[i];
+            out[i] = plane(1 - src, i) + row;
+        }
+        float* rhoOut = density.data() + row;
+        float* uOut = velocity.data() + row * L::D;
+
+        LATTICE_INDEPENDENT_CELLS
+        for (int x = 0; x < NX; x++) {
+            float f[Q];
+            lattice::unroll<Q>([&](auto i) { f[decltype(i)::value] = in[decltype(i)::value][x]; });
+            float rho, ux, uy, uz;
+            lattice::moments<L>(f, rho, ux, uy, uz);
+            rhoOut[x] = rho;
+            uOut[x * L::D] = ux;
+            uOut[x * L::D + 1] = uy;
+            if constexpr (L::D == 3) uOut[x * L::D + 2] = uz;
+        }
+
+        if (force) {
+            float ty = (float(y) + 0.5f) / float(NY);
+            float dy = ty - force->mouseY;
+            int x0 = std::max(int((force->mouseX - force->radius) * NX) - 1, 0);
+            int x1 = std::min(int((force->mouseX + force->radius) * NX) + 1, NX - 1);
+            for (int x = x0; std::fabs(dy) < force->radius && x <= x1; x++) {
+                float dx = (float(x) + 0.5f) / float(NX) - force->mouseX;
+                float dist2 = dx * dx + dy * dy;
+                if (std::sqrt(dist2) >= force->radius) continue;
+                float strength = force->strength * std::exp(-dist2 / (force->radius * force->radius * 0.1f));
+                float f[Q];
+                lattice::setEquilibrium<L>(f, rhoOut[x] + strength * 0.1f, force->velX * strength * 0.005f,
+                                           force->velY * strength * 0.005f, 0.0f);
+                for (int i = 0; i < Q; i++) in[i][x] = f[i];
+            }
+        }
+
+        float omega = 1.0f / tau;
+        LATTICE_INDEPENDENT_CELLS
+        for (int x = 0; x < NX; x++) {
+            float f[Q];
+            lattice::unroll<Q>([&](auto i) { f[decltype(i)::value] = in[decltype(i)::value][x]; });
+            lattice::collideBGK<L>(f, omega);
+            lattice::unroll<Q>([&](auto i) { out[decltype(i)::value][x] = f[decltype(i)::value]; });
+        }
+    }
+
+public:
+    LBMLatticeEngine(int nx, int ny, int nz, float tau, int threads = 0)
+        : NX(nx), NY(ny), NZ(L::D == 3 ? std::max(nz, 1) : 1), tau(tau), pool(threads) {
+        cells = size_t(NX) * NY * NZ;
+        for (auto& buffer : dist) buffer.resize(cells * Q);
+        scratch.resize(pool.size());
+        for (auto& s : scratch) s.resize(size_t(NX) * Q);
+        density.resize(cells);
+        velocity.resize(cells * L::D);
+    }
+
+    int width() const { return NX; }
+    int height() const { return NY; }
+    int depth() const { return NZ; }
+    int threads() const { return pool.size(); }
+    long long steps() const { return stepCount; }
+    const std::vector<float>& densityField() const { return density; }
+    const std::vector<float>& velocityField() const { return velocity; }
+
+    // rest state at rho = 1 in both buffers
+    void initialize() {
+        for (int b = 0; b < 2; b++) {
+            lattice::unroll<Q>([&](auto i) {
+                constexpr int I = decltype(i)::value;
+                std::fill(plane(b, I), plane(b, I) + cells, L::w[I]);
+            });
+        }
+        std::fill(density.begin(), density.end(), 1.0f);
+        std::fill(velocity.begin(), velocity.end(), 0.0f);
+        pingPong = false;
+        stepCount = 0;
+    }
+
+    void step(const LBMForce* force = nullptr) {
+        int src = pingPong ? 1 : 0;
+        int rows = NY * NZ;
+        pool.run([&](int worker) {
+            int r0 = int((long long)rows * worker / pool.size());
+            int r1 = int((long long)rows * (worker + 1) / pool.size());
+            float* pulled[Q];
+            for (int i = 0; i < Q; i++) pulled[i] = scratch[worker].data() + size_t(i) * NX;
+            for (int r = r0; r < r1; r++) updateRow(src, r % NY, r / NY, pulled, force);
+        });
+        pingPong = !pingPong;
+        stepCount++;
+    }
+
+    void advance(int steps, const LBMForce* force = nullptr) {
+        for (int s = 0; s < steps; s++) step(force);
+    }
+};
+
+#endif
@@ -0,0 +1,472 @@
+#ifndef LBM_REFINED_H
+#define LBM_REFINED_H
+
+#include <lbm_cpu.h>
+#include <atomic>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Two-level block-structured refinement on top of the CPU engine. The coarse
+// level is a split-scheme LBMCpuEngine over the whole domain, cut into
+// blockSize x blockSize blocks. Blocks under the mouse force or with strong
+// vorticity also carry a fine patch at half the spacing, which takes two
+// steps per coarse step (acoustic scaling: tau_f = 2 (tau_c - 1/2) + 1/2).
+//
+// The levels meet through the non-equilibrium rescaling of Dupuis & Chopard:
+//   coarse -> fine:  f_f = feq + tau_f / (2 tau_c) * (f_c - feq)
+//   fine -> coarse:  f_c = feq + 2 tau_c / tau_f * (f_f - feq)
+// Fine ghost cells come from a refined neighbour block when there is one and
+// are otherwise interpolated from the coarse level, bilinear in space and
+// linear in time. After every coarse step the coarse cells under a patch are
+// replaced by the average of their four fine cells.
+class LBMRefinedEngine {
+public:
+    static constexpr int Q = LBMCpuEngine::Q;
+
+private:
+    // fine cells of one coarse block plus a one-cell ghost ring, Q planes of
+    // pitch * pitch floats per buffer; local (1, 1) is global fine (x0, y0)
+    struct FinePatch {
+        int block = -1;
+        int x0 = 0;
+        int y0 = 0;
+        int width = 0;
+        int height = 0;
+        AlignedVector<float> f[2];
+    };
+
+    LBMCpuEngine coarse;
+    int NX;
+    int NY;
+    float tauCoarse;
+    float tauFine;
+    int blockSize;
+    int blocksX;
+    int blocksY;
+    int pitch;
+    size_t patchPlane;
+    CollisionKernel collisionKernel;
+
+    float vorticityThreshold = 0.02f;
+    int regridInterval = 10;
+
+    std::vector<int> blockPatch;  // patch slot per coarse block, -1 = coarse only
+    std::vector<FinePatch> patches;
+    std::vector<int> activePatches;
+    std::vector<int> freePatches;
+    int fineCurrent = 0;  // buffer of every patch that holds the current state
+
+    // coarse populations at the start of the step, for the time interpolation
+    // of ghost cells; only the blocks around patches are kept up to date
+    std::vector<float> coarsePrev;
+    long long stepCount = 0;
+    long long fineCells = 0;  // fine cell updates so far
+
+    static void moments(const float* f, float& rho, float& ux, float& uy) {
+        rho = 0.0f;
+        float jx = 0.0f, jy = 0.0f;
+        for (int i = 0; i < Q; i++) {
+            rho += f[i];
+            jx += f[i] * float(LBMCpuEngine::ex[i]);
+            jy += f[i] * float(LBMCpuEngine::ey[i]);
+        }
+        ux = jx / rho;
+        uy = jy / rho;
+    }
+
+    // f = feq + factor * (f - feq), the non-equilibrium rescaling between levels
+    static void rescale(float* f, float factor) {
+        float rho, ux, uy;
+        moments(f, rho, ux, uy);
+        for (int i = 0; i < Q; i++) {
+            float feq = LBMCpuEngine::equilibrium(i, rho, ux, uy);
+            f[i] = feq + factor * (f[i] - feq);
+        }
+    }
+
+    float* patchData(FinePatch& p, int buffer, int i) { return p.f[buffer].data() + size_t(i) * patchPlane; }
+
+    int blockOf(int fineX, int fineY) const { return (fineY / 2 / blockSize) * blocksX + fineX / 2 / blockSize; }
+
+    // coarse populations at the centre of fine cell (gx, gy), bilinear in
+    // space; alpha blends the start of the step (0) into the current state (1)
+    void sampleCoarse(int gx, int gy, float alpha, float* f) {
+        float X = (float(gx) + 0.5f) * 0.5f - 0.5f;
+        float Y = (float(gy) + 0.5f) * 0.5f - 0.5f;
+        int x0 = int(std::floor(X));
+        int y0 = int(std::floor(Y));
+        float tx = X - float(x0);
+        float ty = Y - float(y0);
+        int x1 = std::min(std::max(x0 + 1, 0), NX - 1);
+        int y1 = std::min(std::max(y0 + 1, 0), NY - 1);
+        x0 = std::min(std::max(x0, 0), NX - 1);
+        y0 = std::min(std::max(y0, 0), NY - 1);
+        size_t c00 = size_t(y0) * NX + x0, c10 = size_t(y0) * NX + x1;
+        size_t c01 = size_t(y1) * NX + x0, c11 = size_t(y1) * NX + x1;
+        size_t cells = size_t(NX) * NY;
+        for (int i = 0; i < Q; i++) {
+            const float* now = coarse.population(i);
+            const float* before = coarsePrev.data() + size_t(i) * cells;
+            auto at = [&](size_t c) { return before[c] + alpha * (now[c] - before[c]); };
+            f[i] = (1.0f - ty) * ((1.0f - tx) * at(c00) + tx * at(c10)) +
+                   ty * ((1.0f - tx) * at(c01) + tx * at(c11));
+        }
+    }
+
+    // lbm_force.frag at fine resolution
+    void forceCell(float* f, int gx, int gy, const LBMForce& force) const {
+        float dx = (float(gx) + 0.5f) / float(2 * NX) - force.mouseX;
+        float dy = (float(gy) + 0.5f) / float(2 * NY) - force.mouseY;
+        float dist2 = dx * dx + dy * dy;
+        if (std::sqrt(dist2) >= force.radius) return;
+
+        float strength = force.strength * std::exp(-dist2 / (force.radius * force.radius * 0.1f));
+        float rho = 0.0f;
+        for (int i = 0; i < Q; i++) rho += f[i];
+        rho += strength * 0.1f;
+        float ux = force.velX * strength * 0.005f;
+        float uy = force.velY * strength * 0.005f;
+        for (int i = 0; i < Q; i++) f[i] = LBMCpuEngine::equilibrium(i, rho, ux, uy);
+    }
+
+    // runs fn(slot) for every active patch, spread over the pool
+    template <typename F>
+    void forEachPatch(F&& fn) {
+        std::atomic<size_t> next{0};
+        coarse.threadPool().run([&](int) {
+            for (size_t k = next++; k < activePatches.size(); k = next++) fn(activePatches[k]);
+        });
+    }
+
+    // new patch for block b, prolongated from the current coarse state
+    void refine(int b) {
+        int slot;
+        if (!freePatches.empty()) {
+            slot = freePatches.back();
+            freePatches.pop_back();
+        } else {
+            slot = int(patches.size());
+            patches.emplace_back();
+            for (auto& buffer : patches.back().f) buffer.assign(patchPlane * Q, 0.0f);
+        }
+        FinePatch& p = patches[slot];
+        int bx = b % blocksX;
+        int by = b / blocksX;
+        p.block = b;
+        p.x0 = 2 * bx * blockSize;
+        p.y0 = 2 * by * blockSize;
+        p.width = 2 * (std::min((bx + 1) * blockSize, NX) - bx * blockSize);
+        p.height = 2 * (std::min((by + 1) * blockSize, NY) - by * blockSize);
+
+        float prolong = tauFine / (2.0f * tauCoarse);
+        float f[Q];
+        for (int ly = 1; ly <= p.height; ly++) {
+            for (int lx = 1; lx <= p.width; lx++) {
+                sampleCoarse(p.x0 + lx - 1, p.y0 + ly - 1, 1.0f, f);
+                rescale(f, prolong);
+                for (int i = 0; i < Q; i++) patchData(p, fineCurrent, i)[size_t(ly) * pitch + lx] = f[i];
+            }
+        }
+        blockPatch[b] = slot;
+        activePatches.push_back(slot);
+    }
+
+    void coarsen(int b) {
+        int slot = blockPatch[b];
+        blockPatch[b] = -1;
+        patches[slot].block = -1;
+        freePatches.push_back(slot);
+        activePatches.erase(std::find(activePatches.begin(), activePatches.end(), slot));
+    }
+
+    // blocks the force touches, plus one block around them
+    void markForce(const LBMForce& force, std::vector<uint8_t>& want) const {
+        int x0 = int(std::floor((force.mouseX - force.radius) * NX)) - 1;
+        int x1 = int(std::ceil((force.mouseX + force.radius) * NX)) + 1;
+        int y0 = int(std::floor((force.mouseY - force.radius) * NY)) - 1;
+        int y1 = int(std::ceil((force.mouseY + force.radius) * NY)) + 1;
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, NX - 1);
+        y1 = std::min(y1, NY - 1);
+        if (x0 > x1 || y0 > y1) return;
+        for (int by = std::max(y0 / blockSize - 1, 0); by <= std::min(y1 / blockSize + 1, blocksY - 1); by++) {
+            for (int bx = std::max(x0 / blockSize - 1, 0); bx <= std::min(x1 / blockSize + 1, blocksX - 1); bx++) {
+                want[by * blocksX + bx] = 1;
+            }
+        }
+    }
+
+    // largest |curl u| of a block on the coarse velocity field, central differences
+    float blockVorticity(int b) const {
+        const std::vector<float>& u = coarse.velocityField();
+        int bx0 = (b % blocksX) * blockSize;
+        int by0 = (b / blocksX) * blockSize;
+        int bx1 = std::min(bx0 + blockSize, NX);
+        int by1 = std::min(by0 + blockSize, NY);
+        float largest = 0.0f;
+        for (int y = by0; y < by1; y++) {
+            int ym = std::max(y - 1, 0), yp = std::min(y + 1, NY - 1);
+            for (int x = bx0; x < bx1; x++) {
+                int xm = std::max(x - 1, 0), xp = std::min(x + 1, NX - 1);
+                float dvdx = (u[(size_t(y) * NX + xp) * 2 + 1] - u[(size_t(y) * NX + xm) * 2 + 1]) / float(xp - xm);
+                float dudy = (u[(size_t(yp) * NX + x) * 2] - u[(size_t(ym) * NX + x) * 2]) / float(yp - ym);
+                largest = std::max(largest, std::fabs(dvdx - dudy));
+            }
+        }
+        return largest;
+    }
+
+    // Full regrid: refine where the force or strong vorticity is, one block of
+    // margin around it so features stay covered until the next regrid, and
+    // drop patches whose vorticity fell below half the threshold.
+    void regrid(const LBMForce* force) {
+        int blocks = blocksX * blocksY;
+        std::vector<uint8_t> hot(blocks, 0);
+        for (int b = 0; b < blocks; b++) {
+            float limit = blockPatch[b] >= 0 ? 0.5f * vorticityThreshold : vorticityThreshold;
+            hot[b] = blockVorticity(b) > limit;
+        }
+        std::vector<uint8_t> want(blocks, 0);
+        for (int b = 0; b < blocks; b++) {
+            if (!hot[b]) continue;
+            int bx = b % blocksX, by = b / blocksX;
+            for (int ny = std::max(by - 1, 0); ny <= std::min(by + 1, blocksY - 1); ny++) {
+                for (int nx = std::max(bx - 1, 0); nx <= std::min(bx + 1, blocksX - 1); nx++) {
+                    want[ny * blocksX + nx] = 1;
+                }
+            }
+        }
+        if (force) markForce(*force, want);
+        for (int b = 0; b < blocks; b++) {
+            if (want[b] && blockPatch[b] < 0) refine(b);
+            else if (!want[b] && blockPatch[b] >= 0) coarsen(b);
+        }
+    }
+
+    // keep the start-of-step coarse state around every patch (block + 1 cell)
+    void saveCoarse() {
+        size_t cells = size_t(NX) * NY;
+        for (int slot : activePatches) {
+            const FinePatch& p = patches[slot];
+            int x0 = std::max(p.x0 / 2 - 1, 0), x1 = std::min((p.x0 + p.width) / 2 + 1, NX);
+            int y0 = std::max(p.y0 / 2 - 1, 0), y1 = std::min((p.y0 + p.height) / 2 + 1, NY);
+            for (int i = 0; i < Q; i++) {
+                const float* now = coarse.population(i);
+                float* before = coarsePrev.data() + size_t(i) * cells;
+                for (int y = y0; y < y1; y++) {
+                    std::copy(now + size_t(y) * NX + x0, now + size_t(y) * NX + x1, before + size_t(y) * NX + x0);
+                }
+            }
+        }
+    }
+
+    // one fine step on every patch; alpha is the coarse time of this substep
+    void fineStep(float alpha, const LBMForce* force) {
+        int cur = fineCurrent;
+        int nxt = 1 - cur;
+        float omega = 1.0f / tauFine;
+
+        // force and collision on the interior cells
+        forEachPatch([&](int slot) {
+            FinePatch& p = patches[slot];
+            float* f[Q];
+            for (int i = 0; i < Q; i++) f[i] = patchData(p, cur, i);
+            for (int ly = 1; ly <= p.height; ly++) {
+                size_t row = size_t(ly) * pitch;
+                if (force) {
+                    float cell[Q];
+                    for (int lx = 1; lx <= p.width; lx++) {
+                        for (int i = 0; i < Q; i++) cell[i] = f[i][row + lx];
+                        forceCell(cell, p.x0 + lx - 1, p.y0 + ly - 1, *force);
+                        for (int i = 0; i < Q; i++) f[i][row + lx] = cell[i];
+                    }
+                }
+                collisionKernel(f, f, row + 1, row + 1 + p.width, omega);
+            }
+        });
+
+        // post-collision ghost ring: refined neighbours copy, the rest is
+        // interpolated from the coarse level, rescaled and collided
+        float ghostFactor = (1.0f - omega) * tauFine / (2.0f * tauCoarse);
+        forEachPatch([&](int slot) {
+            FinePatch& p = patches[slot];
+            float cell[Q];
+            for (int ly = 0; ly <= p.height + 1; ly++) {
+                int gy = p.y0 + ly - 1;
+                if (gy < 0 || gy >= 2 * NY) continue;
+                bool edgeRow = ly == 0 || ly == p.height + 1;
+                for (int lx = 0; lx <= p.width + 1; lx += edgeRow ? 1 : p.width + 1) {
+                    int gx = p.x0 + lx - 1;
+                    if (gx < 0 || gx >= 2 * NX) continue;
+                    size_t c = size_t(ly) * pitch + lx;
+                    int other = blockPatch[blockOf(gx, gy)];
+                    if (other >= 0) {
+                        FinePatch& q = patches[other];
+                        size_t qc = size_t(gy - q.y0 + 1) * pitch + (gx - q.x0 + 1);
+                        for (int i = 0; i < Q; i++) patchData(p, cur, i)[c] = patchData(q, cur, i)[qc];
+                    } else {
+                        sampleCoarse(gx, gy, alpha, cell);
+                        rescale(cell, ghostFactor);
+                        for (int i = 0; i < Q; i++) patchData(p, cur, i)[c] = cell[i];
+                    }
+                }
+            }
+        });
+
+        // pull streaming into the other buffer, half-way bounce-back at the walls
+        forEachPatch([&](int slot) {
+            FinePatch& p = patches[slot];
+            for (int i = 0; i < Q; i++) {
+                const float* from = patchData(p, cur, i);
+                float* to = patchData(p, nxt, i);
+                ptrdiff_t shift = -ptrdiff_t(LBMCpuEngine::ey[i]) * pitch - LBMCpuEngine::ex[i];
+                for (int ly = 1; ly <= p.height; ly++) {
+                    size_t row = size_t(ly) * pitch + 1;
+                    std::copy(from + row + shift, from + row + shift + p.width, to + row);
+                }
+            }
+            bool wall = p.x0 == 0 || p.y0 == 0 || p.x0 + p.width == 2 * NX || p.y0 + p.height == 2 * NY;
+            if (!wall) return;
+            for (int ly = 1; ly <= p.height; ly++) {
+                int gy = p.y0 + ly - 1;
+                for (int lx = 1; lx <= p.width; lx++) {
+                    int gx = p.x0 + lx - 1;
+                    if (gx > 0 && gy > 0 && gx < 2 * NX - 1 && gy < 2 * NY - 1) continue;
+                    size_t c = size_t(ly) * pitch + lx;
+                    for (int i = 0; i < Q; i++) {
+                        int sx = gx - LBMCpuEngine::ex[i];
+                        int sy = gy - LBMCpuEngine::ey[i];
+                        if (sx >= 0 && sy >= 0 && sx < 2 * NX && sy < 2 * NY) continue;
+                        patchData(p, nxt, i)[c] = patchData(p, cur, LBMCpuEngine::opp[i])[c];
+                    }
+                }
+            }
+        });
+
+        fineCurrent = nxt;
+    }
+
+    // coarse cells under a patch take the rescaled mean of their fine cells
+    void restrictToCoarse() {
+        float factor = 2.0f * tauCoarse / tauFine;
+        float* out[Q];
+        for (int i = 0; i < Q; i++) out[i] = coarse.population(i);
+        forEachPatch([&](int slot) {
+            FinePatch& p = patches[slot];
+            const float* f[Q];
+            for (int i = 0; i < Q; i++) f[i] = patchData(p, fineCurrent, i);
+            float cell[Q];
+            for (int cy = 0; cy < p.height / 2; cy++) {
+                for (int cx = 0; cx < p.width / 2; cx++) {
+                    size_t c = size_t(2 * cy + 1) * pitch + 2 * cx + 1;
+                    for (int i = 0; i < Q; i++) {
+                        cell[i] = 0.25f * (f[i][c] + f[i][c + 1] + f[i][c + pitch] + f[i][c + pitch + 1]);
+                    }
+                    rescale(cell, factor);
+                    size_t target = size_t(p.y0 / 2 + cy) * NX + p.x0 / 2 + cx;
+                    for (int i = 0; i < Q; i++) out[i][target] = cell[i];
+                }
+            }
+        });
+    }
+
+public:
+    LBMRefinedEngine(int nx, int ny, float tau, int blockSize = 16, int threads = 0,
+                     SimdIsa isa = detectSimdIsa())
+        : coarse(nx, ny, tau, threads, isa, LBMScheme::Split), NX(nx), NY(ny), tauCoarse(tau),
+          tauFine(2.0f * (tau - 0.5f) + 0.5f), blockSize(std::max(blockSize, 1)),
+          collisionKernel(collisionKernelFor(isa)) {
+        blocksX = (NX + this->blockSize - 1) / this->blockSize;
+        blocksY = (NY + this->blockSize - 1) / this->blockSize;
+        pitch = 2 * this->blockSize + 2;
+        patchPlane = size_t(pitch) * pitch;
+        blockPatch.assign(size_t(blocksX) * blocksY, -1);
+        coarsePrev.resize(size_t(NX) * NY * Q);
+    }
+
+    int width() const { return NX; }
+    int height() const { return NY; }
+    int threads() const { return coarse.threads(); }
+    long long steps() const { return stepCount; }
+    float fineTau() const { return tauFine; }
+
+    // both levels relax with the same operator
+    void setCollisionModel(CollisionModel model) {
+        coarse.setCollisionModel(model);
+        collisionKernel = collisionKernelFor(coarse.simdIsa(), model);
+    }
+    int refinedBlocks() const { return int(activePatches.size()); }
+    double refinedFraction() const { return double(activePatches.size()) / double(blockPatch.size()); }
+    // coarse cell updates plus fine cell updates since initialize()
+    double cellUpdates() const { return double(NX) * NY * double(stepCount) + double(fineCells); }
+
+    // coarse fields; cells under a patch hold the restricted fine solution
+    const std::vector<float>& densityField() const { return coarse.densityField(); }
+    const std::vector<float>& velocityField() const { return coarse.velocityField(); }
+
+    // density at fine resolution (2 NX x 2 NY): patches where refined,
+    // the coarse cell repeated elsewhere
+    void fineDensity(std::vector<float>& out) {
+        out.resize(size_t(4) * NX * NY);
+        const std::vector<float>& rho = coarse.densityField();
+        for (int gy = 0; gy < 2 * NY; gy++) {
+            for (int gx = 0; gx < 2 * NX; gx++) out[size_t(gy) * 2 * NX + gx] = rho[size_t(gy / 2) * NX + gx / 2];
+        }
+        for (int slot : activePatches) {
+            FinePatch& p = patches[slot];
+            for (int ly = 1; ly <= p.height; ly++) {
+                for (int lx = 1; lx <= p.width; lx++) {
+                    float sum = 0.0f;
+                    for (int i = 0; i < Q; i++) sum += patchData(p, fineCurrent, i)[size_t(ly) * pitch + lx];
+                    out[size_t(p.y0 + ly - 1) * 2 * NX + p.x0 + lx - 1] = sum;
+                }
+            }
+        }
+    }
+
+    // |curl u| (coarse lattice units) above which a block is refined
+    void setVorticityThreshold(float threshold) { vorticityThreshold = threshold; }
+    // coarse steps between full regrids; blocks under the force refine at once
+    void setRegridInterval(int steps) { regridInterval = std::max(steps, 1); }
+
+    void initialize() {
+        coarse.initialize();
+        while (!activePatches.empty()) coarsen(patches[activePatches.back()].block);
+        fineCurrent = 0;
+        stepCount = 0;
+        fineCells = 0;
+    }
+
+    // one coarse step, two fine steps on every patch
+    void step(const LBMForce* force = nullptr) {
+        if (stepCount % regridInterval == 0) {
+            regrid(force);
+        } else if (force) {
+            std::vector<uint8_t> want(blockPatch.size(), 0);
+            markForce(*force, want);
+            for (size_t b = 0; b < want.size(); b++) {
+                if (want[b] && blockPatch[b] < 0) refine(int(b));
+            }
+        }
+
+        saveCoarse();
+        coarse.step(force);
+        if (!activePatches.empty()) {
+            fineStep(0.0f, force);
+            fineStep(0.5f, force);
+            restrictToCoarse();
+            coarse.computeMacroscopic();
+        }
+
+        for (int slot : activePatches) fineCells += 2LL * patches[slot].width * patches[slot].height;
+        stepCount++;
+    }
+
+    void advance(int steps, const LBMForce* force = nullptr) {
+        for (int s = 0; s < steps; s++) step(force);
+    }
+};
+
+#endif
@@ -0,0 +1,243 @@
+#ifndef LBM_SIMD_H
+#define LBM_SIMD_H
+
+#include <cstddef>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define LBM_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// BGK collision kernels over structure-of-arrays population planes.
+// src[i] / dst[i] point at plane i; [begin, end) is a range of cell indices.
+// Each ISA version is compiled with its own target attribute so a single
+// binary carries all of them and picks one at startup.
+
+enum class SimdIsa { Scalar, SSE2, AVX2, AVX512 };
+
+using CollisionKernel = void (*)(const float* const* src, float* const* dst,
+                                 std::size_t begin, std::size_t end, float omega);
+
+namespace lbm_simd {
+
+constexpr float W0 = 1.0f / 36.0f;  // diagonals (0, 2, 6, 8)
+constexpr float W1 = 1.0f / 9.0f;   // axis (1, 3, 5, 7)
+constexpr float W4 = 4.0f / 9.0f;   // rest
+
+inline void collideBGK_Scalar(const float* const* src, float* const* dst,
+                              std::size_t begin, std::size_t end, float omega) {
+    static constexpr float w[9] = {W0, W1, W0, W1, W4, W1, W0, W1, W0};
+    for (std::size_t c = begin; c < end; c++) {
+        float f[9];
+        for (int i = 0; i < 9; i++) f[i] = src[i][c];
+
+        float rho = f[0] + f[1] + f[2] + f[3] + f[4] + f[5] + f[6] + f[7] + f[8];
+        float jx = (f[2] + f[5] + f[8]) - (f[0] + f[3] + f[6]);
+        float jy = (f[0] + f[1] + f[2]) - (f[6] + f[7] + f[8]);
+        float ux = jx / rho;
+        float uy = jy / rho;
+        float base = 1.0f - 1.5f * (ux * ux + uy * uy);
+
+        const float eu[9] = {uy - ux, uy, ux + uy, -ux, 0.0f, ux, -ux - uy, -uy, ux - uy};
+        for (int i = 0; i < 9; i++) {
+            float feq = w[i] * rho * (base + eu[i] * (3.0f + 4.5f * eu[i]));
+            dst[i][c] = f[i] + (feq - f[i]) * omega;
+        }
+    }
+}
+
+#ifdef LBM_SIMD_X86
+
+__attribute__((target("sse2")))
+inline void collideBGK_SSE2(const float* const* src, float* const* dst,
+                            std::size_t begin, std::size_t end, float omega) {
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 c15 = _mm_set1_ps(1.5f);
+    const __m128 c3 = _mm_set1_ps(3.0f);
+    const __m128 c45 = _mm_set1_ps(4.5f);
+    const __m128 om = _mm_set1_ps(omega);
+    const __m128 w[9] = {
+        _mm_set1_ps(W0), _mm_set1_ps(W1), _mm_set1_ps(W0),
+        _mm_set1_ps(W1), _mm_set1_ps(W4), _mm_set1_ps(W1),
+        _mm_set1_ps(W0), _mm_set1_ps(W1), _mm_set1_ps(W0)
+    };
+
+    std::size_t c = begin;
+    for (; c + 4 <= end; c += 4) {
+        __m128 f[9];
+        for (int i = 0; i < 9; i++) f[i] = _mm_loadu_ps(src[i] + c);
+
+        __m128 rho = _mm_add_ps(_mm_add_ps(_mm_add_ps(f[0], f[1]), _mm_add_ps(f[2], f[3])),
+                                _mm_add_ps(_mm_add_ps(f[4], f[5]), _mm_add_ps(f[6], f[7])));
+        rho = _mm_add_ps(rho, f[8]);
+        __m128 jx = _mm_sub_ps(_mm_add_ps(_mm_add_ps(f[2], f[5]), f[8]),
+                               _mm_add_ps(_mm_add_ps(f[0], f[3]), f[6]));
+        __m128 jy = _mm_sub_ps(_mm_add_ps(_mm_add_ps(f[0], f[1]), f[2]),
+                               _mm_add_ps(_mm_add_ps(f[6], f[7]), f[8]));
+        __m128 inv = _mm_div_ps(one, rho);
+        __m128 ux = _mm_mul_ps(jx, inv);
+        __m128 uy = _mm_mul_ps(jy, inv);
+        __m128 u2 = _mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uy, uy));
+        __m128 base = _mm_sub_ps(one, _mm_mul_ps(c15, u2));
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 eu[9] = {
+            _mm_sub_ps(uy, ux), uy, _mm_add_ps(ux, uy),
+            _mm_sub_ps(zero, ux), zero, ux,
+            _mm_sub_ps(zero, _mm_add_ps(ux, uy)), _mm_sub_ps(zero, uy), _mm_sub_ps(ux, uy)
+        };
+        for (int i = 0; i < 9; i++) {
+            __m128 poly = _mm_add_ps(base, _mm_mul_ps(eu[i], _mm_add_ps(c3, _mm_mul_ps(c45, eu[i]))));
+            __m128 feq = _mm_mul_ps(_mm_mul_ps(w[i], rho), poly);
+            _mm_storeu_ps(dst[i] + c, _mm_add_ps(f[i], _mm_mul_ps(_mm_sub_ps(feq, f[i]), om)));
+        }
+    }
+    collideBGK_Scalar(src, dst, c, end, omega);
+}
+
+__attribute__((target("avx2,fma")))
+inline void collideBGK_AVX2(const float* const* src, float* const* dst,
+                            std::size_t begin, std::size_t end, float omega) {
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 c15 = _mm256_set1_ps(1.5f);
+    const __m256 c3 = _mm256_set1_ps(3.0f);
+    const __m256 c45 = _mm256_set1_ps(4.5f);
+    const __m256 om = _mm256_set1_ps(omega);
+    const __m256 w[9] = {
+        _mm256_set1_ps(W0), _mm256_set1_ps(W1), _mm256_set1_ps(W0),
+        _mm256_set1_ps(W1), _mm256_set1_ps(W4), _mm256_set1_ps(W1),
+        _mm256_set1_ps(W0), _mm256_set1_ps(W1), _mm256_set1_ps(W0)
+    };
+
+    std::size_t c = begin;
+    for (; c + 8 <= end; c += 8) {
+        __m256 f[9];
+        for (int i = 0; i < 9; i++) f[i] = _mm256_loadu_ps(src[i] + c);
+
+        __m256 rho = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(f[0], f[1]), _mm256_add_ps(f[2], f[3])),
+                                   _mm256_add_ps(_mm256_add_ps(f[4], f[5]), _mm256_add_ps(f[6], f[7])));
+        rho = _mm256_add_ps(rho, f[8]);
+        __m256 jx = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(f[2], f[5]), f[8]),
+                                  _mm256_add_ps(_mm256_add_ps(f[0], f[3]), f[6]));
+        __m256 jy = _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(f[0], f[1]), f[2]),
+                                  _mm256_add_ps(_mm256_add_ps(f[6], f[7]), f[8]));
+        __m256 inv = _mm256_div_ps(one, rho);
+        __m256 ux = _mm256_mul_ps(jx, inv);
+        __m256 uy = _mm256_mul_ps(jy, inv);
+        __m256 u2 = _mm256_fmadd_ps(ux, ux, _mm256_mul_ps(uy, uy));
+        __m256 base = _mm256_fnmadd_ps(c15, u2, one);
+
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 eu[9] = {
+            _mm256_sub_ps(uy, ux), uy, _mm256_add_ps(ux, uy),
+            _mm256_sub_ps(zero, ux), zero, ux,
+            _mm256_sub_ps(zero, _mm256_add_ps(ux, uy)), _mm256_sub_ps(zero, uy), _mm256_sub_ps(ux, uy)
+        };
+        for (int i = 0; i < 9; i++) {
+            __m256 poly = _mm256_fmadd_ps(eu[i], _mm256_fmadd_ps(c45, eu[i], c3), base);
+            __m256 feq = _mm256_mul_ps(_mm256_mul_ps(w[i], rho), poly);
+            _mm256_storeu_ps(dst[i] + c, _mm256_fmadd_ps(_mm256_sub_ps(feq, f[i]), om, f[i]));
+        }
+    }
+    collideBGK_Scalar(src, dst, c, end, omega);
+}
+
+__attribute__((target("avx512f")))
+inline void collideBGK_AVX512(const float* const* src, float* const* dst,
+                              std::size_t begin, std::size_t end, float omega) {
+    const __m512 one = _mm512_set1_ps(1.0f);
+    const __m512 c15 = _mm512_set1_ps(1.5f);
+    const __m512 c3 = _mm512_set1_ps(3.0f);
+    const __m512 c45 = _mm512_set1_ps(4.5f);
+    const __m512 om = _mm512_set1_ps(omega);
+    const __m512 w[9] = {
+        _mm512_set1_ps(W0), _mm512_set1_ps(W1), _mm512_set1_ps(W0),
+        _mm512_set1_ps(W1), _mm512_set1_ps(W4), _mm512_set1_ps(W1),
+        _mm512_set1_ps(W0), _mm512_set1_ps(W1), _mm512_set1_ps(W0)
+    };
+
+    std::size_t c = begin;
+    for (; c + 16 <= end; c += 16) {
+        __m512 f[9];
+        for (int i = 0; i < 9; i++) f[i] = _mm512_loadu_ps(src[i] + c);
+
+        __m512 rho = _mm512_add_ps(_mm512_add_ps(_mm512_add_ps(f[0], f[1]), _mm512_add_ps(f[2], f[3])),
+                                   _mm512_add_ps(_mm512_add_ps(f[4], f[5]), _mm512_add_ps(f[6], f[7])));
+        rho = _mm512_add_ps(rho, f[8]);
+        __m512 jx = _mm512_sub_ps(_mm512_add_ps(_mm512_add_ps(f[2], f[5]), f[8]),
+                                  _mm512_add_ps(_mm512_add_ps(f[0], f[3]), f[6]));
+        __m512 jy = _mm512_sub_ps(_mm512_add_ps(_mm512_add_ps(f[0], f[1]), f[2]),
+                                  _mm512_add_ps(_mm512_add_ps(f[6], f[7]), f[8]));
+        __m512 inv = _mm512_div_ps(one, rho);
+        __m512 ux = _mm512_mul_ps(jx, inv);
+        __m512 uy = _mm512_mul_ps(jy, inv);
+        __m512 u2 = _mm512_fmadd_ps(ux, ux, _mm512_mul_ps(uy, uy));
+        __m512 base = _mm512_fnmadd_ps(c15, u2, one);
+
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 eu[9] = {
+            _mm512_sub_ps(uy, ux), uy, _mm512_add_ps(ux, uy),
+            _mm512_sub_ps(zero, ux), zero, ux,
+            _mm512_sub_ps(zero, _mm512_add_ps(ux, uy)), _mm512_sub_ps(zero, uy), _mm512_sub_ps(ux, uy)
+        };
+        for (int i = 0; i < 9; i++) {
+            __m512 poly = _mm512_fmadd_ps(eu[i], _mm512_fmadd_ps(c45, eu[i], c3), base);
+            __m512 feq = _mm512_mul_ps(_mm512_mul_ps(w[i], rho), poly);
+            _mm512_storeu_ps(dst[i] + c, _mm512_fmadd_ps(_mm512_sub_ps(feq, f[i]), om, f[i]));
+        }
+    }
+    collideBGK_Scalar(src, dst, c, end, omega);
+}
+
+#endif // LBM_SIMD_X86
+
+} // namespace lbm_simd
+
+inline const char* simdIsaName(SimdIsa isa) {
+    switch (isa) {
+        case SimdIsa::SSE2: return "SSE2";
+        case SimdIsa::AVX2: return "AVX2";
+        case SimdIsa::AVX512: return "AVX-512";
+        default: return "scalar";
+    }
+}
+
+// best instruction set the running CPU supports
+inline SimdIsa detectSimdIsa() {
+#ifdef LBM_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdIsa::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdIsa::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdIsa::SSE2;
+#endif
+    return SimdIsa::Scalar;
+}
+
+// "scalar", "sse2", "avx2" or "avx512"; anything else means auto-detect.
+// A request above what the CPU supports is clamped to the detected ISA.
+inline SimdIsa parseSimdIsa(const char* name) {
+    SimdIsa best = detectSimdIsa();
+    SimdIsa wanted = best;
+    if (name && !std::strcmp(name, "scalar")) wanted = SimdIsa::Scalar;
+    else if (name && !std::strcmp(name, "sse2")) wanted = SimdIsa::SSE2;
+    else if (name && !std::strcmp(name, "avx2")) wanted = SimdIsa::AVX2;
+    else if (name && !std::strcmp(name, "avx512")) wanted = SimdIsa::AVX512;
+    return int(wanted) < int(best) ? wanted : best;
+}
+
+inline CollisionKernel collisionKernelFor(SimdIsa isa) {
+#ifdef LBM_SIMD_X86
+    switch (isa) {
+        case SimdIsa::AVX512: return lbm_simd::collideBGK_AVX512;
+        case SimdIsa::AVX2: return lbm_simd::collideBGK_AVX2;
+        case SimdIsa::SSE2: return lbm_simd::collideBGK_SSE2;
+        default: break;
+    }
+#else
+    (void)isa;
+#endif
+    return lbm_simd::collideBGK_Scalar;
+}
+
+#endif
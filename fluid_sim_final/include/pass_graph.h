@@ -0,0 +1,381 @@
+#ifndef PASS_GRAPH_H
+#define PASS_GRAPH_H
+
+#include <glad/glad.h>
+#include <roofline.h>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// Declarative graph of full-screen simulation passes.
+//
+// A resource is a group of same-sized textures that passes sample or render
+// to together (the three distribution textures, density + velocity). A
+// ping-pong resource has two physical copies and the graph alone knows which
+// one is current: a pass that renders to it writes the other copy, which
+// becomes current once the pass ran. Passes only declare what they sample and
+// what they render to; the graph allocates textures and framebuffers on first
+// use and skips program, framebuffer and texture binds that are already in
+// place. A pipeline is a schedule of pass names, so passes are reordered,
+// swapped for a fused equivalent or dropped without touching buffer plumbing.
+
+struct PassTexture {
+    GLenum internalFormat;
+    GLenum format;
+    GLenum filter = GL_NEAREST;
+};
+
+class PassGraph {
+public:
+    using Resource = int;
+
+    struct Input {
+        Resource resource;
+        GLuint firstUnit;  // texture i of the resource is bound to unit firstUnit + i
+    };
+
+    struct Pass {
+        std::string name;
+        std::function<void()> bind;      // binds the pass's shader program
+        std::vector<Input> inputs;
+        std::vector<Resource> outputs;   // color attachments in order, at most one ping-pong
+        std::function<bool()> enabled;   // skip the pass this step when false; empty = always
+        std::function<void()> before;    // per-pass uniforms and image bindings
+        std::function<void()> after;     // barriers
+        double imageBytes = 0.0;         // per cell read and again written through images or SSBOs
+    };
+
+private:
+    struct ResourceData {
+        std::string name;
+        std::vector<PassTexture> layout;
+        bool pingPong;
+        std::vector<GLuint> textures[2];
+        int current = 0;
+    };
+
+    struct CompiledPass {
+        GLuint program = 0;
+        GLuint framebuffer[2] = {};  // indexed by the current copy of the ping-pong output
+        Resource flip = -1;          // ping-pong output, -1 when there is none
+    };
+
+    int width = 0;
+    int height = 0;
+    std::vector<ResourceData> resources;
+    std::vector<Pass> passes;
+    std::vector<CompiledPass> compiled;
+    std::vector<bool> ready;
+    std::vector<int> schedule;
+    std::map<std::vector<GLuint>, GLuint> framebuffers;  // one per distinct attachment list
+    std::function<void()> draw;
+    std::function<void(const std::string&)> beginPass;  // timing hooks, may be empty
+    std::function<void()> endPass;
+
+    // bound state, reset at the start of every execute() and run()
+    GLuint boundProgram = 0;
+    GLuint boundFramebuffer = 0;
+    GLuint boundTextures[16] = {};
+
+    // bytes of one texel of the formats the passes use
+    static double texelBytes(GLenum internalFormat) {
+        switch (internalFormat) {
+            case GL_RGBA32F: return 16.0;
+            case GL_RGBA16F:
+            case GL_RG32F: return 8.0;
+            case GL_RG16F:
+            case GL_R32F: return 4.0;
+            case GL_R16F: return 2.0;
+            case GL_R8:
+            case GL_R8UI: return 1.0;
+            default: return 4.0;
+        }
+    }
+
+    double resourceBytes(Resource r) const {
+        double bytes = 0.0;
+        for (const PassTexture& t : resources[r].layout) bytes += texelBytes(t.internalFormat);
+        return bytes;
+    }
+
+    int find(const std::string& name) const {
+        for (size_t i = 0; i < passes.size(); i++) {
+            if (passes[i].name == name) return int(i);
+        }
+        return -1;
+    }
+
+    void allocate(ResourceData& r) {
+        if (!r.textures[0].empty()) return;
+        for (int copy = 0; copy < (r.pingPong ? 2 : 1); copy++) {
+            for (const PassTexture& t : r.layout) {
+                GLuint id;
+                glGenTextures(1, &id);
+                glBindTexture(GL_TEXTURE_2D, id);
+                glTexImage2D(GL_TEXTURE_2D, 0, t.internalFormat, width, height, 0, t.format, GL_FLOAT, nullptr);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, t.filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, t.filter);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+                r.textures[copy].push_back(id);
+            }
+        }
+    }
+
+    GLuint framebufferFor(const std::vector<GLuint>& attachments) {
+        auto it = framebuffers.find(attachments);
+        if (it != framebuffers.end()) return it->second;
+        GLuint fbo;
+        glGenFramebuffers(1, &fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        std::vector<GLenum> drawBuffers;
+        for (size_t i = 0; i < attachments.size(); i++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GLenum(GL_COLOR_ATTACHMENT0 + i), GL_TEXTURE_2D,
+                                   attachments[i], 0);
+            drawBuffers.push_back(GLenum(GL_COLOR_ATTACHMENT0 + i));
+        }
+        glDrawBuffers(GLsizei(drawBuffers.size()), drawBuffers.data());
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            glDeleteFramebuffers(1, &fbo);
+            fbo = 0;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        framebuffers[attachments] = fbo;
+        return fbo;
+    }
+
+    // textures, program and framebuffers of pass p
+    bool prepare(int p) {
+        if (ready[p]) return true;
+        const Pass& pass = passes[p];
+        CompiledPass& c = compiled[p];
+        for (Resource r : pass.outputs) {
+            if (!resources[r].pingPong) {
+                for (const Input& in : pass.inputs) {
+                    if (in.resource == r) {
+                        std::cerr << "ERROR: pass " << pass.name << " samples " << resources[r].name
+                                  << " while rendering to it" << std::endl;
+                        return false;
+                    }
+                }
+                continue;
+            }
+            if (c.flip >= 0) {
+                std::cerr << "ERROR: pass " << pass.name << " renders to two ping-pong resources" << std::endl;
+                return false;
+            }
+            c.flip = r;
+        }
+        for (const Input& in : pass.inputs) allocate(resources[in.resource]);
+        for (Resource r : pass.outputs) allocate(resources[r]);
+
+        for (int current = 0; current < (c.flip >= 0 ? 2 : 1); current++) {
+            std::vector<GLuint> attachments;
+            for (Resource r : pass.outputs) {
+                const ResourceData& res = resources[r];
+                const std::vector<GLuint>& copy = res.textures[res.pingPong ? 1 - current : 0];
+                attachments.insert(attachments.end(), copy.begin(), copy.end());
+            }
+            c.framebuffer[current] = framebufferFor(attachments);
+            if (!c.framebuffer[current]) {
+                std::cerr << "ERROR: framebuffer of pass " << pass.name << " incomplete!" << std::endl;
+                return false;
+            }
+        }
+
+        GLint previous;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &previous);
+        pass.bind();
+        GLint program;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        glUseProgram(GLuint(previous));
+        c.program = GLuint(program);
+        ready[p] = true;
+        return true;
+    }
+
+    void resetState() {
+        boundProgram = 0;
+        boundFramebuffer = 0;
+        for (GLuint& t : boundTextures) t = 0;
+        glViewport(0, 0, width, height);
+    }
+
+    void launch(int p) {
+        const Pass& pass = passes[p];
+        if (pass.enabled && !pass.enabled()) return;
+        CompiledPass& c = compiled[p];
+
+        if (boundProgram != c.program) {
+            glUseProgram(c.program);
+            boundProgram = c.program;
+        }
+        GLuint fbo = c.framebuffer[c.flip >= 0 ? resources[c.flip].current : 0];
+        if (boundFramebuffer != fbo) {
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+            boundFramebuffer = fbo;
+        }
+        for (const Input& in : pass.inputs) {
+            const ResourceData& res = resources[in.resource];
+            const std::vector<GLuint>& copy = res.textures[res.pingPong ? res.current : 0];
+            for (size_t i = 0; i < copy.size(); i++) {
+                GLuint unit = in.firstUnit + GLuint(i);
+                if (unit < 16 && boundTextures[unit] == copy[i]) continue;
+                glActiveTexture(GL_TEXTURE0 + unit);
+                glBindTexture(GL_TEXTURE_2D, copy[i]);
+                if (unit < 16) boundTextures[unit] = copy[i];
+            }
+        }
+
+        if (beginPass) beginPass(pass.name);
+        if (pass.before) pass.before();
+        draw();
+        if (pass.after) pass.after();
+        if (endPass) endPass();
+        if (c.flip >= 0) resources[c.flip].current = 1 - resources[c.flip].current;
+    }
+
+public:
+    void setSize(int w, int h) {
+        width = w;
+        height = h;
+    }
+
+    // issues the full-screen draw of a pass
+    void setDrawCall(std::function<void()> call) { draw = std::move(call); }
+
+    // called around every pass that runs, e.g. for GPU timer queries
+    void setPassHooks(std::function<void(const std::string&)> begin, std::function<void()> end) {
+        beginPass = std::move(begin);
+        endPass = std::move(end);
+    }
+
+    Resource addResource(const std::string& name, std::vector<PassTexture> layout, bool pingPong) {
+        ResourceData r;
+        r.name = name;
+        r.layout = std::move(layout);
+        r.pingPong = pingPong;
+        resources.push_back(std::move(r));
+        return Resource(resources.size() - 1);
+    }
+
+    void addPass(Pass pass) {
+        passes.push_back(std::move(pass));
+        compiled.emplace_back();
+        ready.push_back(false);
+    }
+
+    // Bytes per cell a pass moves as declared: one texel of every texture it
+    // samples and of every one it renders to, plus its image traffic each way.
+    PassTraffic traffic(const std::string& name) const {
+        PassTraffic t;
+        t.name = name;
+        int p = find(name);
+        if (p < 0) return t;
+        for (const Input& in : passes[p].inputs) t.readBytes += resourceBytes(in.resource);
+        for (Resource r : passes[p].outputs) t.writeBytes += resourceBytes(r);
+        t.readBytes += passes[p].imageBytes;
+        t.writeBytes += passes[p].imageBytes;
+        return t;
+    }
+
+    // Steps run these passes in order. Every resource a scheduled pass samples
+    // must be rendered by some scheduled pass, or it would never change.
+    bool setSchedule(const std::vector<std::string>& names) {
+        std::vector<int> order;
+        for (const std::string& name : names) {
+            int p = find(name);
+            if (p < 0) {
+                std::cerr << "ERROR: unknown pass " << name << std::endl;
+                return false;
+            }
+            if (!prepare(p)) return false;
+            order.push_back(p);
+        }
+        for (int p : order) {
+            for (const Input& in : passes[p].inputs) {
+                bool written = false;
+                for (int q : order) {
+                    for (Resource r : passes[q].outputs) written = written || r == in.resource;
+                }
+                if (!written) {
+                    std::cerr << "ERROR: pass " << passes[p].name << " samples "
+                              << resources[in.resource].name << " but no scheduled pass renders it" << std::endl;
+                    return false;
+                }
+            }
+        }
+        schedule = order;
+        return true;
+    }
+
+    std::vector<std::string> scheduledPasses() const {
+        std::vector<std::string> names;
+        for (int p : schedule) names.push_back(passes[p].name);
+        return names;
+    }
+
+    // one step: every scheduled pass that is enabled
+    void execute() {
+        resetState();
+        for (int p : schedule) launch(p);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // a single pass outside the schedule (initialization, refreshing outputs)
+    bool run(const std::string& name) {
+        int p = find(name);
+        if (p < 0 || !prepare(p)) return false;
+        resetState();
+        launch(p);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return true;
+    }
+
+    // makes both copies of a ping-pong resource hold the current contents
+    void copyToOther(Resource r) {
+        ResourceData& res = resources[r];
+        if (!res.pingPong) return;
+        // a blit reads one attachment only, so each texture gets its own
+        for (size_t i = 0; i < res.layout.size(); i++) {
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, framebufferFor({res.textures[res.current][i]}));
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebufferFor({res.textures[1 - res.current][i]}));
+            glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // fills texture i of the current copy with value
+    void clear(Resource r, int i, const float value[4]) {
+        ResourceData& res = resources[r];
+        allocate(res);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebufferFor({res.textures[res.pingPong ? res.current : 0][i]}));
+        glClearBufferfv(GL_COLOR, 0, value);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    // texture i of the current copy, 0 before the resource is allocated
+    GLuint texture(Resource r, int i) const {
+        const ResourceData& res = resources[r];
+        const std::vector<GLuint>& copy = res.textures[res.pingPong ? res.current : 0];
+        return size_t(i) < copy.size() ? copy[i] : 0;
+    }
+
+    void release() {
+        for (auto& entry : framebuffers) glDeleteFramebuffers(1, &entry.second);
+        framebuffers.clear();
+        for (ResourceData& r : resources) {
+            for (auto& copy : r.textures) {
+                if (!copy.empty()) glDeleteTextures(GLsizei(copy.size()), copy.data());
+                copy.clear();
+            }
+        }
+        for (size_t i = 0; i < ready.size(); i++) ready[i] = false;
+        compiled.assign(compiled.size(), CompiledPass{});
+        schedule.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <thread_pool.h>
+#include <aligned_allocator.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unistd.h>
+
+// Bandwidth bookkeeping for the simulation passes.
+//
+// Every pass declares the bytes per cell it must move at least: each
+// population plane or texture it streams in once, each one it streams out
+// once. Reuse of neighbours through the cache is assumed perfect, so the
+// model is a lower bound on DRAM traffic. Time per pass turns it into an
+// achieved bandwidth, and the STREAM probe below gives the ceiling to hold
+// it against: a pass near 100% is bandwidth-bound, one far below spends its
+// time on arithmetic, latency or synchronization instead.
+struct PassTraffic {
+    std::string name;
+    double readBytes = 0.0;   // per cell
+    double writeBytes = 0.0;  // per cell
+    double bytes() const { return readBytes + writeBytes; }
+};
+
+// wall time a pass has accumulated over `runs` runs
+struct PassTime {
+    std::string name;
+    double seconds = 0.0;
+    long long runs = 0;
+};
+
+// GB/s of moving bytesPerCell over `cells` cells in `seconds`
+inline double achievedBandwidth(double bytesPerCell, double cells, double seconds) {
+    return seconds > 0.0 ? bytesPerCell * cells / seconds * 1e-9 : 0.0;
+}
+
+// best of each STREAM kernel, in GB/s
+struct StreamBandwidth {
+    double copy = 0.0;
+    double scale = 0.0;
+    double add = 0.0;
+    double triad = 0.0;
+    double peak() const { return std::max({copy, scale, add, triad}); }
+};
+
+// Elements per STREAM array: four times the last-level cache as STREAM
+// asks, at least 8M (64 MiB), and no more than a quarter of physical memory
+// for all three arrays together.
+inline size_t streamElements() {
+    size_t elements = size_t(1) << 23;
+    long cache = 0;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    cache = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (cache <= 0) cache = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    if (cache > 0) elements = std::max(elements, 4 * size_t(cache) / sizeof(double));
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0) {
+        size_t limit = size_t(pages) * size_t(pageSize) / 4 / (3 * sizeof(double));
+        elements = std::min(elements, std::max(limit, size_t(1) << 20));
+    }
+    return std::min(elements, size_t(1) << 30);
+}
+
+// STREAM-style probe of host memory bandwidth: copy, scale, add and triad
+// over three double arrays of streamElements() each, split across the pool
+// like the engine's passes. Bytes count as in STREAM, without write-allocate
+// traffic, so the numbers compare with published STREAM results and with
+// PassTraffic.
+inline StreamBandwidth measureStreamBandwidth(ThreadPool& pool, int repeats = 5) {
+    int elements = int(streamElements());
+    size_t n = size_t(elements);
+    AlignedVector<double> a(n), b(n), c(n);
+    double* pa = a.data();
+    double* pb = b.data();
+    double* pc = c.data();
+    const double q = 3.0;
+
+    pool.parallelFor(0, elements, [&](int lo, int hi) {
+        for (int i = lo; i < hi; i++) {
+            pa[i] = 1.0;
+            pb[i] = 2.0;
+            pc[i] = 0.0;
+        }
+    });
+
+    // fastest of `repeats` runs, the first one included
+    auto best = [&](double bytesPerElement, auto kernel) {
+        double fastest = 0.0;
+        for (int r = 0; r < repeats; r++) {
+            auto start = std::chrono::steady_clock::now();
+            pool.parallelFor(0, elements, kernel);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (fastest == 0.0 || seconds < fastest) fastest = seconds;
+        }
+        return achievedBandwidth(bytesPerElement, double(elements), fastest);
+    };
+
+    StreamBandwidth result;
+    result.copy = best(2 * sizeof(double), [&](int lo, int hi) {
+        for (int i = lo; i < hi; i++) pc[i] = pa[i];
+    });
+    result.scale = best(2 * sizeof(double), [&](int lo, int hi) {
+        for (int i = lo; i < hi; i++) pb[i] = q * pc[i];
+    });
+    result.add = best(3 * sizeof(double), [&](int lo, int hi) {
+        for (int i = lo; i < hi; i++) pc[i] = pa[i] + pb[i];
+    });
+    result.triad = best(3 * sizeof(double), [&](int lo, int hi) {
+        for (int i = lo; i < hi; i++) pa[i] = pb[i] + q * pc[i];
+    });
+    return result;
+}
+
+#endif
@@ -2,7 +2,12 @@
 #define SHADER_HELPER_H
 
 #include <glad/glad.h>
+#include <vector>
+#include <cstring>
 
+// One-off uniform updates by name. Each call asks the driver for the bound
+// program and looks the name up again; per-step updates go through
+// UniformCache and UniformBuffer below instead.
 class ShaderHelper {
 public:
     static GLuint getCurrentProgram() {
@@ -30,4 +35,96 @@ public:
     }
 };
 
+// Uniform locations of one program, looked up once and kept. attach() right
+// after the program is bound for the first time; set*() expect the program
+// to be bound again. Names are compared by pointer first, so string literals
+// hit without a strcmp; they must outlive the cache.
+class UniformCache {
+private:
+    struct Entry {
+        const char* name;
+        GLint location;
+    };
+    GLuint program = 0;
+    std::vector<Entry> entries;
+
+public:
+    void attach(GLuint id) {
+        program = id;
+        entries.clear();
+    }
+
+    void attachCurrent() { attach(ShaderHelper::getCurrentProgram()); }
+
+    GLuint id() const { return program; }
+
+    GLint location(const char* name) {
+        for (const Entry& e : entries) {
+            if (e.name == name) return e.location;
+        }
+        for (const Entry& e : entries) {
+            if (!std::strcmp(e.name, name)) return e.location;
+        }
+        GLint loc = glGetUniformLocation(program, name);
+        entries.push_back({name, loc});
+        return loc;
+    }
+
+    void set1i(const char* name, int value) {
+        GLint loc = location(name);
+        if (loc >= 0) glUniform1i(loc, value);
+    }
+
+    void set1f(const char* name, float value) {
+        GLint loc = location(name);
+        if (loc >= 0) glUniform1f(loc, value);
+    }
+
+    void set2f(const char* name, float v1, float v2) {
+        GLint loc = location(name);
+        if (loc >= 0) glUniform2f(loc, v1, v2);
+    }
+};
+
+// std140 uniform buffer holding one T, shared by every program that declares
+// the matching block. T must already be laid out as std140 (scalars on 4
+// bytes, vec2 on 8, vec4 on 16, no vec3). One glBufferSubData per update
+// replaces a glUniform call per parameter per pass.
+template <typename T>
+class UniformBuffer {
+private:
+    GLuint buffer = 0;
+    GLuint binding = 0;
+
+public:
+    void create(GLuint bindingPoint) {
+        binding = bindingPoint;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), nullptr, GL_DYNAMIC_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // routes the named block of program to this buffer; false when the
+    // program does not use the block
+    bool attach(GLuint program, const char* blockName) const {
+        GLuint index = glGetUniformBlockIndex(program, blockName);
+        if (index == GL_INVALID_INDEX) return false;
+        glUniformBlockBinding(program, index, binding);
+        return true;
+    }
+
+    void update(const T& value) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(T), &value);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void destroy() {
+        glDeleteBuffers(1, &buffer);
+        buffer = 0;
+    }
+};
+
 #endif
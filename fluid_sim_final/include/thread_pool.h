@@ -0,0 +1,95 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <algorithm>
+
+// Persistent worker pool for the CPU engine. The calling thread joins in as
+// worker 0, so a pool of size 1 runs everything inline with no threads at all.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::function<void(int)> job;
+    unsigned long generation = 0;
+    int pending = 0;
+    bool stopping = false;
+
+    void workerLoop(int index) {
+        unsigned long seen = 0;
+        for (;;) {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            lock.unlock();
+
+            job(index);
+
+            lock.lock();
+            if (--pending == 0) done.notify_one();
+        }
+    }
+
+public:
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) threads = int(std::max(1u, std::thread::hardware_concurrency()));
+        for (int i = 1; i < threads; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& t : workers) t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return int(workers.size()) + 1; }
+
+    // runs fn(workerIndex) once on every worker and returns when all are done.
+    void run(const std::function<void(int)>& fn) {
+        if (workers.empty()) {
+            fn(0);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = fn;
+            pending = int(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        fn(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&] { return pending == 0; });
+    }
+
+    // splits [begin, end) into one contiguous chunk per worker: fn(lo, hi).
+    template <typename F>
+    void parallelFor(int begin, int end, F&& fn) {
+        int n = size();
+        int count = end - begin;
+        run([&](int w) {
+            int lo = begin + int((long long)count * w / n);
+            int hi = begin + int((long long)count * (w + 1) / n);
+            if (lo < hi) fn(lo, hi);
+        });
+    }
+};
+
+#endif
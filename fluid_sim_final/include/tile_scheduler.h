@@ -0,0 +1,148 @@
+#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <thread_pool.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <thread>
+
+// Work-stealing scheduler for lattice tiles. run() executes kernel(tile, step)
+// for every tile of a tilesX x tilesY grid and every step in [0, steps).
+// There is no barrier between steps: (tile, s) starts as soon as the tile and
+// its eight neighbours have finished s - 1, which is exactly when the halo
+// cells it pulls from are ready and nobody still reads the cells it overwrites.
+// Each worker pops its own newest task first (cache-warm tiles) and steals the
+// oldest task of another worker when it runs dry.
+class TileScheduler {
+public:
+    using Kernel = std::function<void(int tile, int step, int worker)>;
+
+private:
+    struct Task {
+        int tile;
+        int step;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    ThreadPool& pool;
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    // per tile and step parity: how many of (tile + neighbours) still have to
+    // finish the previous step
+    std::vector<std::atomic<int>> waiting;
+    std::vector<int> dependencies;
+    std::atomic<long long> remaining{0};
+    int tilesX = 0;
+    int tilesY = 0;
+    int steps = 0;
+
+    void push(int worker, Task task) {
+        WorkQueue& q = *queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        q.tasks.push_back(task);
+    }
+
+    bool popOwn(int worker, Task& task) {
+        WorkQueue& q = *queues[worker];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) return false;
+        task = q.tasks.back();
+        q.tasks.pop_back();
+        return true;
+    }
+
+    bool steal(int worker, Task& task) {
+        int n = int(queues.size());
+        for (int k = 1; k < n; k++) {
+            WorkQueue& q = *queues[(worker + k) % n];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.tasks.empty()) continue;
+            task = q.tasks.front();
+            q.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    template <typename F>
+    void forEachNeighbourhood(int tile, F&& fn) const {
+        int tx = tile % tilesX;
+        int ty = tile / tilesX;
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                int nx = tx + dx;
+                int ny = ty + dy;
+                if (nx < 0 || ny < 0 || nx >= tilesX || ny >= tilesY) continue;
+                fn(ny * tilesX + nx);
+            }
+        }
+    }
+
+    // tile finished step s: release (neighbour, s + 1) once all its inputs are in
+    void complete(int worker, Task done) {
+        int next = done.step + 1;
+        if (next < steps) {
+            forEachNeighbourhood(done.tile, [&](int t) {
+                std::atomic<int>& counter = waiting[size_t(t) * 2 + (next & 1)];
+                if (counter.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    // nobody touches this counter again before (t, next) has run
+                    counter.store(dependencies[t], std::memory_order_relaxed);
+                    push(worker, Task{t, next});
+                }
+            });
+        }
+        remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void workerLoop(int worker, const Kernel& kernel) {
+        Task task;
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (popOwn(worker, task) || steal(worker, task)) {
+                kernel(task.tile, task.step, worker);
+                complete(worker, task);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+public:
+    explicit TileScheduler(ThreadPool& pool) : pool(pool) {
+        for (int i = 0; i < pool.size(); i++) queues.emplace_back(new WorkQueue());
+    }
+
+    void run(int tilesX, int tilesY, int steps, const Kernel& kernel) {
+        if (steps <= 0 || tilesX <= 0 || tilesY <= 0) return;
+        this->tilesX = tilesX;
+        this->tilesY = tilesY;
+        this->steps = steps;
+
+        int tiles = tilesX * tilesY;
+        dependencies.assign(tiles, 0);
+        std::vector<std::atomic<int>> counters(size_t(tiles) * 2);
+        waiting.swap(counters);
+        for (int t = 0; t < tiles; t++) {
+            forEachNeighbourhood(t, [&](int) { dependencies[t]++; });
+            waiting[size_t(t) * 2 + 0].store(dependencies[t], std::memory_order_relaxed);
+            waiting[size_t(t) * 2 + 1].store(dependencies[t], std::memory_order_relaxed);
+        }
+        remaining.store((long long)tiles * steps, std::memory_order_relaxed);
+
+        // step 0 has no dependencies; deal contiguous blocks of tiles to workers
+        int workers = int(queues.size());
+        for (int t = 0; t < tiles; t++) {
+            push(int((long long)t * workers / tiles), Task{t, 0});
+        }
+
+        pool.run([&](int worker) { workerLoop(worker, kernel); });
+    }
+};
+
+#endif
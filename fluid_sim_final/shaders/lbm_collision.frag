@@ -8,7 +8,22 @@ layout(location = 2) out float distOut2;
 uniform sampler2D distTex0;
 uniform sampler2D distTex1;
 uniform sampler2D distTex2;
-uniform float tau;
+// per-frame parameters shared by every pass, one std140 buffer (LBMParams in main.cpp)
+layout(std140) uniform LBMParams {
+    vec2 gridSize;
+    float tau;
+    // rho0 when the textures hold deviations f_i - w_i * rho0, otherwise 0
+    float restOffset;
+    vec2 mousePos;
+    vec2 mouseVel;
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    // 0 = BGK, 1 = TRT, 2 = MRT
+    int collisionModel;
+    // velocity of the inlet cells of cellFlags
+    vec2 inletVelocity;
+};
 
 const float w[9] = float[9](
     1.0/36.0, 1.0/9.0, 1.0/36.0,
@@ -22,47 +37,95 @@ const ivec2 e[9] = ivec2[9](
     ivec2(-1,-1), ivec2(0,-1), ivec2(1,-1)
 );
 
+const int opp[9] = int[9](8, 7, 6, 5, 4, 3, 2, 1, 0);
+
 float equilibrium(int i, float rho, vec2 u) {
     float eu = float(e[i].x) * u.x + float(e[i].y) * u.y;
     float u2 = u.x * u.x + u.y * u.y;
     return w[i] * rho * (1.0 + 3.0 * eu + 4.5 * eu * eu - 1.5 * u2);
 }
 
+// TRT: even part of each (i, opp i) pair relaxes with 1/tau, odd part with
+// the rate for Lambda = 1/4. MRT: Lallemand-Luo moments, shear with 1/tau,
+// energy, energy square and heat flux with fixed rates (lbm_collision.h).
+const float TRT_MAGIC = 0.25;
+const float MRT_RATE_ENERGY = 1.64;
+const float MRT_RATE_ENERGY_SQUARE = 1.54;
+const float MRT_RATE_HEAT_FLUX = 1.9;
+
+void collide(inout float f[9], float rho, vec2 u) {
+    if (collisionModel == 1) {
+        float omega = 1.0 / tau;
+        float omegaMinus = 1.0 / (0.5 + TRT_MAGIC / (tau - 0.5));
+        float feq[9];
+        for (int i = 0; i < 9; i++) feq[i] = equilibrium(i, rho, u);
+        float g[9];
+        for (int i = 0; i < 9; i++) {
+            int o = opp[i];
+            float even = 0.5 * ((f[i] + f[o]) - (feq[i] + feq[o]));
+            float odd = 0.5 * ((f[i] - f[o]) - (feq[i] - feq[o]));
+            g[i] = f[i] - omega * even - omegaMinus * odd;
+        }
+        f = g;
+    } else if (collisionModel == 2) {
+        float me = 0.0, meps = 0.0, pxx = 0.0, pxy = 0.0;
+        vec2 q = vec2(0.0);
+        for (int i = 0; i < 9; i++) {
+            vec2 c = vec2(e[i]);
+            float c2 = dot(c, c);
+            me += (-4.0 + 3.0 * c2) * f[i];
+            meps += (4.0 - 10.5 * c2 + 4.5 * c2 * c2) * f[i];
+            q += (-5.0 + 3.0 * c2) * c * f[i];
+            pxx += (c.x * c.x - c.y * c.y) * f[i];
+            pxy += c.x * c.y * f[i];
+        }
+        // deviations from equilibrium, scaled by rate / squared row norm
+        vec2 j = rho * u;
+        float j2 = dot(j, u);
+        float de = MRT_RATE_ENERGY * (me - (-2.0 * rho + 3.0 * j2)) / 36.0;
+        float deps = MRT_RATE_ENERGY_SQUARE * (meps - (rho - 3.0 * j2)) / 36.0;
+        vec2 dq = MRT_RATE_HEAT_FLUX * (q + j) / 12.0;
+        float dxx = (pxx - (j.x * u.x - j.y * u.y)) / (4.0 * tau);
+        float dxy = (pxy - j.x * u.y) / (4.0 * tau);
+        for (int i = 0; i < 9; i++) {
+            vec2 c = vec2(e[i]);
+            float c2 = dot(c, c);
+            f[i] -= (-4.0 + 3.0 * c2) * de + (4.0 - 10.5 * c2 + 4.5 * c2 * c2) * deps +
+                    (-5.0 + 3.0 * c2) * dot(c, dq) + (c.x * c.x - c.y * c.y) * dxx + c.x * c.y * dxy;
+        }
+    } else {
+        for (int i = 0; i < 9; i++) {
+            f[i] += (equilibrium(i, rho, u) - f[i]) / tau;
+        }
+    }
+}
+
 void main() {
-    // Read distributions
-    vec4 f0123 = texture(distTex0, texCoord);
-    vec4 f4567 = texture(distTex1, texCoord);
-    float f8 = texture(distTex2, texCoord).r;
+    // Read distributions, restoring the rest offset
+    vec4 f0123 = texture(distTex0, texCoord) + restOffset * vec4(w[0], w[1], w[2], w[3]);
+    vec4 f4567 = texture(distTex1, texCoord) + restOffset * vec4(w[4], w[5], w[6], w[7]);
+    float f8 = texture(distTex2, texCoord).r + restOffset * w[8];
+    float f[9] = float[9](f0123.x, f0123.y, f0123.z, f0123.w,
+                          f4567.x, f4567.y, f4567.z, f4567.w, f8);
     
     // Compute density
-    float rho = f0123.x + f0123.y + f0123.z + f0123.w +
-                f4567.x + f4567.y + f4567.z + f4567.w + f8;
+    float rho = 0.0;
+    for (int i = 0; i < 9; i++) {
+        rho += f[i];
+    }
     
     // Compute velocity
     //u = (Σ f_i * e_i) / ρ
     vec2 u = vec2(0.0);
-    u += f0123.x * vec2(e[0]);
-    u += f0123.y * vec2(e[1]);
-    u += f0123.z * vec2(e[2]);
-    u += f0123.w * vec2(e[3]);
-    u += f4567.x * vec2(e[4]);
-    u += f4567.y * vec2(e[5]);
-    u += f4567.z * vec2(e[6]);
-    u += f4567.w * vec2(e[7]);
-    u += f8 * vec2(e[8]);
+    for (int i = 0; i < 9; i++) {
+        u += f[i] * vec2(e[i]);
+    }
     u /= rho;
     
-    // BGK collision
-    //f_i^new = f_i^old + (f_i^eq - f_i^old) / τ
-    distOut0.x = f0123.x + (equilibrium(0, rho, u) - f0123.x) / tau;
-    distOut0.y = f0123.y + (equilibrium(1, rho, u) - f0123.y) / tau;
-    distOut0.z = f0123.z + (equilibrium(2, rho, u) - f0123.z) / tau;
-    distOut0.w = f0123.w + (equilibrium(3, rho, u) - f0123.w) / tau;
-    
-    distOut1.x = f4567.x + (equilibrium(4, rho, u) - f4567.x) / tau;
-    distOut1.y = f4567.y + (equilibrium(5, rho, u) - f4567.y) / tau;
-    distOut1.z = f4567.z + (equilibrium(6, rho, u) - f4567.z) / tau;
-    distOut1.w = f4567.w + (equilibrium(7, rho, u) - f4567.w) / tau;
+    // BGK: f_i^new = f_i^old + (f_i^eq - f_i^old) / τ, or TRT / MRT
+    collide(f, rho, u);
     
-    distOut2 = f8 + (equilibrium(8, rho, u) - f8) / tau;
+    distOut0 = vec4(f[0], f[1], f[2], f[3]) - restOffset * vec4(w[0], w[1], w[2], w[3]);
+    distOut1 = vec4(f[4], f[5], f[6], f[7]) - restOffset * vec4(w[4], w[5], w[6], w[7]);
+    distOut2 = f[8] - restOffset * w[8];
 }
@@ -9,10 +9,22 @@ layout(location = 2) out float distOut2;
 uniform sampler2D distTex0;
 uniform sampler2D distTex1;
 uniform sampler2D distTex2;
-uniform vec2 mousePos;
-uniform vec2 mouseVel;
-uniform float forceRadius;
-uniform float forceStrength;
+// per-frame parameters shared by every pass, one std140 buffer (LBMParams in main.cpp)
+layout(std140) uniform LBMParams {
+    vec2 gridSize;
+    float tau;
+    // rho0 when the textures hold deviations f_i - w_i * rho0, otherwise 0
+    float restOffset;
+    vec2 mousePos;
+    vec2 mouseVel;
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    // 0 = BGK, 1 = TRT, 2 = MRT
+    int collisionModel;
+    // velocity of the inlet cells of cellFlags
+    vec2 inletVelocity;
+};
 
 //lattice weights
 const float w[9] = float[9](
@@ -57,9 +69,9 @@ void main() {
         //force = forceStrength * exp(-dist² / (forceRadius² * 0.1))
         float force = forceStrength * exp(-dist*dist / (forceRadius*forceRadius * 0.1));
         
-        // Compute current density
+        // Compute current density (the weights sum to 1, so deviations add rho0)
         float rho = f0123.x + f0123.y + f0123.z + f0123.w +
-                    f4567.x + f4567.y + f4567.z + f4567.w + f8;
+                    f4567.x + f4567.y + f4567.z + f4567.w + f8 + restOffset;
         
         // SUBTLE density perturbation
         rho += force * 0.1;  // Much less
@@ -79,5 +91,9 @@ void main() {
         distOut1.w = equilibrium(7, rho, u);
         
         distOut2 = equilibrium(8, rho, u);
+        
+        distOut0 -= restOffset * vec4(w[0], w[1], w[2], w[3]);
+        distOut1 -= restOffset * vec4(w[4], w[5], w[6], w[7]);
+        distOut2 -= restOffset * w[8];
     }
 }
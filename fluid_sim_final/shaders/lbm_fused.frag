@@ -0,0 +1,196 @@
+#version 330 core
+in vec2 texCoord;
+
+// Fused pull-scheme step: streaming (with bounce-back), macroscopic output,
+// mouse force and collision in one pass. The distribution textures hold
+// post-collision values between steps.
+layout(location = 0) out vec4 distOut0;
+layout(location = 1) out vec4 distOut1;
+layout(location = 2) out float distOut2;
+layout(location = 3) out float densityOut;
+layout(location = 4) out vec2 velocityOut;
+
+uniform sampler2D distTex0;
+uniform sampler2D distTex1;
+uniform sampler2D distTex2;
+// per-frame parameters shared by every pass, one std140 buffer (LBMParams in main.cpp)
+layout(std140) uniform LBMParams {
+    vec2 gridSize;
+    float tau;
+    // rho0 when the textures hold deviations f_i - w_i * rho0, otherwise 0
+    float restOffset;
+    vec2 mousePos;
+    vec2 mouseVel;
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    // 0 = BGK, 1 = TRT, 2 = MRT
+    int collisionModel;
+    // velocity of the inlet cells of cellFlags
+    vec2 inletVelocity;
+};
+
+// cell types (CellType in cell_flags.h). The texture has a solid ring around
+// the grid, so cell p is texel p + 1 and the box walls need no tests.
+uniform usampler2D cellFlags;
+
+const float w[9] = float[9](
+    1.0/36.0, 1.0/9.0, 1.0/36.0,
+    1.0/9.0, 4.0/9.0, 1.0/9.0,
+    1.0/36.0, 1.0/9.0, 1.0/36.0
+);
+
+const ivec2 e[9] = ivec2[9](
+    ivec2(-1, 1), ivec2(0, 1), ivec2(1, 1),
+    ivec2(-1, 0), ivec2(0, 0), ivec2(1, 0),
+    ivec2(-1,-1), ivec2(0,-1), ivec2(1,-1)
+);
+
+const int opp[9] = int[9](8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+float equilibrium(int i, float rho, vec2 u) {
+    float eu = float(e[i].x) * u.x + float(e[i].y) * u.y;
+    float u2 = u.x * u.x + u.y * u.y;
+    return w[i] * rho * (1.0 + 3.0 * eu + 4.5 * eu * eu - 1.5 * u2);
+}
+
+const uint FLAG_FLUID = 0u;
+const uint FLAG_SOLID = 1u;
+const uint FLAG_INLET = 2u;
+const uint FLAG_OUTLET = 3u;
+
+uint cellType(ivec2 p) {
+    return texelFetch(cellFlags, p + 1, 0).r;
+}
+
+// solid cells at rest, inlets at inletVelocity, outlets at rho = 1 with
+// their own velocity; f holds full populations
+void applyCellType(uint type, inout float f[9]) {
+    if (type == FLAG_FLUID) return;
+    vec2 u = type == FLAG_INLET ? inletVelocity : vec2(0.0);
+    if (type == FLAG_OUTLET) {
+        float rho = 0.0;
+        vec2 j = vec2(0.0);
+        for (int i = 0; i < 9; i++) {
+            rho += f[i];
+            j += f[i] * vec2(e[i]);
+        }
+        u = j / rho;
+    }
+    for (int i = 0; i < 9; i++) {
+        f[i] = equilibrium(i, 1.0, u);
+    }
+}
+
+// TRT: even part of each (i, opp i) pair relaxes with 1/tau, odd part with
+// the rate for Lambda = 1/4. MRT: Lallemand-Luo moments, shear with 1/tau,
+// energy, energy square and heat flux with fixed rates (lbm_collision.h).
+const float TRT_MAGIC = 0.25;
+const float MRT_RATE_ENERGY = 1.64;
+const float MRT_RATE_ENERGY_SQUARE = 1.54;
+const float MRT_RATE_HEAT_FLUX = 1.9;
+
+void collide(inout float f[9], float rho, vec2 u) {
+    if (collisionModel == 1) {
+        float omega = 1.0 / tau;
+        float omegaMinus = 1.0 / (0.5 + TRT_MAGIC / (tau - 0.5));
+        float feq[9];
+        for (int i = 0; i < 9; i++) feq[i] = equilibrium(i, rho, u);
+        float g[9];
+        for (int i = 0; i < 9; i++) {
+            int o = opp[i];
+            float even = 0.5 * ((f[i] + f[o]) - (feq[i] + feq[o]));
+            float odd = 0.5 * ((f[i] - f[o]) - (feq[i] - feq[o]));
+            g[i] = f[i] - omega * even - omegaMinus * odd;
+        }
+        f = g;
+    } else if (collisionModel == 2) {
+        float me = 0.0, meps = 0.0, pxx = 0.0, pxy = 0.0;
+        vec2 q = vec2(0.0);
+        for (int i = 0; i < 9; i++) {
+            vec2 c = vec2(e[i]);
+            float c2 = dot(c, c);
+            me += (-4.0 + 3.0 * c2) * f[i];
+            meps += (4.0 - 10.5 * c2 + 4.5 * c2 * c2) * f[i];
+            q += (-5.0 + 3.0 * c2) * c * f[i];
+            pxx += (c.x * c.x - c.y * c.y) * f[i];
+            pxy += c.x * c.y * f[i];
+        }
+        // deviations from equilibrium, scaled by rate / squared row norm
+        vec2 j = rho * u;
+        float j2 = dot(j, u);
+        float de = MRT_RATE_ENERGY * (me - (-2.0 * rho + 3.0 * j2)) / 36.0;
+        float deps = MRT_RATE_ENERGY_SQUARE * (meps - (rho - 3.0 * j2)) / 36.0;
+        vec2 dq = MRT_RATE_HEAT_FLUX * (q + j) / 12.0;
+        float dxx = (pxx - (j.x * u.x - j.y * u.y)) / (4.0 * tau);
+        float dxy = (pxy - j.x * u.y) / (4.0 * tau);
+        for (int i = 0; i < 9; i++) {
+            vec2 c = vec2(e[i]);
+            float c2 = dot(c, c);
+            f[i] -= (-4.0 + 3.0 * c2) * de + (4.0 - 10.5 * c2 + 4.5 * c2 * c2) * deps +
+                    (-5.0 + 3.0 * c2) * dot(c, dq) + (c.x * c.x - c.y * c.y) * dxx + c.x * c.y * dxy;
+        }
+    } else {
+        for (int i = 0; i < 9; i++) {
+            f[i] += (equilibrium(i, rho, u) - f[i]) / tau;
+        }
+    }
+}
+
+// stored value of slot i at p; opposite slots share a weight, so the offset
+// of the bounce-back read is w[i] as well
+float fetchDist(int i, ivec2 p) {
+    if (i < 4) return texelFetch(distTex0, p, 0)[i];
+    if (i < 8) return texelFetch(distTex1, p, 0)[i - 4];
+    return texelFetch(distTex2, p, 0).r;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+
+    // Pull each population from its upstream neighbour, bounce back from solid cells
+    float f[9];
+    for (int i = 0; i < 9; i++) {
+        ivec2 src = pixel - e[i];
+        if (cellType(src) == FLAG_SOLID) {
+            f[i] = fetchDist(opp[i], pixel);
+        } else {
+            f[i] = fetchDist(i, src);
+        }
+        f[i] += restOffset * w[i];
+    }
+    applyCellType(cellType(pixel), f);
+
+    // Macroscopic quantities of the streamed state (what lbm_macro.frag sees)
+    float rho = 0.0;
+    vec2 u = vec2(0.0);
+    for (int i = 0; i < 9; i++) {
+        rho += f[i];
+        u += f[i] * vec2(e[i]);
+    }
+    u /= rho;
+    densityOut = rho;
+    velocityOut = u;
+
+    // Mouse force, same as lbm_force.frag
+    if (forceActive != 0) {
+        float dist = length(texCoord - mousePos);
+        if (dist < forceRadius) {
+            float force = forceStrength * exp(-dist*dist / (forceRadius*forceRadius * 0.1));
+            rho += force * 0.1;
+            u = mouseVel * force * 0.005;
+            for (int i = 0; i < 9; i++) {
+                f[i] = equilibrium(i, rho, u);
+            }
+        }
+    }
+
+    collide(f, rho, u);
+    for (int i = 0; i < 9; i++) {
+        f[i] -= restOffset * w[i];
+    }
+
+    distOut0 = vec4(f[0], f[1], f[2], f[3]);
+    distOut1 = vec4(f[4], f[5], f[6], f[7]);
+    distOut2 = f[8];
+}
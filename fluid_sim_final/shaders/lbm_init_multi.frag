@@ -5,6 +5,23 @@ layout(location = 0) out vec4 distOut0;
 layout(location = 1) out vec4 distOut1;
 layout(location = 2) out float distOut2;
 
+// per-frame parameters shared by every pass, one std140 buffer (LBMParams in main.cpp)
+layout(std140) uniform LBMParams {
+    vec2 gridSize;
+    float tau;
+    // rho0 when the textures hold deviations f_i - w_i * rho0, otherwise 0
+    float restOffset;
+    vec2 mousePos;
+    vec2 mouseVel;
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    // 0 = BGK, 1 = TRT, 2 = MRT
+    int collisionModel;
+    // velocity of the inlet cells of cellFlags
+    vec2 inletVelocity;
+};
+
 const float w[9] = float[9](
     1.0/36.0, 1.0/9.0, 1.0/36.0,
     1.0/9.0, 4.0/9.0, 1.0/9.0,
@@ -41,4 +58,9 @@ void main() {
     distOut1.w = equilibrium(7, rho, u);
     
     distOut2 = equilibrium(8, rho, u);
+    
+    // deviation storage keeps only the difference from rest
+    distOut0 -= restOffset * vec4(w[0], w[1], w[2], w[3]);
+    distOut1 -= restOffset * vec4(w[4], w[5], w[6], w[7]);
+    distOut2 -= restOffset * w[8];
 }
@@ -7,6 +7,22 @@ layout(location = 1) out vec2 velocityOut;
 uniform sampler2D distTex0;
 uniform sampler2D distTex1;
 uniform sampler2D distTex2;
+// per-frame parameters shared by every pass, one std140 buffer (LBMParams in main.cpp)
+layout(std140) uniform LBMParams {
+    vec2 gridSize;
+    float tau;
+    // rho0 when the textures hold deviations f_i - w_i * rho0, otherwise 0
+    float restOffset;
+    vec2 mousePos;
+    vec2 mouseVel;
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    // 0 = BGK, 1 = TRT, 2 = MRT
+    int collisionModel;
+    // velocity of the inlet cells of cellFlags
+    vec2 inletVelocity;
+};
 
 const ivec2 e[9] = ivec2[9](
     ivec2(-1, 1), ivec2(0, 1), ivec2(1, 1),
@@ -19,12 +35,12 @@ void main() {
     vec4 f4567 = texture(distTex1, texCoord);
     float f8 = texture(distTex2, texCoord).r;
     
-    // Compute density
+    // Compute density (the weights sum to 1, so deviations add rho0)
     float rho = f0123.x + f0123.y + f0123.z + f0123.w +
-                f4567.x + f4567.y + f4567.z + f4567.w + f8;
+                f4567.x + f4567.y + f4567.z + f4567.w + f8 + restOffset;
     
     // Compute velocity
-    //u = (Σ f_i * e_i) / ρ
+    //u = (Σ f_i * e_i) / ρ, the rest offsets cancel since Σ w_i * e_i = 0
     vec2 vel = vec2(0.0);
     vel += f0123.x * vec2(e[0]);
     vel += f0123.y * vec2(e[1]);
@@ -8,7 +8,26 @@ layout(location = 2) out float distOut2;
 uniform sampler2D distTex0;
 uniform sampler2D distTex1;
 uniform sampler2D distTex2;
-uniform vec2 gridSize;
+// per-frame parameters shared by every pass, one std140 buffer (LBMParams in main.cpp)
+layout(std140) uniform LBMParams {
+    vec2 gridSize;
+    float tau;
+    // rho0 when the textures hold deviations f_i - w_i * rho0, otherwise 0
+    float restOffset;
+    vec2 mousePos;
+    vec2 mouseVel;
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    // 0 = BGK, 1 = TRT, 2 = MRT
+    int collisionModel;
+    // velocity of the inlet cells of cellFlags
+    vec2 inletVelocity;
+};
+
+// cell types (CellType in cell_flags.h). The texture has a solid ring around
+// the grid, so cell p is texel p + 1 and the box walls need no tests.
+uniform usampler2D cellFlags;
 
 // D2Q9 lattice velocities
 const ivec2 e[9] = ivec2[9](
@@ -20,6 +39,46 @@ const ivec2 e[9] = ivec2[9](
 // Opposite directions for bounce-back
 const int opp[9] = int[9](8, 7, 6, 5, 4, 3, 2, 1, 0);
 
+const float w[9] = float[9](
+    1.0/36.0, 1.0/9.0, 1.0/36.0,
+    1.0/9.0, 4.0/9.0, 1.0/9.0,
+    1.0/36.0, 1.0/9.0, 1.0/36.0
+);
+
+float equilibrium(int i, float rho, vec2 u) {
+    float eu = float(e[i].x) * u.x + float(e[i].y) * u.y;
+    float u2 = u.x * u.x + u.y * u.y;
+    return w[i] * rho * (1.0 + 3.0 * eu + 4.5 * eu * eu - 1.5 * u2);
+}
+
+const uint FLAG_FLUID = 0u;
+const uint FLAG_SOLID = 1u;
+const uint FLAG_INLET = 2u;
+const uint FLAG_OUTLET = 3u;
+
+uint cellType(ivec2 p) {
+    return texelFetch(cellFlags, p + 1, 0).r;
+}
+
+// solid cells at rest, inlets at inletVelocity, outlets at rho = 1 with
+// their own velocity; f holds full populations
+void applyCellType(uint type, inout float f[9]) {
+    if (type == FLAG_FLUID) return;
+    vec2 u = type == FLAG_INLET ? inletVelocity : vec2(0.0);
+    if (type == FLAG_OUTLET) {
+        float rho = 0.0;
+        vec2 j = vec2(0.0);
+        for (int i = 0; i < 9; i++) {
+            rho += f[i];
+            j += f[i] * vec2(e[i]);
+        }
+        u = j / rho;
+    }
+    for (int i = 0; i < 9; i++) {
+        f[i] = equilibrium(i, 1.0, u);
+    }
+}
+
 //fetch a single distribution from texture.
 float fetchDist(int i, vec2 coord) {
     // Clamp to texture boundaries
@@ -45,34 +104,32 @@ float fetchDist(int i, vec2 coord) {
 
 void main() {
     vec2 texelSize = 1.0 / gridSize;  //size of one grid cell in texture coordinates
-    vec2 pixel = texCoord * gridSize;
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
     
     // Stream each distribution
+    float f[9];
     for (int i = 0; i < 9; i++) {
         vec2 sourceCoord = texCoord - vec2(e[i]) * texelSize;  //src is one to the left, previous time step.
-        vec2 sourcePixel = sourceCoord * gridSize;  //convert to pixel coord for boundary check.
-        
-        float value;
         
-        // Check if source is outside boundaries
-        if (sourcePixel.x < 0.5 || sourcePixel.x > gridSize.x - 0.5 ||
-            sourcePixel.y < 0.5 || sourcePixel.y > gridSize.y - 0.5) {
+        // Check if the source is solid (the ring around the grid is too)
+        if (cellType(pixel - e[i]) == FLAG_SOLID) {
             // Bounce-back: take opposite direction from current cell
-            value = fetchDist(opp[i], texCoord);
+            f[i] = fetchDist(opp[i], texCoord);
         } else {
             // Normal streaming
-            value = fetchDist(i, sourceCoord);
+            f[i] = fetchDist(i, sourceCoord);
         }
-        
-        // Store in appropriate output
-        if (i == 0) distOut0.x = value;
-        else if (i == 1) distOut0.y = value;
-        else if (i == 2) distOut0.z = value;
-        else if (i == 3) distOut0.w = value;
-        else if (i == 4) distOut1.x = value;
-        else if (i == 5) distOut1.y = value;
-        else if (i == 6) distOut1.z = value;
-        else if (i == 7) distOut1.w = value;
-        else distOut2 = value;
     }
+    
+    // solid, inlet and outlet cells are reset on full populations
+    uint type = cellType(pixel);
+    if (type != FLAG_FLUID) {
+        for (int i = 0; i < 9; i++) f[i] += restOffset * w[i];
+        applyCellType(type, f);
+        for (int i = 0; i < 9; i++) f[i] -= restOffset * w[i];
+    }
+    
+    distOut0 = vec4(f[0], f[1], f[2], f[3]);
+    distOut1 = vec4(f[4], f[5], f[6], f[7]);
+    distOut2 = f[8];
 }
@@ -0,0 +1,432 @@
+#include <lbm_cpu.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+// Throughput sweep of the CPU engine over grid sizes, schemes, population
+// storage and thread counts, plus the headless GL pipelines of LBM_Interactive
+// when that binary is available. Every configuration reports MLUPS, the
+// memory bandwidth implied by its minimum traffic per cell, and per-step
+// latency percentiles; the table goes to stdout, the records to --out.
+
+struct BenchmarkOptions {
+    std::vector<int> sizes;      // square grids, edge length
+    std::vector<int> threads;    // empty = 1, 2, 4, ... up to all cores
+    std::vector<LBMScheme> schemes = {LBMScheme::Split, LBMScheme::Fused, LBMScheme::InPlace};
+    std::vector<LBMStorage> storages = {LBMStorage::Float32, LBMStorage::Float16, LBMStorage::Float16Deviation};
+    double seconds = 0.5;        // timed budget per configuration
+    int minSteps = 3;
+    int maxSteps = 2000;
+    int warmup = 2;
+    float tau = 0.52f;
+    const char* isa = nullptr;   // collision kernel ISA, nullptr = auto
+    double memoryLimit = 0.0;    // GiB a configuration may allocate, 0 = half of RAM
+    const char* out = nullptr;   // CSV, or JSON when the name ends in .json
+    const char* gl = nullptr;    // LBM_Interactive built with EGL, nullptr = default or off
+    bool noGl = false;
+    int glSteps = 500;
+};
+
+struct BenchmarkResult {
+    std::string backend;   // "cpu" or "gl"
+    std::string scheme;
+    std::string storage;
+    int nx = 0, ny = 0;
+    int threads = 0;       // 0 for the GL pipelines
+    int steps = 0;
+    double seconds = 0;
+    double mlups = 0;
+    double gbps = 0;       // from the traffic model, not a hardware counter
+    double p50 = 0, p90 = 0, p99 = 0, max = 0;  // milliseconds per step
+};
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [options]\n"
+              << "  --sizes LIST     grid edges, e.g. 64,256,1024 (default 64,128,...,8192)\n"
+              << "  --threads LIST   worker thread counts (default 1,2,4,... up to all cores)\n"
+              << "  --schemes LIST   split, fused, inplace (default all)\n"
+              << "  --storage LIST   fp32, fp16, deviation (default all; split runs fp32 only)\n"
+              << "  --time S         timed seconds per configuration (default 0.5)\n"
+              << "  --min-steps N    timed steps at least, however long they take (default 3)\n"
+              << "  --max-steps N    timed steps at most (default 2000)\n"
+              << "  --warmup N       untimed steps before timing (default 2)\n"
+              << "  --tau T          relaxation time (default 0.52)\n"
+              << "  --isa NAME       scalar, sse2, avx2 or avx512 (default: best available)\n"
+              << "  --memory GIB     skip configurations that need more (default: half of RAM)\n"
+              << "  --out FILE       write the results as CSV, or JSON for *.json\n"
+              << "  --gl PATH        LBM_Interactive with --headless support to benchmark too\n"
+              << "  --no-gl          CPU engine only\n"
+              << "  --gl-steps N     steps per GL pipeline (default 500)\n";
+}
+
+static std::vector<int> parseIntList(const char* text) {
+    std::vector<int> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) values.push_back(std::atoi(item.c_str()));
+    }
+    return values;
+}
+
+static std::vector<std::string> parseNameList(const char* text) {
+    std::vector<std::string> names;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        if (!item.empty()) names.push_back(item);
+    }
+    return names;
+}
+
+static bool parseOptions(int argc, char** argv, BenchmarkOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(arg, "--sizes") && hasValue) opt.sizes = parseIntList(argv[++i]);
+        else if (!std::strcmp(arg, "--threads") && hasValue) opt.threads = parseIntList(argv[++i]);
+        else if (!std::strcmp(arg, "--time") && hasValue) opt.seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(arg, "--min-steps") && hasValue) opt.minSteps = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--max-steps") && hasValue) opt.maxSteps = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--warmup") && hasValue) opt.warmup = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--tau") && hasValue) opt.tau = float(std::atof(argv[++i]));
+        else if (!std::strcmp(arg, "--isa") && hasValue) opt.isa = argv[++i];
+        else if (!std::strcmp(arg, "--memory") && hasValue) opt.memoryLimit = std::atof(argv[++i]);
+        else if (!std::strcmp(arg, "--out") && hasValue) opt.out = argv[++i];
+        else if (!std::strcmp(arg, "--gl") && hasValue) opt.gl = argv[++i];
+        else if (!std::strcmp(arg, "--no-gl")) opt.noGl = true;
+        else if (!std::strcmp(arg, "--gl-steps") && hasValue) opt.glSteps = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--schemes") && hasValue) {
+            opt.schemes.clear();
+            for (const std::string& name : parseNameList(argv[++i])) {
+                if (name == "split") opt.schemes.push_back(LBMScheme::Split);
+                else if (name == "fused") opt.schemes.push_back(LBMScheme::Fused);
+                else if (name == "inplace") opt.schemes.push_back(LBMScheme::InPlace);
+                else {
+                    std::cerr << "ERROR: unknown scheme " << name << std::endl;
+                    return false;
+                }
+            }
+        }
+        else if (!std::strcmp(arg, "--storage") && hasValue) {
+            opt.storages.clear();
+            for (const std::string& name : parseNameList(argv[++i])) {
+                if (name == "fp32") opt.storages.push_back(LBMStorage::Float32);
+                else if (name == "fp16") opt.storages.push_back(LBMStorage::Float16);
+                else if (name == "deviation") opt.storages.push_back(LBMStorage::Float16Deviation);
+                else {
+                    std::cerr << "ERROR: unknown storage " << name << std::endl;
+                    return false;
+                }
+            }
+        }
+        else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+
+    if (opt.sizes.empty()) {
+        for (int n = 64; n <= 8192; n *= 2) opt.sizes.push_back(n);
+    }
+    if (opt.threads.empty()) {
+        int cores = int(std::max(1u, std::thread::hardware_concurrency()));
+        for (int t = 1; t < cores; t *= 2) opt.threads.push_back(t);
+        opt.threads.push_back(cores);
+    }
+    bool valid = opt.seconds >= 0.0 && opt.minSteps >= 1 && opt.maxSteps >= opt.minSteps &&
+                 opt.warmup >= 0 && opt.tau > 0.5f && opt.memoryLimit >= 0.0 && opt.glSteps >= 1 &&
+                 !opt.schemes.empty() && !opt.storages.empty();
+    for (int n : opt.sizes) valid = valid && n >= 2;
+    for (int t : opt.threads) valid = valid && t >= 1;
+    if (!valid) {
+        std::cerr << "ERROR: invalid size, thread count, time, step count, tau or memory limit" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// the names --schemes and --storage take, which the records use too
+static const char* schemeOption(LBMScheme scheme) {
+    switch (scheme) {
+        case LBMScheme::Fused: return "fused";
+        case LBMScheme::InPlace: return "inplace";
+        default: return "split";
+    }
+}
+
+static const char* storageOption(LBMStorage storage) {
+    switch (storage) {
+        case LBMStorage::Float16: return "fp16";
+        case LBMStorage::Float16Deviation: return "deviation";
+        default: return "fp32";
+    }
+}
+
+static double physicalMemory() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    return pages > 0 && pageSize > 0 ? double(pages) * double(pageSize) : 0.0;
+}
+
+// population buffers plus the density and velocity fields
+static double engineBytes(int nx, int ny, LBMScheme scheme, LBMStorage storage) {
+    double population = storage == LBMStorage::Float32 ? sizeof(float) : sizeof(uint16_t);
+    double buffers = scheme == LBMScheme::InPlace ? 1.0 : 2.0;
+    return double(nx) * ny * (buffers * LBMCpuEngine::Q * population + 3.0 * sizeof(float));
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = size_t(p * double(sorted.size() - 1) + 0.5);  // nearest rank
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+static void fillLatency(BenchmarkResult& r, std::vector<double> samples) {
+    if (samples.empty()) return;
+    std::sort(samples.begin(), samples.end());
+    r.p50 = percentile(samples, 0.50);
+    r.p90 = percentile(samples, 0.90);
+    r.p99 = percentile(samples, 0.99);
+    r.max = samples.back();
+}
+
+// Times single steps until the budget is spent, so every sample is one
+// step's latency. Tiling and sparse blocks stay off: the sweep measures the
+// dense per-step kernels.
+static BenchmarkResult runCpu(const BenchmarkOptions& opt, int n, int threads, LBMScheme scheme,
+                              LBMStorage storage) {
+    LBMCpuEngine sim(n, n, opt.tau, threads, parseSimdIsa(opt.isa), scheme, storage);
+    sim.initialize();
+    for (int s = 0; s < opt.warmup; s++) sim.step();
+
+    std::vector<double> samples;
+    double elapsed = 0.0;
+    while (int(samples.size()) < opt.maxSteps &&
+           (int(samples.size()) < opt.minSteps || elapsed < opt.seconds)) {
+        auto start = std::chrono::steady_clock::now();
+        sim.step();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        samples.push_back(seconds * 1e3);
+        elapsed += seconds;
+    }
+
+    BenchmarkResult r;
+    r.backend = "cpu";
+    r.scheme = schemeOption(scheme);
+    r.storage = storageOption(sim.storageFormat());
+    r.nx = r.ny = n;
+    r.threads = sim.threads();
+    r.steps = int(samples.size());
+    r.seconds = elapsed;
+    double updates = double(n) * n * r.steps;
+    r.mlups = elapsed > 0.0 ? updates / elapsed * 1e-6 : 0.0;
+    r.gbps = elapsed > 0.0 ? updates * sim.bytesPerCellStep() / elapsed * 1e-9 : 0.0;
+    fillLatency(r, samples);
+    return r;
+}
+
+// Minimum traffic of a GL step per cell, same model as bytesPerCellStep():
+// split runs collision, streaming and macro passes over Q texels each (the
+// force pass only runs while the mouse is held), the others one pass.
+static double glBytesPerCellStep(const std::string& pipeline, bool half) {
+    double population = half ? 2.0 : 4.0;
+    double planes = pipeline == "split" ? 5.0 * LBMCpuEngine::Q : 2.0 * LBMCpuEngine::Q;
+    return planes * population + 3.0 * sizeof(float);
+}
+
+// Runs `binary --headless N` for one pipeline and reads back its throughput
+// banner, throughput lines and --timings CSV. The GL grid is the binary's
+// compile-time NX x NY, so the size sweep does not apply to it.
+static bool runGl(const BenchmarkOptions& opt, const std::string& binary, const std::string& pipeline,
+                  bool half, BenchmarkResult& r) {
+    std::string timings = "lbm_benchmark_gl_" + std::to_string(getpid()) + ".csv";
+    std::string dir = ".";
+    size_t slash = binary.find_last_of('/');
+    if (slash != std::string::npos) dir = binary.substr(0, slash);
+    std::string timingsPath = dir + "/" + timings;
+
+    // flgl resolves its shader paths against the working directory
+    std::string command = "cd '" + dir + "' && '" + binary + "' --headless " + std::to_string(opt.glSteps) +
+                          " --timings " + timings;
+    if (pipeline != "split") command += " --" + pipeline;
+    if (half) command += " --half";
+    command += " 2>&1";
+
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) return false;
+    char line[512];
+    double mlups = -1.0, seconds = 0.0;
+    int steps = 0;
+    while (std::fgets(line, sizeof(line), pipe)) {
+        if (!std::strncmp(line, "Grid: ", 6)) std::sscanf(line + 6, "%dx%d", &r.nx, &r.ny);
+        if (!std::strncmp(line, "MLUPS: ", 7)) mlups = std::atof(line + 7);
+        if (!std::strncmp(line, "Steps: ", 7)) {
+            steps = std::atoi(line + 7);
+            const char* in = std::strstr(line, " in ");
+            if (in) seconds = std::atof(in + 4);
+        }
+    }
+    int status = pclose(pipe);
+    if (status != 0 || mlups < 0.0) {
+        std::remove(timingsPath.c_str());
+        return false;
+    }
+
+    r.backend = "gl";
+    r.scheme = pipeline;
+    r.storage = half ? "fp16" : "fp32";
+    r.steps = steps;
+    r.seconds = seconds;
+    r.mlups = mlups;
+    r.gbps = mlups * 1e6 * glBytesPerCellStep(pipeline, half) * 1e-9;
+
+    // percentiles of the single lattice pass; the split pipeline has several
+    // passes per step and only gets the wall-clock mean
+    std::ifstream csv(timingsPath);
+    std::string row;
+    while (std::getline(csv, row)) {
+        std::stringstream fields(row);
+        std::string name, count, mean, p50, p90, p99, max;
+        std::getline(fields, name, ',');
+        if (name != "fused" && name != "inplace" && name != "compute") continue;
+        std::getline(fields, count, ',');
+        std::getline(fields, mean, ',');
+        std::getline(fields, p50, ',');
+        std::getline(fields, p90, ',');
+        std::getline(fields, p99, ',');
+        std::getline(fields, max, ',');
+        r.p50 = std::atof(p50.c_str());
+        r.p90 = std::atof(p90.c_str());
+        r.p99 = std::atof(p99.c_str());
+        r.max = std::atof(max.c_str());
+    }
+    std::remove(timingsPath.c_str());
+    return true;
+}
+
+static void printRow(const BenchmarkResult& r) {
+    std::cout << std::left << std::setw(5) << r.backend << std::setw(9) << r.scheme
+              << std::setw(11) << r.storage << std::right << std::setw(6) << r.nx
+              << std::setw(5) << r.threads << std::setw(7) << r.steps << std::fixed
+              << std::setprecision(1) << std::setw(10) << r.mlups
+              << std::setprecision(2) << std::setw(8) << r.gbps
+              << std::setprecision(3) << std::setw(10) << r.p50 << std::setw(10) << r.p90
+              << std::setw(10) << r.p99 << std::setw(10) << r.max << std::endl;
+}
+
+static bool writeResults(const char* path, const std::vector<BenchmarkResult>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "ERROR: cannot write results to " << path << std::endl;
+        return false;
+    }
+    std::string name = path;
+    bool json = name.size() >= 5 && name.compare(name.size() - 5, 5, ".json") == 0;
+    out << std::setprecision(6);
+    if (json) {
+        out << "{\n  \"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchmarkResult& r = results[i];
+            out << "    {\"backend\": \"" << r.backend << "\", \"scheme\": \"" << r.scheme
+                << "\", \"storage\": \"" << r.storage << "\", \"nx\": " << r.nx << ", \"ny\": " << r.ny
+                << ", \"threads\": " << r.threads << ", \"steps\": " << r.steps
+                << ", \"seconds\": " << r.seconds << ", \"mlups\": " << r.mlups << ", \"gbps\": " << r.gbps
+                << ", \"p50_ms\": " << r.p50 << ", \"p90_ms\": " << r.p90 << ", \"p99_ms\": " << r.p99
+                << ", \"max_ms\": " << r.max << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+    } else {
+        out << "backend,scheme,storage,nx,ny,threads,steps,seconds,mlups,gbps,p50_ms,p90_ms,p99_ms,max_ms\n";
+        for (const BenchmarkResult& r : results) {
+            out << r.backend << ',' << r.scheme << ',' << r.storage << ',' << r.nx << ',' << r.ny << ','
+                << r.threads << ',' << r.steps << ',' << r.seconds << ',' << r.mlups << ',' << r.gbps << ','
+                << r.p50 << ',' << r.p90 << ',' << r.p99 << ',' << r.max << '\n';
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchmarkOptions opt;
+    if (!parseOptions(argc, argv, opt)) return 1;
+
+    double limit = opt.memoryLimit > 0.0 ? opt.memoryLimit * 1073741824.0 : 0.5 * physicalMemory();
+    std::string glBinary;
+    if (opt.gl) glBinary = opt.gl;
+#ifdef LBM_GL_BINARY
+    else glBinary = LBM_GL_BINARY;
+#endif
+    if (opt.noGl) glBinary.clear();
+
+    std::cout << "=== LBM Benchmark ===" << std::endl;
+    std::cout << "Sizes:";
+    for (int n : opt.sizes) std::cout << " " << n;
+    std::cout << "\nThreads:";
+    for (int t : opt.threads) std::cout << " " << t;
+    std::cout << "\nTime per Configuration: " << opt.seconds << " s (" << opt.minSteps << " to "
+              << opt.maxSteps << " steps)" << std::endl;
+    std::cout << "Memory Limit: " << std::fixed << std::setprecision(1) << limit / 1073741824.0 << " GiB"
+              << std::endl;
+    std::cout << "GL Pipelines: " << (glBinary.empty() ? "off" : glBinary) << "\n" << std::endl;
+
+    std::cout << std::left << std::setw(5) << "" << std::setw(9) << "scheme" << std::setw(11) << "storage"
+              << std::right << std::setw(6) << "grid" << std::setw(5) << "thr" << std::setw(7) << "steps"
+              << std::setw(10) << "MLUPS" << std::setw(8) << "GB/s" << std::setw(10) << "p50 ms"
+              << std::setw(10) << "p90 ms" << std::setw(10) << "p99 ms" << std::setw(10) << "max ms"
+              << std::endl;
+
+    std::vector<BenchmarkResult> results;
+    int skipped = 0;
+    for (int n : opt.sizes) {
+        for (LBMScheme scheme : opt.schemes) {
+            for (LBMStorage storage : opt.storages) {
+                // the split passes run on float planes only
+                if (scheme == LBMScheme::Split && storage != LBMStorage::Float32) continue;
+                if (limit > 0.0 && engineBytes(n, n, scheme, storage) > limit) {
+                    skipped++;
+                    continue;
+                }
+                for (int threads : opt.threads) {
+                    results.push_back(runCpu(opt, n, threads, scheme, storage));
+                    printRow(results.back());
+                }
+            }
+        }
+    }
+    if (skipped > 0) {
+        std::cout << "(" << skipped << " configurations skipped over the memory limit)" << std::endl;
+    }
+
+    if (!glBinary.empty()) {
+        const char* pipelines[] = {"split", "fused", "inplace", "compute"};
+        bool available = true;
+        for (const char* pipeline : pipelines) {
+            for (bool half : {false, true}) {
+                BenchmarkResult r;
+                if (available && !runGl(opt, glBinary, pipeline, half, r)) {
+                    std::cout << "WARNING: GL " << pipeline << (half ? " fp16" : "")
+                              << " did not run headless, skipping the GL pipelines" << std::endl;
+                    available = false;
+                }
+                if (!available) break;
+                results.push_back(r);
+                printRow(results.back());
+            }
+        }
+    }
+
+    if (opt.out && writeResults(opt.out, results)) {
+        std::cout << "✓ Results written to " << opt.out << std::endl;
+    }
+    return 0;
+}
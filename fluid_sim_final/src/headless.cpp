@@ -0,0 +1,536 @@
+#include <lbm_cpu.h>
+#include <lbm_refined.h>
+#include <lbm_domain.h>
+#include <lbm_lattice.h>
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <algorithm>
+
+// Headless batch runner for the CPU engine. Runs the same physics as
+// LBMInteractive without a window and reports throughput at the end.
+
+struct HeadlessOptions {
+    int nx = 256;
+    int ny = 256;
+    int steps = 1000;
+    int threads = 0;        // 0 = all cores
+    float tau = 0.52f;
+    bool stir = false;      // drag a synthetic "mouse" around a circle
+    const char* isa = nullptr;  // collision kernel ISA, nullptr = auto
+    LBMScheme scheme = LBMScheme::Split;
+    bool half = false;      // fp16 population storage
+    bool deviation = false; // store f - w * rho0; the CPU engine only has it in fp16
+    CollisionModel collision = CollisionModel::BGK;
+    int tile = 0;           // rows per tile for the work-stealing scheduler, 0 = off
+    int tileWidth = 0;      // columns per tile, 0 = whole rows
+    int frame = 1;          // steps between force updates when stirring
+    int depth = 1;          // temporal blocking: fused steps per tile visit
+    int sparse = 0;         // edge of the blocks skipped while at rest, 0 = off
+    float sparseEps = 1e-5f;
+    int refine = 0;         // block size of the two-level refined grid, 0 = off
+    float vorticity = 0.02f;
+    int ranks = 0;          // worker processes for the slab decomposition, 0 = off
+    HaloTransport transport = HaloTransport::SharedMemory;
+    const char* lattice = nullptr;  // d2q9, d2q5 or d3q19 for the templated engine, nullptr = off
+    int nz = 32;            // depth of 3D lattices
+    const char* flags = nullptr;  // PGM/PPM cell flag image, nullptr = open box
+    float inlet = 0.05f;    // x velocity of the inlet cells
+    bool roofline = false;  // time every pass and compare it with the STREAM bandwidth
+    const char* load = nullptr;   // checkpoint to resume from
+    const char* save = nullptr;   // checkpoint written after the last step
+    const char* chain = nullptr;  // prefix of an incremental checkpoint chain
+    int checkpointEvery = 0;      // steps between chain saves, 0 = after the last step only
+    int keyframeEvery = 16;       // chain saves per full keyframe
+    float deltaEps = 0.0f;        // largest population change a delta may leave out
+    int deltaTile = 64;           // edge of the tiles a delta compares and writes
+    const char* compact = nullptr;  // chain manifest to fold into one keyframe
+};
+
+static void printUsage(const char* argv0) {
+    std::cout << "Usage: " << argv0 << " [options]\n"
+              << "  --nx N        grid width (default 256)\n"
+              << "  --ny N        grid height (default 256)\n"
+              << "  --steps N     number of LBM steps (default 1000)\n"
+              << "  --threads N   worker threads, 0 = all cores (default 0)\n"
+              << "  --tau T       relaxation time (default 0.52)\n"
+              << "  --stir        apply a moving force like a mouse drag\n"
+              << "  --isa NAME    scalar, sse2, avx2 or avx512 (default: best available)\n"
+              << "  --fused       single-pass collide-and-stream instead of split passes\n"
+              << "  --inplace     AA-pattern in-place streaming with one population buffer\n"
+              << "  --half        store populations as fp16 (fused/in-place only)\n"
+              << "  --deviation   store populations as fp16 f - w * rho0 (implies --half)\n"
+              << "  --collision M   bgk, trt or mrt (default bgk); mrt stays stable at tau near 0.5\n"
+              << "  --tile N      run fused/in-place steps as N-row tiles without per-step barriers\n"
+              << "  --tile-width N  columns per tile (default: whole rows)\n"
+              << "  --frame N     steps per force update with --stir (default 1)\n"
+              << "  --depth K     with --fused --tile: advance each tile K steps per visit\n"
+              << "  --sparse N    skip N x N blocks at rest (fused/in-place only)\n"
+              << "  --sparse-eps E  largest deviation from rest of a skipped block (default 1e-5)\n"
+              << "  --refine B    add 2x fine patches on B x B blocks near the force and vortices\n"
+              << "  --vorticity V   |curl u| that refines a block with --refine (default 0.02)\n"
+              << "  --ranks R     split the grid into R slabs run by R processes (fused scheme)\n"
+              << "  --transport T   halo exchange between ranks: shm or socket (default shm)\n"
+              << "  --lattice L   templated fused engine on d2q9, d2q5 or d3q19\n"
+              << "  --nz N        grid depth for 3D lattices (default 32)\n"
+              << "  --flags FILE  obstacles, inlets and outlets from a PGM/PPM image (see cell_flags.h)\n"
+              << "  --inlet U     x velocity of the inlet cells (default 0.05)\n"
+              << "  --roofline    per-pass bandwidth against a STREAM probe of host memory\n"
+              << "  --load FILE   resume from a checkpoint, or from a chain's FILE.chain (see checkpoint.h)\n"
+              << "  --save FILE   write a checkpoint after the last step\n"
+              << "  --chain P     append incremental checkpoints to P.chain (see checkpoint_chain.h)\n"
+              << "  --checkpoint-every N  steps between chain saves (default: after the last step)\n"
+              << "  --keyframe-every K    chain saves per full keyframe (default 16)\n"
+              << "  --delta-eps E   largest population change a delta leaves out (default 0, exact)\n"
+              << "  --delta-tile N  tile edge of chain deltas (default 64)\n"
+              << "  --compact FILE  fold the chain FILE.chain into one keyframe and exit\n";
+}
+
+static bool parseOptions(int argc, char** argv, HeadlessOptions& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!std::strcmp(arg, "--nx") && hasValue) opt.nx = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--ny") && hasValue) opt.ny = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--steps") && hasValue) opt.steps = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--threads") && hasValue) opt.threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--tau") && hasValue) opt.tau = float(std::atof(argv[++i]));
+        else if (!std::strcmp(arg, "--stir")) opt.stir = true;
+        else if (!std::strcmp(arg, "--isa") && hasValue) opt.isa = argv[++i];
+        else if (!std::strcmp(arg, "--fused")) opt.scheme = LBMScheme::Fused;
+        else if (!std::strcmp(arg, "--inplace")) opt.scheme = LBMScheme::InPlace;
+        else if (!std::strcmp(arg, "--half")) opt.half = true;
+        else if (!std::strcmp(arg, "--deviation")) opt.deviation = true;
+        else if (!std::strcmp(arg, "--tile") && hasValue) opt.tile = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--tile-width") && hasValue) opt.tileWidth = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--frame") && hasValue) opt.frame = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--depth") && hasValue) opt.depth = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--sparse") && hasValue) opt.sparse = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--sparse-eps") && hasValue) opt.sparseEps = float(std::atof(argv[++i]));
+        else if (!std::strcmp(arg, "--refine") && hasValue) opt.refine = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--vorticity") && hasValue) opt.vorticity = float(std::atof(argv[++i]));
+        else if (!std::strcmp(arg, "--ranks") && hasValue) opt.ranks = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--lattice") && hasValue) opt.lattice = argv[++i];
+        else if (!std::strcmp(arg, "--nz") && hasValue) opt.nz = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--flags") && hasValue) opt.flags = argv[++i];
+        else if (!std::strcmp(arg, "--inlet") && hasValue) opt.inlet = float(std::atof(argv[++i]));
+        else if (!std::strcmp(arg, "--roofline")) opt.roofline = true;
+        else if (!std::strcmp(arg, "--load") && hasValue) opt.load = argv[++i];
+        else if (!std::strcmp(arg, "--save") && hasValue) opt.save = argv[++i];
+        else if (!std::strcmp(arg, "--chain") && hasValue) opt.chain = argv[++i];
+        else if (!std::strcmp(arg, "--checkpoint-every") && hasValue) opt.checkpointEvery = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--keyframe-every") && hasValue) opt.keyframeEvery = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--delta-eps") && hasValue) opt.deltaEps = float(std::atof(argv[++i]));
+        else if (!std::strcmp(arg, "--delta-tile") && hasValue) opt.deltaTile = std::atoi(argv[++i]);
+        else if (!std::strcmp(arg, "--compact") && hasValue) opt.compact = argv[++i];
+        else if (!std::strcmp(arg, "--collision") && hasValue) {
+            const char* name = argv[++i];
+            opt.collision = parseCollisionModel(name);
+            if (opt.collision == CollisionModel::BGK && std::strcmp(name, "bgk")) {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else if (!std::strcmp(arg, "--transport") && hasValue) {
+            const char* name = argv[++i];
+            if (!std::strcmp(name, "socket")) opt.transport = HaloTransport::Socket;
+            else if (!std::strcmp(name, "shm")) opt.transport = HaloTransport::SharedMemory;
+            else {
+                printUsage(argv[0]);
+                return false;
+            }
+        }
+        else {
+            printUsage(argv[0]);
+            return false;
+        }
+    }
+    if (opt.nx < 2 || opt.ny < 2 || opt.steps < 0 || opt.tau <= 0.5f ||
+        opt.tile < 0 || opt.tileWidth < 0 || opt.frame < 1 || opt.depth < 1 ||
+        opt.sparse < 0 || opt.sparseEps < 0.0f || opt.refine < 0 || opt.ranks < 0 || opt.nz < 1 ||
+        opt.checkpointEvery < 0 || opt.keyframeEvery < 1 || opt.deltaEps < 0.0f || opt.deltaTile < 1) {
+        std::cerr << "ERROR: invalid grid size, step count, tau, tile, frame, depth, sparse, refine, ranks, nz"
+                  << " or checkpoint chain setting" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// synthetic mouse drag updated at step s (a multiple of frame): circles the
+// centre, velocity from the position of the update frame steps earlier. Only
+// depends on s, so a run resumed from a checkpoint continues the same drag.
+static LBMForce stirForce(long long s, int frame) {
+    auto position = [](long long t, float& x, float& y) {
+        float angle = float(t) * 0.02f;
+        x = 0.5f + 0.25f * std::cos(angle);
+        y = 0.5f + 0.25f * std::sin(angle);
+    };
+    LBMForce force;
+    position(s, force.mouseX, force.mouseY);
+    float prevX = 0.5f, prevY = 0.5f;
+    if (s > 0) position(s - frame, prevX, prevY);
+    force.velX = (force.mouseX - prevX) * 100.0f;
+    force.velY = (force.mouseY - prevY) * 100.0f;
+    return force;
+}
+
+// --roofline: bytes each pass moved per step against the measured host peak
+static void printRoofline(const LBMCpuEngine& sim, const StreamBandwidth& stream) {
+    std::vector<PassTraffic> traffic = sim.passTraffic();
+    const std::vector<PassTime>& times = sim.passTimings();
+    double cells = double(sim.width()) * sim.height();
+    double peak = stream.peak();
+
+    std::cout << "\n=== Roofline ===" << std::endl;
+    std::cout << "STREAM (GB/s): copy " << std::fixed << std::setprecision(1) << stream.copy
+              << ", scale " << stream.scale << ", add " << stream.add << ", triad " << stream.triad << std::endl;
+    std::cout << std::left << std::setw(12) << "pass" << std::right << std::setw(8) << "read B"
+              << std::setw(9) << "write B" << std::setw(8) << "runs" << std::setw(10) << "ms/run"
+              << std::setw(9) << "GB/s" << std::setw(9) << "% peak" << std::endl;
+    for (size_t p = 0; p < traffic.size() && p < times.size(); p++) {
+        const PassTime& t = times[p];
+        if (t.runs == 0) continue;
+        double seconds = t.seconds / double(t.runs);
+        double gbps = achievedBandwidth(traffic[p].bytes(), cells, seconds);
+        std::cout << std::left << std::setw(12) << t.name << std::right << std::setprecision(0)
+                  << std::setw(8) << traffic[p].readBytes << std::setw(9) << traffic[p].writeBytes
+                  << std::setw(8) << t.runs << std::setprecision(3) << std::setw(10) << seconds * 1e3
+                  << std::setprecision(1) << std::setw(9) << gbps;
+        if (traffic[p].bytes() > 0.0 && peak > 0.0) std::cout << std::setw(9) << gbps / peak * 100.0;
+        else std::cout << std::setw(9) << "-";
+        std::cout << std::endl;
+    }
+}
+
+static bool isChain(const char* path) {
+    size_t n = std::strlen(path);
+    return n > 6 && !std::strcmp(path + n - 6, ".chain");
+}
+
+// what the --chain saves of a run wrote, against full snapshots every time
+struct ChainTotals {
+    int saves = 0;
+    int keyframes = 0;
+    double bytes = 0.0;
+    double fullBytes = 0.0;
+    double seconds = 0.0;
+};
+
+static bool saveToChain(LBMCpuEngine& sim, checkpoint::ChainWriter& chain, ChainTotals& totals) {
+    auto start = std::chrono::steady_clock::now();
+    checkpoint::ChainStats stats;
+    if (!sim.saveCheckpoint(chain, &stats)) return false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    totals.saves++;
+    totals.keyframes += stats.keyframe ? 1 : 0;
+    totals.bytes += double(stats.bytes);
+    totals.fullBytes += double(stats.fullBytes);
+    totals.seconds += seconds;
+    std::cout << "✓ " << (stats.keyframe ? "Keyframe" : "Delta") << " at step " << sim.steps() << ": "
+              << stats.tilesWritten << "/" << stats.tiles << " tiles, " << std::fixed << std::setprecision(2)
+              << double(stats.bytes) / (1024.0 * 1024.0) << " MiB (" << std::setprecision(3) << seconds << " s)"
+              << std::endl;
+    std::cout.unsetf(std::ios::fixed);
+    return true;
+}
+
+static void printChainTotals(const ChainTotals& totals) {
+    std::cout << "Checkpoint Saves: " << totals.saves << " (" << totals.keyframes << " keyframes)" << std::endl;
+    std::cout << "Checkpoint Bytes: " << std::setprecision(2) << totals.bytes / (1024.0 * 1024.0) << " MiB, "
+              << std::setprecision(1) << (totals.fullBytes > 0.0 ? totals.bytes / totals.fullBytes * 100.0 : 0.0)
+              << "% of full snapshots" << std::endl;
+    std::cout << "Checkpoint Time: " << std::setprecision(3) << totals.seconds << " s" << std::endl;
+}
+
+// --compact: fold a chain into one keyframe
+static int compactChain(const char* manifest) {
+    std::vector<checkpoint::ChainEntry> entries;
+    if (!checkpoint::readManifest(manifest, entries)) return 1;
+    std::string keyframe;
+    if (!checkpoint::compactChain(manifest, &keyframe)) return 1;
+    std::cout << "✓ Compacted " << entries.size() << " checkpoints of " << manifest << " into " << keyframe
+              << std::endl;
+    return 0;
+}
+
+// --refine: coarse split-scheme grid with fine patches, see lbm_refined.h
+static int runRefined(const HeadlessOptions& opt) {
+    LBMRefinedEngine sim(opt.nx, opt.ny, opt.tau, opt.refine, opt.threads, parseSimdIsa(opt.isa));
+    sim.setVorticityThreshold(opt.vorticity);
+    sim.setCollisionModel(opt.collision);
+
+    std::cout << "=== LBM Headless CPU Simulation (refined) ===" << std::endl;
+    std::cout << "Coarse Grid: " << opt.nx << "x" << opt.ny << std::endl;
+    std::cout << "Fine Grid: " << opt.nx * 2 << "x" << opt.ny * 2 << " in "
+              << opt.refine << "x" << opt.refine << " blocks" << std::endl;
+    std::cout << "Tau: " << opt.tau << " coarse, " << sim.fineTau() << " fine" << std::endl;
+    std::cout << "Collision: " << collisionModelName(opt.collision) << std::endl;
+    std::cout << "Threads: " << sim.threads() << std::endl;
+    std::cout << "Vorticity Threshold: " << opt.vorticity << std::endl;
+
+    sim.initialize();
+
+    double refined = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < opt.steps; s += opt.frame) {
+        LBMForce force = stirForce(s, opt.frame);
+        int n = std::min(opt.frame, opt.steps - s);
+        sim.advance(n, opt.stir ? &force : nullptr);
+        refined += sim.refinedFraction() * n;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double mlups = seconds > 0.0 ? sim.cellUpdates() / seconds / 1.0e6 : 0.0;
+
+    double mass = 0.0;
+    for (float rho : sim.densityField()) mass += rho;
+
+    std::cout << "\n=== Final Simulation Statistics ===" << std::endl;
+    std::cout << "Steps: " << sim.steps() << std::endl;
+    std::cout << "Wall Time: " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    std::cout << "MLUPS: " << std::setprecision(2) << mlups << std::endl;
+    std::cout << "Refined Blocks: " << std::setprecision(1)
+              << (opt.steps > 0 ? refined / opt.steps * 100.0 : 0.0) << "% on average, "
+              << sim.refinedBlocks() << " at the end" << std::endl;
+    std::cout << "Average Density: " << std::setprecision(6)
+              << mass / (double(opt.nx) * opt.ny) << std::endl;
+    std::cout << "====================================" << std::endl;
+    return 0;
+}
+
+// --ranks: fused steps on horizontal slabs owned by forked processes, see lbm_domain.h
+static int runDecomposed(const HeadlessOptions& opt) {
+    LBMProcessGroup group(opt.nx, opt.ny, opt.tau, opt.ranks, opt.transport, parseSimdIsa(opt.isa));
+    group.setCollisionModel(opt.collision);
+
+    std::cout << "=== LBM Headless CPU Simulation (decomposed) ===" << std::endl;
+    std::cout << "Grid: " << opt.nx << "x" << opt.ny << std::endl;
+    std::cout << "Tau: " << opt.tau << std::endl;
+    std::cout << "Collision: " << collisionModelName(opt.collision) << std::endl;
+    std::cout << "Processes: " << group.processes() << std::endl;
+    std::cout << "Halo Transport: " << haloTransportName(opt.transport) << std::endl;
+
+    // every worker replays the same schedule, so the drag is identical on all slabs
+    LBMForce held;
+    auto schedule = [&](int s, LBMForce& force) {
+        if (!opt.stir) return false;
+        if (s % opt.frame == 0) held = stirForce(s, opt.frame);
+        force = held;
+        return true;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    bool ok = group.run(opt.steps, schedule);
+    auto end = std::chrono::steady_clock::now();
+    if (!ok) return 1;
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double slowest = 0.0;
+    for (double s : group.workerSeconds()) slowest = std::max(slowest, s);
+    double updates = double(opt.nx) * double(opt.ny) * double(opt.steps);
+
+    double mass = 0.0;
+    for (float rho : group.densityField()) mass += rho;
+
+    std::cout << "\n=== Final Simulation Statistics ===" << std::endl;
+    std::cout << "Steps: " << opt.steps << std::endl;
+    std::cout << "Halo Transport: " << haloTransportName(group.haloTransport()) << std::endl;
+    std::cout << "Wall Time: " << std::fixed << std::setprecision(3) << seconds << " s ("
+              << slowest << " s slowest step loop)" << std::endl;
+    std::cout << "MLUPS: " << std::setprecision(2) << (seconds > 0.0 ? updates / seconds / 1.0e6 : 0.0)
+              << std::endl;
+    std::cout << "Average Density: " << std::setprecision(6)
+              << mass / (double(opt.nx) * opt.ny) << std::endl;
+    std::cout << "====================================" << std::endl;
+    return 0;
+}
+
+// --lattice: LBMLatticeEngine instantiated for the chosen descriptor
+template <typename L>
+static int runLattice(const HeadlessOptions& opt) {
+    LBMLatticeEngine<L> sim(opt.nx, opt.ny, opt.nz, opt.tau, opt.threads);
+
+    std::cout << "=== LBM Headless CPU Simulation (" << L::name << ") ===" << std::endl;
+    std::cout << "Grid: " << opt.nx << "x" << opt.ny;
+    if (L::D == 3) std::cout << "x" << sim.depth();
+    std::cout << std::endl;
+    std::cout << "Tau: " << opt.tau << std::endl;
+    std::cout << "Threads: " << sim.threads() << std::endl;
+    if (opt.collision != CollisionModel::BGK) {
+        std::cout << "WARNING: --collision applies to the D2Q9 engines, --lattice runs BGK" << std::endl;
+    }
+
+    sim.initialize();
+    auto start = std::chrono::steady_clock::now();
+    if (!opt.stir) sim.advance(opt.steps);
+    for (int s = 0; opt.stir && s < opt.steps; s += opt.frame) {
+        LBMForce force = stirForce(s, opt.frame);
+        sim.advance(std::min(opt.frame, opt.steps - s), &force);
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double cells = double(opt.nx) * double(opt.ny) * double(sim.depth());
+    double mass = 0.0;
+    for (float rho : sim.densityField()) mass += rho;
+
+    std::cout << "\n=== Final Simulation Statistics ===" << std::endl;
+    std::cout << "Steps: " << sim.steps() << std::endl;
+    std::cout << "Wall Time: " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    std::cout << "MLUPS: " << std::setprecision(2)
+              << (seconds > 0.0 ? cells * opt.steps / seconds / 1.0e6 : 0.0) << std::endl;
+    std::cout << "Average Density: " << std::setprecision(6) << mass / cells << std::endl;
+    std::cout << "====================================" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    HeadlessOptions opt;
+    if (!parseOptions(argc, argv, opt)) return 1;
+    if (opt.compact) return compactChain(opt.compact);
+    if (opt.deviation && !opt.half) {
+        std::cout << "WARNING: --deviation is fp16 storage in the CPU engine, enabling --half" << std::endl;
+    }
+    LBMStorage storage = opt.deviation ? LBMStorage::Float16Deviation
+                       : opt.half      ? LBMStorage::Float16
+                                       : LBMStorage::Float32;
+    if (opt.flags && (opt.refine > 0 || opt.ranks > 0 || opt.lattice)) {
+        std::cout << "WARNING: --flags applies to the dense D2Q9 engine, running an open box" << std::endl;
+    }
+    if ((opt.load || opt.save || opt.chain) && (opt.refine > 0 || opt.ranks > 0 || opt.lattice)) {
+        std::cout << "WARNING: --load, --save and --chain apply to the dense D2Q9 engine, ignoring them"
+                  << std::endl;
+    }
+    if (opt.roofline && (opt.refine > 0 || opt.ranks > 0 || opt.lattice)) {
+        std::cout << "WARNING: --roofline applies to the dense D2Q9 engine, no pass report" << std::endl;
+    }
+    if (opt.refine > 0) return runRefined(opt);
+    if (opt.ranks > 0) return runDecomposed(opt);
+    if (opt.lattice) {
+        if (!std::strcmp(opt.lattice, "d2q9")) return runLattice<lattice::D2Q9>(opt);
+        if (!std::strcmp(opt.lattice, "d2q5")) return runLattice<lattice::D2Q5>(opt);
+        if (!std::strcmp(opt.lattice, "d3q19")) return runLattice<lattice::D3Q19>(opt);
+        std::cerr << "ERROR: unknown lattice " << opt.lattice << std::endl;
+        return 1;
+    }
+
+    LBMCpuEngine sim(opt.nx, opt.ny, opt.tau, opt.threads, parseSimdIsa(opt.isa), opt.scheme,
+                     storage);
+    sim.setCollisionModel(opt.collision);
+    CellFlags flags;
+    if (opt.flags && !flags.load(opt.flags, opt.nx, opt.ny)) return 1;
+    sim.setCellFlags(flags);
+    sim.setInletVelocity(opt.inlet, 0.0f);
+
+    std::cout << "=== LBM Headless CPU Simulation ===" << std::endl;
+    std::cout << "Grid: " << opt.nx << "x" << opt.ny << std::endl;
+    std::cout << "Tau: " << opt.tau << std::endl;
+    std::cout << "Threads: " << sim.threads() << std::endl;
+    std::cout << "Collision ISA: " << simdIsaName(sim.simdIsa()) << std::endl;
+    std::cout << "Pipeline: " << lbmSchemeName(opt.scheme) << std::endl;
+    std::cout << "Collision: " << collisionModelName(sim.collisionModel()) << std::endl;
+    std::cout << "Storage: " << lbmStorageName(sim.storageFormat()) << std::endl;
+    if (opt.flags) std::cout << "Cell Flags: " << opt.flags << " (inlet " << opt.inlet << ")" << std::endl;
+    if (opt.tile > 0) {
+        std::cout << "Tiles: " << (opt.tileWidth > 0 ? std::min(opt.tileWidth, opt.nx) : opt.nx)
+                  << "x" << std::min(opt.tile, opt.ny) << std::endl;
+    }
+    if (opt.depth > 1) std::cout << "Temporal Depth: " << opt.depth << std::endl;
+    if (opt.sparse > 0) {
+        if (opt.scheme == LBMScheme::Split) {
+            std::cout << "WARNING: --sparse needs --fused or --inplace, running dense" << std::endl;
+        } else {
+            std::cout << "Sparse Blocks: " << opt.sparse << "x" << opt.sparse
+                      << " (eps " << opt.sparseEps << ")" << std::endl;
+        }
+    }
+
+    sim.setTileSize(opt.tile, opt.tileWidth);
+    sim.setTemporalDepth(opt.depth);
+    sim.setSparseTiles(opt.sparse, opt.sparseEps);
+    sim.initialize();
+    if (opt.load) {
+        auto loadStart = std::chrono::steady_clock::now();
+        if (!(isChain(opt.load) ? sim.loadCheckpointChain(opt.load) : sim.loadCheckpoint(opt.load))) return 1;
+        double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+        std::cout << "✓ Resumed from " << opt.load << " at step " << sim.steps() << " (" << std::fixed
+                  << std::setprecision(3) << loadSeconds << " s)" << std::endl;
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    // probe on the engine's own workers, before the lattice is warm in cache
+    StreamBandwidth stream;
+    if (opt.roofline) {
+        if (opt.tile > 0 || opt.sparse > 0) {
+            std::cout << "WARNING: --roofline times the dense passes of step(), not tiles or sparse blocks"
+                      << std::endl;
+        }
+        stream = measureStreamBandwidth(sim.threadPool());
+        sim.setPassTiming(true);
+    }
+
+    checkpoint::ChainWriter chain;
+    ChainTotals chainTotals;
+    if (opt.chain) {
+        if (!chain.open(opt.chain, opt.deltaTile, opt.deltaEps, opt.keyframeEvery)) return 1;
+        std::cout << "Checkpoint Chain: " << chain.manifestPath() << " (";
+        if (opt.checkpointEvery > 0) std::cout << "every " << opt.checkpointEvery << " steps, ";
+        std::cout << "keyframe every " << opt.keyframeEvery << ", " << opt.deltaTile << "x" << opt.deltaTile
+                  << " tiles, eps " << opt.deltaEps << ")" << std::endl;
+    }
+    int interval = opt.chain && opt.checkpointEvery > 0 ? opt.checkpointEvery : std::max(opt.steps, 1);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int done = 0; done < opt.steps;) {
+        int n = std::min(interval, opt.steps - done);
+        if (!opt.stir) sim.advance(n);
+
+        // the force is held for `frame` steps, like STEPS_PER_FRAME in the GL app;
+        // frames follow the engine's step count, so they line up after --load
+        for (int left = n; opt.stir && left > 0;) {
+            long long t = sim.steps();
+            int held = std::min(int(opt.frame - t % opt.frame), left);
+            LBMForce force = stirForce(t - t % opt.frame, opt.frame);
+            sim.advance(held, &force);
+            left -= held;
+        }
+        done += n;
+        if (opt.chain && !saveToChain(sim, chain, chainTotals)) return 1;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count() - chainTotals.seconds;
+    double updates = double(opt.nx) * double(opt.ny) * double(opt.steps);
+    double mlups = seconds > 0.0 ? updates / seconds / 1.0e6 : 0.0;
+
+    if (opt.save) {
+        auto saveStart = std::chrono::steady_clock::now();
+        if (!sim.saveCheckpoint(opt.save)) return 1;
+        double saveSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - saveStart).count();
+        std::cout << "✓ Checkpoint written to " << opt.save << " at step " << sim.steps() << " ("
+                  << std::fixed << std::setprecision(3) << saveSeconds << " s)" << std::endl;
+    }
+
+    double mass = 0.0;
+    for (float rho : sim.densityField()) mass += rho;
+
+    std::cout << "\n=== Final Simulation Statistics ===" << std::endl;
+    std::cout << "Steps: " << sim.steps() << std::endl;
+    std::cout << "Wall Time: " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+    std::cout << "MLUPS: " << std::setprecision(2) << mlups << std::endl;
+    if (opt.sparse > 0 && opt.scheme != LBMScheme::Split) {
+        std::cout << "Blocks Computed: " << std::setprecision(1)
+                  << sim.sparseActiveFraction() * 100.0 << "%" << std::endl;
+    }
+    std::cout << "Average Density: " << std::setprecision(6)
+              << mass / (double(opt.nx) * opt.ny) << std::endl;
+    if (opt.chain) printChainTotals(chainTotals);
+    if (opt.roofline) printRoofline(sim, stream);
+    std::cout << "====================================" << std::endl;
+    return 0;
+}
@@ -2,12 +2,57 @@
 #include <flgl/tools.h>
 #include <flgl/geometry.h>
 #include <shader_helper.h>
+#include <pass_graph.h>
+#include <lbm_compute.h>
+#include <cell_flags.h>
+#include <gpu_timer.h>
+#include <async_readback.h>
+#include <checkpoint.h>
+#ifdef LBM_HAS_EGL
+#include <egl_context.h>
+#endif
 #include <iostream>
 #include <cmath>
 #include <vector>
 #include <iomanip>
 #include <chrono>
 #include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+
+// Split: force/collision/streaming/macro passes over ping-pong distribution textures (pass_graph.h).
+// Fused: one pull-scheme pass per step (lbm_fused.frag).
+// InPlace: AA-pattern image load/store on a single population copy (lbm_inplace.frag, GL 4.2).
+// Compute: fused step as a compute dispatch over SoA storage buffers (lbm_compute.comp, GL 4.3).
+enum class Pipeline { Split, Fused, InPlace, Compute };
+
+// lbm_compute.comp is not an flgl shader pair, so it is read from here
+#ifndef LBM_SHADER_DIR
+#define LBM_SHADER_DIR "lib/flgl/res/default_shaders"
+#endif
+
+// collisionModel uniform of the collision, fused and in-place shaders;
+// MRT keeps runs stable at tau close to 0.5 (see lbm_collision.h)
+enum class Collision { BGK = 0, TRT = 1, MRT = 2 };
+
+// std140 mirror of the LBMParams block the simulation shaders declare,
+// written once per frame and read by every pass
+struct LBMParams {
+    float gridSize[2];
+    float tau;
+    float restOffset;
+    float mousePos[2];
+    float mouseVel[2];
+    float forceRadius;
+    float forceStrength;
+    int forceActive;
+    int collisionModel;
+    float inletVelocity[2];
+    float padding[2];  // std140 rounds the block up to 16 bytes
+};
+static_assert(sizeof(LBMParams) == 64, "LBMParams must match the std140 block in the shaders");
 
 class LBMInteractive {
 private:
@@ -20,20 +65,54 @@ private:
     Shader forceShader;
     Shader macroscopicShader;
     Shader displayShader;
+    Shader fusedShader;
+    Shader inplaceShader;
+    
+    // shared parameters and the uniforms that still change per pass
+    UniformBuffer<LBMParams> params;
+    UniformCache inplaceUniforms;
+    UniformCache displayUniforms;
     
-    // LBM textures
-    GLuint distTextures[2][3];
+    // LBM textures, framebuffers and ping-pong state live in the pass graph
+    PassGraph graph;
+    PassGraph::Resource distributions = -1;  // f0-f3, f4-f7 and f8, ping-pong
+    PassGraph::Resource macroscopic = -1;    // density and velocity
+    GLuint distArray = 0;  // InPlace only: one R32F layer per population, used as an image
+    LBMComputeBackend compute;  // Compute only: populations in storage buffers
     
-    // Macroscopic quantities
-    GLuint densityTexture;
-    GLuint velocityTexture;
+    // Cell types with a solid ring around the grid (CellFlags::bordered), on
+    // texture unit 3 for the whole run; passes only bind units 0-2.
+    CellFlags flags;
+    GLuint flagTexture = 0;
+    const char* flagImage = nullptr;
+    float inletSpeed = 0.05f;
     
-    // Framebuffers
-    GLuint distFBO[2];
-    GLuint macroFBO;
+    // GL_TIME_ELAPSED per pass, reported at exit (and written with --timings)
+    GpuTimers timers;
+    const char* timingFile = nullptr;
+    double peakBandwidth = 0.0;  // GB/s, 0 = unknown
+    
+    // Checkpoints (checkpoint.h): population reads go through the PBO ring
+    // and the consumer thread writes the planes, so a save never stalls the
+    // simulation. Saves are keyed by the frame they were requested on.
+    struct PendingSave {
+        checkpoint::Writer file;
+        std::string path;
+        int planes = 0;  // written so far
+    };
+    AsyncReadback checkpointReads;
+    GLuint checkpointFbo = 0;
+    std::mutex saveMutex;
+    std::map<int, PendingSave> pendingSaves;
+    long long stepOffset = 0;  // step of the checkpoint the run resumed from
     
     // State
-    bool pingPong = false;
+    bool headless = false;  // EGL context, no window: no mouse, display or title
+    bool oddStep = false;  // AA pattern phase of the next in-place step
+    Pipeline pipeline = Pipeline::Split;
+    bool halfStorage = false;  // RGBA16F/R16F distributions, the shaders still compute in float
+    float restOffset = 0.0f;   // 1 = distributions hold f_i - w_i (see restOffset in the shaders)
+    Collision collision = Collision::BGK;
     int frameCount = 0;
     double lastTime = 0.0;
     double lastFPSUpdate = 0.0;
@@ -58,6 +137,11 @@ private:
     
     // LBM parameters
     static constexpr float TAU = 0.52f;  // Adjusted for better wave interaction
+    static constexpr float W[9] = {
+        1.0f/36.0f, 1.0f/9.0f, 1.0f/36.0f,
+        1.0f/9.0f,  4.0f/9.0f, 1.0f/9.0f,
+        1.0f/36.0f, 1.0f/9.0f, 1.0f/36.0f
+    };
     
     std::vector<Vt_2Dclassic> quadVertices = {
         {{-1.0f,  1.0f}, {0.0f, 1.0f}},
@@ -69,25 +153,89 @@ private:
     std::vector<uint32_t> quadIndices = {0, 1, 2, 0, 2, 3};
 
 public:
-    void initialize() {
+    explicit LBMInteractive(Pipeline pipeline = Pipeline::Split, bool halfStorage = false,
+                            bool deviationStorage = false, Collision collision = Collision::BGK)
+        : pipeline(pipeline), halfStorage(halfStorage),
+          restOffset(deviationStorage ? 1.0f : 0.0f), collision(collision) {}
+
+    // obstacles, inlets and outlets from a PGM/PPM image; call before initialize()
+    void setCellFlags(const char* image, float inlet) {
+        flagImage = image;
+        inletSpeed = inlet;
+    }
+
+    // call before initialize() when running in an EGLHeadlessContext
+    void setHeadless(bool enabled) { headless = enabled; }
+
+    // glfw's clock needs glfw, which a headless run never initializes
+    double now() const {
+        if (!headless) return glfwGetTime();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // CSV, or JSON if the name ends in .json; written by printFinalStats()
+    void setTimingFile(const char* path) { timingFile = path; }
+
+    // --roofline: pass bandwidths as a share of this many GB/s
+    void setPeakBandwidth(double gbps) { peakBandwidth = gbps; }
+
+    static bool supportsImageLoadStore() {
+#ifdef GL_VERSION_4_2
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        return major > 4 || (major == 4 && minor >= 2);
+#else
+        return false;
+#endif
+    }
+
+    // false when a resource could not be made; the simulation must not run then
+    bool initialize() {
+        if (pipeline == Pipeline::InPlace && !supportsImageLoadStore()) {
+            std::cerr << "In-place pipeline needs GL 4.2 image load/store, using fused instead" << std::endl;
+            pipeline = Pipeline::Fused;
+        }
+        if (pipeline == Pipeline::Compute && !LBMComputeBackend::supported()) {
+            std::cerr << "Compute pipeline needs GL 4.3 compute shaders, using fused instead" << std::endl;
+            pipeline = Pipeline::Fused;
+        }
+        if (pipeline == Pipeline::InPlace && halfStorage) {
+            // the image is declared r32f in lbm_inplace.frag
+            std::cerr << "In-place pipeline keeps R32F distributions, ignoring fp16 storage" << std::endl;
+            halfStorage = false;
+        }
+        if (pipeline == Pipeline::Compute && halfStorage) {
+            // the storage buffers are float[] in lbm_compute.comp
+            std::cerr << "Compute pipeline keeps fp32 distributions, ignoring fp16 storage" << std::endl;
+            halfStorage = false;
+        }
+        
         std::cout << "=== LBM Interactive Fluid Simulation ===" << std::endl;
         std::cout << "Grid: " << NX << "x" << NY << std::endl;
         std::cout << "Tau: " << TAU << std::endl;
+        std::cout << "Pipeline: " << (pipeline == Pipeline::Compute ? "compute" :
+                                      pipeline == Pipeline::InPlace ? "in-place (AA)" :
+                                      pipeline == Pipeline::Fused ? "fused" : "split") << std::endl;
+        std::cout << "Distribution Storage: " << (halfStorage ? "fp16" : "fp32")
+                  << (restOffset != 0.0f ? " deviation" : "") << std::endl;
+        std::cout << "Collision: " << (collision == Collision::MRT ? "MRT" :
+                                       collision == Collision::TRT ? "TRT" : "BGK") << std::endl;
+        if (flagImage) std::cout << "Cell Flags: " << flagImage << " (inlet " << inletSpeed << ")" << std::endl;
 
-        lastTime = glfwGetTime();                   
+        lastTime = now();
         lastFPSUpdate = lastTime;
         
         screenQuad = Mesh<Vt_2Dclassic>::from_vectors(quadVertices, quadIndices); //creating a quad that covers the screen.
         std::cout << "✓ Quad created" << std::endl;
         
-        createDistributionTextures();  //create GPU textures for f0 - f8
-        std::cout << "✓ Distribution textures created" << std::endl;
-        
-        createMacroscopicTextures();  //create textures for density/velocity.
-        std::cout << "✓ Macroscopic textures created" << std::endl;
+        if (pipeline == Pipeline::InPlace) {
+            createDistributionArray();  //one GPU copy of f0 - f8
+            std::cout << "✓ Distribution textures created" << std::endl;
+        }
         
-        createFramebuffers();  //setup render targets.
-        std::cout << "✓ Framebuffers created" << std::endl;
+        if (!createFlagTexture()) return false;
+        std::cout << "✓ Cell flags uploaded" << std::endl;
         
         // load shaders, vertex and frag. the frag files get handled in the CMakelists.txt
         initShader.create("lbm_init_multi", "lbm_init_multi_frag");
@@ -96,127 +244,222 @@ public:
         forceShader.create("lbm_force", "lbm_force_frag");
         macroscopicShader.create("lbm_macro", "lbm_macro_frag");
         displayShader.create("lbm_water", "lbm_water_frag");
+        fusedShader.create("lbm_fused", "lbm_fused_frag");
+        if (pipeline == Pipeline::InPlace) {
+            inplaceShader.create("lbm_inplace", "lbm_inplace_frag");  // needs #version 420
+        }
+        if (pipeline == Pipeline::Compute) {
+            // SoA storage buffers, allocated with the program; needs #version 430
+            if (!compute.create(std::string(LBM_SHADER_DIR) + "/lbm_compute_comp.glsl", NX, NY)) return false;
+        }
         std::cout << "✓ Shaders loaded" << std::endl;
         
+        setupUniforms();
+        std::cout << "✓ Uniforms bound" << std::endl;
+        
+        if (!buildPassGraph()) return false;  //textures and render targets come with the passes.
+        std::cout << "✓ Pass graph built" << std::endl;
+        
         initializeLBM();  //set initial fluid state.
         std::cout << "✓ LBM initialized" << std::endl; 
         
-        computeMacroscopic();  //calculate initial density/veloclity.
+        if (pipeline != Pipeline::InPlace && pipeline != Pipeline::Compute) {
+            graph.run("macro");  //calculate initial density/veloclity.
+        }
         
+        // every pass the graph runs from here on is timed, plus the display
+        timers.addSection("render", false);
+        graph.setPassHooks([this](const std::string& name) { timers.begin(name); }, [this]() { timers.end(); });
+        for (const std::string& name : graph.scheduledPasses()) timers.setTraffic(name, graph.traffic(name).bytes());
+        if (pipeline == Pipeline::Compute) timers.setTraffic("compute", LBMComputeBackend::traffic().bytes());
+        if (peakBandwidth > 0) timers.setPeakBandwidth(peakBandwidth);
+        
+        if (headless) {
+            std::cout << "✓ Ready!\n" << std::endl;
+            return true;
+        }
         std::cout << "\n=== INTERACTIVE FLUID ===" << std::endl;
         std::cout << "CLICK and DRAG to create waves!" << std::endl;
         std::cout << "Create multiple waves to see them interact!" << std::endl;
         std::cout << "Frame counter and FPS display enabled" << std::endl;
         std::cout << "✓ Ready!\n" << std::endl;
+        return true;
     }
     
-    void createDistributionTextures() {
-        for (int p = 0; p < 2; p++) {  // two sets for pingpong.
-            for (int i = 0; i < 3; i++) {  // 4 in 2 textures and 1 in the other texture- for efficiency. total 9 velocity directions. 
-                glGenTextures(1, &distTextures[p][i]);  //creates uniques ID.
-                glBindTexture(GL_TEXTURE_2D, distTextures[p][i]);  // binds texture using ID.
-                
-                if (i < 2) {  //glTexImage2D parameters (target texture, minmap_level, internal format- channels RGBA- 32 bit floating - 128bits/pixel, width, height, border, format of data we are uploading, datatype of each component, pointer to data(set later))
-                    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, NX, NY, 0, 
-                               GL_RGBA, GL_FLOAT, nullptr);  // configures texture as RGBA.
-                } else {
-                    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, NX, NY, 0, 
-                               GL_RED, GL_FLOAT, nullptr);  // configures texture as R-only. this one is single channel only.
-                }
-                
-                //no blending in magnification and minification. and use nearest valid edge and don't wrap around.
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            }
-        }
-    }
-    
-    void createMacroscopicTextures() {
-
-
-        glGenTextures(1, &densityTexture);  //create unique id for density.
-        glBindTexture(GL_TEXTURE_2D, densityTexture); // bind texture for the operations below.
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, NX, NY, 0, GL_RED, GL_FLOAT, nullptr); //allocates gpu memory for textures. R32F, single channel, 32bit floating. one scalar value per cell. 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        
-        //same for velocity.
-        glGenTextures(1, &velocityTexture);
-        glBindTexture(GL_TEXTURE_2D, velocityTexture);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, NX, NY, 0, GL_RG, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    }
-    
-    void createFramebuffers() {  
-/*
-//Essentially, the distTextures are attached to the distFBOs and the density and velocity textues get attached to the macroFBO.
-//### distFBO[0] and distFBO[1]
-distFBO[0] ←──── distTextures[0][0]
-           ←──── distTextures[0][1]
-           ←──── distTextures[0][2]
-
-distFBO[1] ←──── distTextures[1][0]
-           ←──── distTextures[1][1]
-           ←──── distTextures[1][2]
-
-
-### macroFBO
-macroFBO ←──── densityTexture
-         ←──── velocityTexture
-
-*/
-        for (int i = 0; i < 2; i++) {
-            glGenFramebuffers(1, &distFBO[i]);
-            glBindFramebuffer(GL_FRAMEBUFFER, distFBO[i]);
-            
-            GLenum drawBuffers[3] = {
-                GL_COLOR_ATTACHMENT0,
-                GL_COLOR_ATTACHMENT1,
-                GL_COLOR_ATTACHMENT2
-            };
-            
-            for (int j = 0; j < 3; j++) {
-                glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + j,
-                                      GL_TEXTURE_2D, distTextures[i][j], 0);  // the distribution functions are attached through the attachment points to the buffers.
-            }
-            
-            glDrawBuffers(3, drawBuffers);  // then the distribution functions are drawn.
-            
-            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-                std::cerr << "ERROR: Distribution FBO " << i << " incomplete!" << std::endl;
-            }
+    // Sampler units and the LBMParams binding never change, so every program
+    // gets them once here instead of on each pass.
+    void setupUniforms() {
+        params.create(0);
+        
+        Shader* samplerPasses[] = {&collisionShader, &streamingShader, &forceShader,
+                                   &macroscopicShader, &fusedShader};
+        for (Shader* shader : samplerPasses) {
+            shader->bind();
+            ShaderHelper::setUniform1i("distTex0", 0);
+            ShaderHelper::setUniform1i("distTex1", 1);
+            ShaderHelper::setUniform1i("distTex2", 2);
+            ShaderHelper::setUniform1i("cellFlags", 3);
         }
         
-        glGenFramebuffers(1, &macroFBO);
-        glBindFramebuffer(GL_FRAMEBUFFER, macroFBO);
+        Shader* paramPasses[] = {&initShader, &collisionShader, &streamingShader, &forceShader,
+                                 &macroscopicShader, &fusedShader, &inplaceShader};
+        for (Shader* shader : paramPasses) {
+            if (shader == &inplaceShader && pipeline != Pipeline::InPlace) continue;
+            shader->bind();
+            params.attach(ShaderHelper::getCurrentProgram(), "LBMParams");
+        }
+        if (pipeline == Pipeline::Compute) {
+            params.attach(compute.id(), "LBMParams");
+        }
         
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                              GL_TEXTURE_2D, densityTexture, 0);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
-                              GL_TEXTURE_2D, velocityTexture, 0);
+        if (pipeline == Pipeline::InPlace) {
+            inplaceShader.bind();
+            inplaceUniforms.attachCurrent();
+            inplaceUniforms.set1i("cellFlags", 3);
+        }
         
-        GLenum macroBuffers[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
-        glDrawBuffers(2, macroBuffers);
+        displayShader.bind();
+        displayUniforms.attachCurrent();
+        displayUniforms.set1i("densityTex", 0);
+        displayUniforms.set1i("velocityTex", 1);
         
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);  //unbind.
+        updateParams();
+    }
+    
+    // one buffer upload per frame carries everything the passes share
+    void updateParams() {
+        LBMParams p = {};
+        p.gridSize[0] = float(NX);
+        p.gridSize[1] = float(NY);
+        p.tau = TAU;
+        p.restOffset = restOffset;
+        p.mousePos[0] = mouseX;
+        p.mousePos[1] = mouseY;
+        p.mouseVel[0] = (mouseX - prevMouseX) * 100.0f;
+        p.mouseVel[1] = (mouseY - prevMouseY) * 100.0f;
+        p.forceRadius = 0.04f;    // Larger area
+        p.forceStrength = 0.15f;  // Stronger force
+        p.forceActive = mousePressed ? 1 : 0;
+        p.collisionModel = int(collision);
+        p.inletVelocity[0] = inletSpeed;
+        p.inletVelocity[1] = 0.0f;
+        params.update(p);
+    }
+    
+    bool createFlagTexture() {
+        flags = CellFlags(NX, NY);  // open box unless an image is given
+        if (flagImage && !flags.load(flagImage, NX, NY)) return false;
+        std::vector<uint8_t> texels = flags.bordered();
+        
+        glGenTextures(1, &flagTexture);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, flagTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);  // rows of NX + 2 bytes
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8UI, NX + 2, NY + 2, 0, GL_RED_INTEGER, GL_UNSIGNED_BYTE, texels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+        return true;
+    }
+    
+    void createDistributionArray() {
+        // single copy of the lattice: 9 layers of one float each, 36 bytes per cell in total.
+        glGenTextures(1, &distArray);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, distArray);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32F, NX, NY, 9, 0, GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    
+    // Every simulation pass with what it samples and what it renders to; the
+    // schedule picks the pipeline. The graph allocates only what the scheduled
+    // passes touch, so the in-place pipeline gets no distribution textures.
+    // Both resources outlive a step (the state and the displayed fields), so
+    // there is no per-step intermediate whose textures could be shared; the
+    // split passes already ping-pong between the minimum of two distribution sets.
+    bool buildPassGraph() {
+        graph.setSize(NX, NY);
+        graph.setDrawCall([this]() { gl.draw_mesh(screenQuad); });  //execs the bound shader on every pixel.
+        
+        // fp16 halves the bytes per cell (18 instead of 36 per set); sampling and
+        // render target writes convert to and from float in hardware.
+        GLenum rgbaFormat = halfStorage ? GL_RGBA16F : GL_RGBA32F;
+        GLenum redFormat = halfStorage ? GL_R16F : GL_R32F;
+        distributions = graph.addResource("distributions",
+            {{rgbaFormat, GL_RGBA}, {rgbaFormat, GL_RGBA}, {redFormat, GL_RED}}, true);
+        macroscopic = graph.addResource("macroscopic",
+            {{GL_R32F, GL_RED, GL_LINEAR}, {GL_RG32F, GL_RG, GL_LINEAR}}, false);
+        
+        graph.addPass({"init", [this]() { initShader.bind(); }, {}, {distributions}});
+        
+        // split pipeline: force (only while dragging), collision, streaming, macroscopic
+        graph.addPass({"force", [this]() { forceShader.bind(); }, {{distributions, 0}}, {distributions},
+                       [this]() { return mousePressed; }});
+        graph.addPass({"collision", [this]() { collisionShader.bind(); }, {{distributions, 0}}, {distributions}});
+        graph.addPass({"streaming", [this]() { streamingShader.bind(); }, {{distributions, 0}}, {distributions}});
+        graph.addPass({"macro", [this]() { macroscopicShader.bind(); }, {{distributions, 0}}, {macroscopic}});
+        
+        // streaming + macroscopic + force + collision in one pass (lbm_fused.frag).
+        // distributions hold post-collision values, so the displayed fields are the
+        // streamed state the split path would show one step earlier.
+        graph.addPass({"fused", [this]() { fusedShader.bind(); }, {{distributions, 0}},
+                       {distributions, macroscopic}});
+        
+        // AA-pattern step on distArray (lbm_inplace.frag). Populations are updated
+        // through image load/store; the color outputs are the macroscopic fields.
+        PassGraph::Pass inplace = {"inplace", [this]() { inplaceShader.bind(); }, {}, {macroscopic}};
+        inplace.imageBytes = 9.0 * sizeof(float);  // the R32F layers of distArray
+        inplace.before = [this]() {
+#ifdef GL_VERSION_4_2
+            glBindImageTexture(0, distArray, 0, GL_TRUE, 0, GL_READ_WRITE, GL_R32F);
+#endif
+            inplaceUniforms.set1i("oddStep", oddStep ? 1 : 0);
+        };
+        inplace.after = [this]() {
+#ifdef GL_VERSION_4_2
+            // next step reads what this one stored
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+#endif
+            oddStep = !oddStep;
+        };
+        graph.addPass(inplace);
+        
+        if (pipeline == Pipeline::Fused) return graph.setSchedule({"fused"});
+        if (pipeline == Pipeline::InPlace) return graph.setSchedule({"inplace"});
+        if (pipeline == Pipeline::Compute) return graph.setSchedule({});  // dispatched outside the graph
+        return graph.setSchedule({"force", "collision", "streaming", "macro"});
     }
     
     void initializeLBM() {
-        glViewport(0, 0, NX, NY); //setting pixel area. 
-        glBindFramebuffer(GL_FRAMEBUFFER, distFBO[0]); //binding frame buffer. distFBO[0] -> distTextures[0][0], [0][1], [0][2],
-        
-        initShader.bind();  // runs init shader to set starting values.
-        gl.draw_mesh(screenQuad);
-        
-        //copies the distFBO[0] to distFBo[1].
-        glBindFramebuffer(GL_READ_FRAMEBUFFER, distFBO[0]);  
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, distFBO[1]);
-        glBlitFramebuffer(0, 0, NX, NY, 0, 0, NX, NY, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        if (pipeline == Pipeline::InPlace || pipeline == Pipeline::Compute) {
+            // rest state: each population plane holds its weight, density 1 and velocity 0.
+            const float* w = W;
+            size_t cells = size_t(NX) * NY;
+            if (pipeline == Pipeline::InPlace) {
+                std::vector<float> layer(cells);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, distArray);
+                for (int i = 0; i < 9; i++) {
+                    std::fill(layer.begin(), layer.end(), w[i] - restOffset * w[i]);
+                    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, NX, NY, 1, GL_RED, GL_FLOAT, layer.data());
+                }
+            } else {
+                std::vector<float> planes(cells * 9);  // SoA order of the storage buffers
+                for (int i = 0; i < 9; i++) {
+                    std::fill(planes.begin() + i * cells, planes.begin() + (i + 1) * cells, w[i] - restOffset * w[i]);
+                }
+                compute.upload(planes);
+            }
+            
+            const float restDensity[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+            const float restVelocity[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            graph.clear(macroscopic, 0, restDensity);
+            graph.clear(macroscopic, 1, restVelocity);
+            return;
+        }
         
-        glBindFramebuffer(GL_FRAMEBUFFER, 0); //unbind.
+        graph.run("init");  // runs init shader to set starting values.
+        graph.copyToOther(distributions);  // both ping-pong copies start at rest.
     }
     
     void handleMouse() {
@@ -239,154 +482,27 @@ macroFBO ←──── densityTexture
         wasPressed = mousePressed;
     }
     
-    void applyForce() {
-        if (!mousePressed) return;
-        
-        int src = pingPong ? 1 : 0;
-        int dst = pingPong ? 0 : 1;
-        
-        glViewport(0, 0, NX, NY); //match grid size.
-        glBindFramebuffer(GL_FRAMEBUFFER, distFBO[dst]);  // shader writes to distFBO[dst] and other attached textures.
-        
-        forceShader.bind();
-        
-        //distTex0 writes to distTextures[src][0]   
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][0]);
-        ShaderHelper::setUniform1i("distTex0", 0);
-        
-        //distTex1 writes to distTextures[src][1]   
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][1]);
-        ShaderHelper::setUniform1i("distTex1", 1);
-        
-        //distTex2 writes to distTextures[src][2]   
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][2]);
-        ShaderHelper::setUniform1i("distTex2", 2);
-        
-        ShaderHelper::setUniform2f("mousePos", mouseX, mouseY);
-        ShaderHelper::setUniform2f("mouseVel", 
-            (mouseX - prevMouseX) * 100.0f, 
-            (mouseY - prevMouseY) * 100.0f);
-        ShaderHelper::setUniform1f("forceRadius", 0.04f);   // Larger area
-        ShaderHelper::setUniform1f("forceStrength", 0.15f);   // Stronger force
-
-        ShaderHelper::setUniform1i("frameCount", frameCount);
-        
-        gl.draw_mesh(screenQuad);//execs shader on every pixel.
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        pingPong = !pingPong;
-        
-        prevMouseX = mouseX;
-        prevMouseY = mouseY;
-    }
-    
-    void runCollision() {
-        int src = pingPong ? 1 : 0;
-        int dst = pingPong ? 0 : 1;
-        
-        glViewport(0, 0, NX, NY);
-        glBindFramebuffer(GL_FRAMEBUFFER, distFBO[dst]);
-        
-        collisionShader.bind();
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][0]);
-        ShaderHelper::setUniform1i("distTex0", 0);
-        
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][1]);
-        ShaderHelper::setUniform1i("distTex1", 1);
-        
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][2]);
-        ShaderHelper::setUniform1i("distTex2", 2);
-        
-        ShaderHelper::setUniform1f("tau", TAU);
-        
-        gl.draw_mesh(screenQuad);  // applies the shader to all pixels.
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        pingPong = !pingPong;
-    }
-    
-    void runStreamingWithBoundaries() {
-        int src = pingPong ? 1 : 0;
-        int dst = pingPong ? 0 : 1;
-        
-        glViewport(0, 0, NX, NY);
-        glBindFramebuffer(GL_FRAMEBUFFER, distFBO[dst]);
-        
-        streamingShader.bind();
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][0]);
-        ShaderHelper::setUniform1i("distTex0", 0);
-        
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][1]);
-        ShaderHelper::setUniform1i("distTex1", 1);
-        
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, distTextures[src][2]);
-        ShaderHelper::setUniform1i("distTex2", 2);
-        
-        ShaderHelper::setUniform2f("gridSize", float(NX), float(NY));
-        
-        gl.draw_mesh(screenQuad);
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        pingPong = !pingPong;
-    }
-    
-    void computeMacroscopic() {
-        int current = pingPong ? 1 : 0;
-        
-        glViewport(0, 0, NX, NY);
-        glBindFramebuffer(GL_FRAMEBUFFER, macroFBO);
-        
-        macroscopicShader.bind();
-        
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, distTextures[current][0]);
-        ShaderHelper::setUniform1i("distTex0", 0);
-        
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, distTextures[current][1]);
-        ShaderHelper::setUniform1i("distTex1", 1);
-        
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, distTextures[current][2]);
-        ShaderHelper::setUniform1i("distTex2", 2);
-        
-        gl.draw_mesh(screenQuad);
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    }
-    
     void render() {
         glViewport(0, 0, window.width, window.height);
         
         displayShader.bind();
         
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, densityTexture);
-        ShaderHelper::setUniform1i("densityTex", 0);
+        glBindTexture(GL_TEXTURE_2D, graph.texture(macroscopic, 0));
         
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, velocityTexture);
-        ShaderHelper::setUniform1i("velocityTex", 1);
+        glBindTexture(GL_TEXTURE_2D, graph.texture(macroscopic, 1));
 
-        ShaderHelper::setUniform1f("time", float(totalTime));       
-        ShaderHelper::setUniform1i("frameCount", frameCount);       
+        displayUniforms.set1f("time", float(totalTime));       
+        displayUniforms.set1i("frameCount", frameCount);       
         
+        timers.begin("render");
         gl.draw_mesh(screenQuad);
+        timers.end();
     }
 
     void updateFrameCounter() {
-        double currentTime = glfwGetTime();
+        double currentTime = now();
         double deltaTime = currentTime - lastTime;
         lastTime = currentTime;
         
@@ -415,7 +531,7 @@ macroFBO ←──── densityTexture
             std::stringstream titleStream;
             titleStream << "LBM Water Simulation - FPS: " << std::fixed << std::setprecision(1) 
                        << currentFPS << " - Frame: " << frameCount;
-            glfwSetWindowTitle(glfwGetCurrentContext(), titleStream.str().c_str());
+            if (!headless) glfwSetWindowTitle(glfwGetCurrentContext(), titleStream.str().c_str());
             
             //reseting counters
             framesThisSecond = 0;
@@ -428,18 +544,218 @@ macroFBO ←──── densityTexture
     void update() {
 
         updateFrameCounter();
+        timers.collect();  // results of earlier frames, never waits
+        checkpointReads.poll();
+        
+        if (!headless) handleMouse();
+        updateParams();
+        
+        // LBM step: the scheduled passes, the force pass only while dragging
+        if (pipeline == Pipeline::Compute) {
+            timers.begin("compute");
+            compute.step(graph.texture(macroscopic, 0), graph.texture(macroscopic, 1));
+            timers.end();
+        } else {
+            graph.execute();
+        }
         
-        handleMouse();
+        if (mousePressed) {
+            prevMouseX = mouseX;
+            prevMouseY = mouseY;
+        }
+    }
+
+    // what the population storage holds between steps
+    checkpoint::State checkpointState() const {
+        if (pipeline == Pipeline::Fused || pipeline == Pipeline::Compute) return checkpoint::State::PostCollision;
+        if (pipeline == Pipeline::InPlace && oddStep) return checkpoint::State::Swapped;
+        return checkpoint::State::Streamed;
+    }
+    
+    // consumer thread: one read of `components` population planes starting
+    // at r.tag, de-interleaved into fp32 planes with the rest offset undone
+    void writeCheckpointPart(const Readback& r) {
+        std::unique_lock<std::mutex> lock(saveMutex);
+        auto it = pendingSaves.find(r.frame);
+        if (it == pendingSaves.end()) return;
+        PendingSave& save = it->second;
+        lock.unlock();  // map nodes stay put; only this thread erases them
+        
+        size_t cells = size_t(r.width) * r.height;
+        std::vector<float> plane(cells);
+        for (int c = 0; c < r.components; c++) {
+            int i = r.tag + c;
+            for (size_t k = 0; k < cells; k++) plane[k] = r.data[k * r.components + c] + restOffset * W[i];
+            if (!save.file.writePlane(i, plane.data())) break;
+            save.planes++;
+        }
+        if (save.planes == 9) {
+            if (save.file.commit()) std::cout << "✓ Checkpoint written to " << save.path << std::endl;
+        } else if (r.tag + r.components < 9) {
+            return;  // more parts to come
+        }
+        lock.lock();
+        pendingSaves.erase(it);
+    }
+    
+    // Queues reads of the current populations; the file is written (and the
+    // previous checkpoint at path replaced) a few frames later, or at cleanup().
+    bool saveCheckpoint(const std::string& path) {
+        if (!checkpointFbo) {
+            glGenFramebuffers(1, &checkpointFbo);
+            checkpointReads.create(9, [this](const Readback& r) { writeCheckpointPart(r); });
+        }
+        size_t parts = pipeline == Pipeline::Split || pipeline == Pipeline::Fused ? 3 : 9;
+        if (checkpointReads.available() < parts) {
+            std::cerr << "WARNING: previous checkpoint still in flight, skipping " << path << std::endl;
+            return false;
+        }
         
-        // Apply mouse force if dragging
-        applyForce();
+        long long step = stepOffset + frameCount;
+        int id = frameCount;
+        {
+            std::lock_guard<std::mutex> lock(saveMutex);
+            PendingSave& save = pendingSaves[id];
+            save.path = path;
+            if (!save.file.open(path, checkpoint::makeHeader("D2Q9", 9, NX, NY, 1, TAU, step,
+                                                            checkpoint::Precision::Float32, checkpointState()))) {
+                pendingSaves.erase(id);
+                return false;
+            }
+        }
         
-        // LBM steps
-        runCollision();
-        runStreamingWithBoundaries();
-        computeMacroscopic();
+#ifdef GL_VERSION_4_2
+        // the copies below read what the shaders stored
+        if (pipeline == Pipeline::Compute) glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+#endif
+        // every population texture, layer or buffer plane through attachment 0
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, checkpointFbo);
+        for (size_t part = 0; part < parts; part++) {
+            if (pipeline == Pipeline::Compute) {
+                GLintptr offset = GLintptr(sizeof(float)) * NX * NY * part;
+                checkpointReads.requestBuffer(compute.currentBuffer(), offset, NX, NY, int(part), id);
+                continue;
+            }
+            if (pipeline == Pipeline::InPlace) {
+                glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, distArray, 0, GLint(part));
+            } else {
+                glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                       graph.texture(distributions, int(part)), 0);
+            }
+            GLenum format = parts == 3 && part < 2 ? GL_RGBA : GL_RED;  // f0-f3, f4-f7, f8
+            checkpointReads.request(checkpointFbo, GL_COLOR_ATTACHMENT0, 0, 0, NX, NY, format,
+                                    int(parts == 3 ? part * 4 : part), id);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, checkpointFbo);  // request() unbinds it
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        return true;
     }
-
+    
+    // Resumes from an fp32 checkpoint of this grid; call after initialize().
+    // The mapped planes go to the storage buffers and the layers of distArray
+    // as they are. The RGBA textures of split and fused interleave four
+    // planes per texel, so those pipelines (and the deviation offset) go
+    // through one staging copy.
+    bool loadCheckpoint(const std::string& path) {
+        checkpoint::Reader file;
+        if (!file.open(path)) return false;
+        const checkpoint::Header& h = file.header();
+        if (h.q != 9 || h.nx != uint32_t(NX) || h.ny != uint32_t(NY) || h.nz != 1) {
+            std::cerr << "ERROR: checkpoint " << path << " is " << h.lattice << " " << h.nx << "x" << h.ny
+                      << ", expected D2Q9 " << NX << "x" << NY << std::endl;
+            return false;
+        }
+        if (h.precision != uint32_t(checkpoint::Precision::Float32)) {
+            std::cerr << "ERROR: checkpoint " << path << " is fp16, the GL pipelines load fp32 checkpoints" << std::endl;
+            return false;
+        }
+        
+        // same state mapping as LBMCpuEngine::loadCheckpoint()
+        checkpoint::State state = checkpoint::State(h.state);
+        bool swap = false;
+        if (pipeline == Pipeline::InPlace) {
+            oddStep = state != checkpoint::State::Streamed;
+            swap = state == checkpoint::State::PostCollision;
+        } else if (pipeline != Pipeline::Split && state != checkpoint::State::Streamed) {
+            swap = state == checkpoint::State::Swapped;
+        } else if (pipeline != Pipeline::Split || state != checkpoint::State::Streamed) {
+            std::cerr << "ERROR: checkpoint " << path << " holds the " << checkpoint::stateName(state)
+                      << " state, this pipeline resumes from the " << checkpoint::stateName(checkpointState())
+                      << " one" << std::endl;
+            return false;
+        }
+        if (h.tau != TAU) {
+            std::cerr << "WARNING: checkpoint was run at tau " << h.tau << ", continuing at " << TAU << std::endl;
+        }
+        
+        size_t cells = size_t(NX) * NY;
+        auto plane = [&](int i) { return static_cast<const float*>(file.plane(swap ? 8 - i : i)); };
+        std::vector<float> staging;
+        if (pipeline == Pipeline::InPlace || pipeline == Pipeline::Compute) {
+            glBindTexture(GL_TEXTURE_2D_ARRAY, distArray);
+            for (int i = 0; i < 9; i++) {
+                const float* data = plane(i);
+                if (restOffset != 0.0f) {
+                    staging.assign(data, data + cells);
+                    for (float& f : staging) f -= restOffset * W[i];
+                    data = staging.data();
+                }
+                if (pipeline == Pipeline::Compute) compute.uploadPlane(i, data);
+                else glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, i, NX, NY, 1, GL_RED, GL_FLOAT, data);
+            }
+            
+            // the step pass writes the displayed fields and there is no macro pass
+            // over distArray or the SSBOs, so take the moments of the mapped planes
+            // like lbm_macro.frag; a swapped file holds direction opp(j) in plane j
+            std::vector<float> density(cells, 0.0f);
+            std::vector<float> velocity(cells * 2, 0.0f);
+            for (int j = 0; j < 9; j++) {
+                int d = state == checkpoint::State::Swapped ? 8 - j : j;
+                float ex = float(d % 3 - 1), ey = float(1 - d / 3);  // e[] of lbm_macro.frag
+                const float* f = static_cast<const float*>(file.plane(j));
+                for (size_t k = 0; k < cells; k++) {
+                    density[k] += f[k];
+                    velocity[2 * k] += f[k] * ex;
+                    velocity[2 * k + 1] += f[k] * ey;
+                }
+            }
+            for (size_t k = 0; k < cells; k++) {
+                velocity[2 * k] /= density[k];
+                velocity[2 * k + 1] /= density[k];
+            }
+            glBindTexture(GL_TEXTURE_2D, graph.texture(macroscopic, 0));
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX, NY, GL_RED, GL_FLOAT, density.data());
+            glBindTexture(GL_TEXTURE_2D, graph.texture(macroscopic, 1));
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX, NY, GL_RG, GL_FLOAT, velocity.data());
+        } else {
+            staging.resize(cells * 4);
+            for (int t = 0; t < 3; t++) {
+                int components = t < 2 ? 4 : 1;
+                for (int c = 0; c < components; c++) {
+                    int i = t * 4 + c;
+                    const float* data = plane(i);
+                    for (size_t k = 0; k < cells; k++) staging[k * components + c] = data[k] - restOffset * W[i];
+                }
+                glBindTexture(GL_TEXTURE_2D, graph.texture(distributions, t));
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, NX, NY, components == 4 ? GL_RGBA : GL_RED, GL_FLOAT,
+                                staging.data());
+            }
+            graph.copyToOther(distributions);
+            graph.run("macro");
+        }
+        stepOffset = h.step;
+        std::cout << "✓ Resumed from " << path << " at step " << h.step << std::endl;
+        return true;
+    }
+    
+    // wall-clock throughput of a headless run; seconds include a glFinish
+    void printThroughput(int steps, double seconds) {
+        std::cout << "\n\n=== Headless Throughput ===" << std::endl;
+        std::cout << "Steps: " << steps << " in " << std::fixed << std::setprecision(3) << seconds << " s" << std::endl;
+        std::cout << "Steps/s: " << std::setprecision(1) << (steps / seconds) << std::endl;
+        std::cout << "MLUPS: " << std::setprecision(2) << (double(NX) * NY * steps / seconds * 1e-6) << std::endl;
+    }
+    
     void printFinalStats() {
         std::cout << "\n\n=== Final Simulation Statistics ===" << std::endl;
         std::cout << "Total Frames Rendered: " << frameCount << std::endl;
@@ -448,25 +764,116 @@ macroFBO ←──── densityTexture
         std::cout << "Average FPS: " << std::setprecision(1) 
                  << (frameCount / totalTime) << std::endl;
         std::cout << "====================================\n" << std::endl;
+        
+        timers.finish();
+        timers.report(size_t(NX) * NY, size_t(frameCount));
+        if (timingFile && timers.write(timingFile, size_t(NX) * NY, size_t(frameCount))) {
+            std::cout << "✓ Pass timings written to " << timingFile << std::endl;
+        }
     }
     
     void cleanup() {
-        for (int i = 0; i < 2; i++) {
-            glDeleteTextures(3, distTextures[i]);
-        }
-        glDeleteTextures(1, &densityTexture);
-        glDeleteTextures(1, &velocityTexture);
-        glDeleteFramebuffers(2, distFBO);
-        glDeleteFramebuffers(1, &macroFBO);
+        checkpointReads.destroy();  // finishes the saves still in flight
+        if (checkpointFbo) glDeleteFramebuffers(1, &checkpointFbo);
+        glDeleteTextures(1, &distArray);
+        glDeleteTextures(1, &flagTexture);
+        compute.destroy();
+        timers.destroy();
+        graph.release();
+        params.destroy();
     }
 };
 
-int main() {
+// STREAM peak of host memory. It is the ceiling for llvmpipe and for GPUs
+// that share system memory; a discrete GPU's own memory is faster, so its
+// passes show well above 100% against it.
+static double measureHostBandwidth() {
+    ThreadPool pool;
+    StreamBandwidth stream = measureStreamBandwidth(pool);
+    std::cout << "✓ Host memory bandwidth (STREAM): " << std::fixed << std::setprecision(1)
+              << stream.peak() << " GB/s" << std::endl;
+    return stream.peak();
+}
+
+int main(int argc, char** argv) {
+    Pipeline pipeline = Pipeline::Split;
+    bool halfStorage = false;
+    bool deviationStorage = false;
+    Collision collision = Collision::BGK;
+    const char* flagImage = nullptr;
+    float inlet = 0.05f;
+    const char* timingFile = nullptr;
+    int headlessSteps = 0;
+    bool roofline = false;
+    const char* loadFile = nullptr;
+    const char* saveFile = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--fused")) pipeline = Pipeline::Fused;      // single-pass collide-and-stream
+        if (!std::strcmp(argv[i], "--inplace")) pipeline = Pipeline::InPlace;  // AA pattern, one lattice copy
+        if (!std::strcmp(argv[i], "--compute")) pipeline = Pipeline::Compute;  // compute shader, SSBO storage
+        if (!std::strcmp(argv[i], "--half")) halfStorage = true;               // fp16 distribution textures
+        if (!std::strcmp(argv[i], "--deviation")) deviationStorage = true;     // store f_i - w_i
+        if (!std::strcmp(argv[i], "--trt")) collision = Collision::TRT;        // two-relaxation-time
+        if (!std::strcmp(argv[i], "--mrt")) collision = Collision::MRT;        // multiple-relaxation-time
+        if (!std::strcmp(argv[i], "--flags") && i + 1 < argc) flagImage = argv[++i];       // PGM/PPM cell types
+        if (!std::strcmp(argv[i], "--inlet") && i + 1 < argc) inlet = float(std::atof(argv[++i]));  // inlet x velocity
+        if (!std::strcmp(argv[i], "--timings") && i + 1 < argc) timingFile = argv[++i];    // per-pass GPU times, .csv or .json
+        if (!std::strcmp(argv[i], "--headless") && i + 1 < argc) headlessSteps = std::atoi(argv[++i]);  // EGL, no window
+        if (!std::strcmp(argv[i], "--roofline")) roofline = true;  // pass GB/s against a host STREAM probe
+        if (!std::strcmp(argv[i], "--load") && i + 1 < argc) loadFile = argv[++i];  // resume from a checkpoint
+        if (!std::strcmp(argv[i], "--save") && i + 1 < argc) saveFile = argv[++i];  // checkpoint at exit
+    }
+    
+    double peakBandwidth = roofline ? measureHostBandwidth() : 0.0;
+    
+    if (headlessSteps > 0) {
+#ifdef LBM_HAS_EGL
+        // fixed number of steps with no window, no display pass and no swap
+        EGLHeadlessContext context;
+        if (!context.create(4, 3)) return 1;
+        
+        LBMInteractive sim(pipeline, halfStorage, deviationStorage, collision);
+        sim.setCellFlags(flagImage, inlet);
+        sim.setTimingFile(timingFile);
+        sim.setPeakBandwidth(peakBandwidth);
+        sim.setHeadless(true);
+        if (!sim.initialize()) {
+            sim.cleanup();
+            context.destroy();
+            return 1;
+        }
+        if (loadFile && !sim.loadCheckpoint(loadFile)) return 1;
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < headlessSteps; step++) sim.update();
+        glFinish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        sim.printThroughput(headlessSteps, seconds);
+        if (saveFile) sim.saveCheckpoint(saveFile);
+        sim.printFinalStats();
+        sim.cleanup();
+        context.destroy();
+        return 0;
+#else
+        std::cerr << "ERROR: built without EGL, --headless is unavailable" << std::endl;
+        return 1;
+#endif
+    }
+    
     gl.init();  //initialize OpenGL context.    
     window.create("LBM Water Simulation - Click & Drag!", 800, 800);
     
-    LBMInteractive sim;
-    sim.initialize();
+    LBMInteractive sim(pipeline, halfStorage, deviationStorage, collision);
+    sim.setCellFlags(flagImage, inlet);
+    sim.setTimingFile(timingFile);
+    sim.setPeakBandwidth(peakBandwidth);
+    if (!sim.initialize()) {
+        sim.cleanup();
+        gl.destroy();
+        return 1;
+    }
+    if (loadFile && !sim.loadCheckpoint(loadFile)) return 1;
     
     gl.set_clear_color(0.02f, 0.05f, 0.1f, 1.0f);  // Dark blue background
     
@@ -477,6 +884,7 @@ int main() {
         window.update(); //swap buffers and handle events
     }
     
+    if (saveFile) sim.saveCheckpoint(saveFile);
     sim.printFinalStats();
 
     sim.cleanup();
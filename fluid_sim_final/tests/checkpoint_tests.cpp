@@ -0,0 +1,197 @@
+#include <checkpoint.h>
+#include <half_float.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// Format checks for checkpoint.h: a save/load round trip per precision and
+// the rejection of damaged files. Run by ctest with a scratch directory as
+// the only argument.
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) {
+        std::cout << "✓ " << what << std::endl;
+    } else {
+        std::cout << "ERROR: " << what << std::endl;
+        failures++;
+    }
+}
+
+static bool exists(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0;
+}
+
+static std::vector<char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::string& path, const std::vector<char>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+// Q planes of a 64 x 40 grid (10 KiB per fp32 plane, so planes are padded
+// to three pages) filled with values that differ per plane and cell
+struct Lattice {
+    checkpoint::Header header;
+    std::vector<std::vector<char>> planes;
+
+    explicit Lattice(checkpoint::Precision precision, long long step = 1234) {
+        const int nx = 64, ny = 40, q = 9;
+        header = checkpoint::makeHeader("D2Q9", q, nx, ny, 1, 0.6f, step, precision,
+                                        checkpoint::State::PostCollision);
+        size_t cells = size_t(nx) * ny;
+        for (int i = 0; i < q; i++) {
+            header.bias[i] = precision == checkpoint::Precision::Float16Deviation ? 1.0f / (i + 2) : 0.0f;
+            std::vector<char> plane(cells * checkpoint::elementBytes(precision));
+            for (size_t c = 0; c < cells; c++) {
+                float value = 0.1f * float(i) + 1e-4f * float(c % 997) + 1e-3f * float(step % 7);
+                if (precision == checkpoint::Precision::Float32) {
+                    std::memcpy(plane.data() + c * sizeof(float), &value, sizeof(float));
+                } else {
+                    uint16_t h = half_float::fromFloat(value - header.bias[i]);
+                    std::memcpy(plane.data() + c * sizeof(uint16_t), &h, sizeof(uint16_t));
+                }
+            }
+            planes.push_back(std::move(plane));
+        }
+    }
+
+    bool save(const std::string& path) const {
+        checkpoint::Writer file;
+        if (!file.open(path, header)) return false;
+        for (size_t i = 0; i < planes.size(); i++) {
+            if (!file.writePlane(int(i), planes[i].data())) return false;
+        }
+        return file.commit();
+    }
+
+    bool matches(const checkpoint::Reader& file) const {
+        const checkpoint::Header& h = file.header();
+        if (h.q != header.q || h.nx != header.nx || h.ny != header.ny || h.nz != header.nz ||
+            h.precision != header.precision || h.state != header.state || h.step != header.step ||
+            h.tau != header.tau || std::memcmp(h.bias, header.bias, sizeof(h.bias)) != 0 ||
+            std::strcmp(h.lattice, header.lattice) != 0) {
+            return false;
+        }
+        for (size_t i = 0; i < planes.size(); i++) {
+            const void* plane = file.plane(int(i));
+            if (reinterpret_cast<uintptr_t>(plane) % checkpoint::PageBytes != 0) return false;
+            if (std::memcmp(plane, planes[i].data(), planes[i].size()) != 0) return false;
+        }
+        return true;
+    }
+};
+
+static void roundTrips(const std::string& dir) {
+    const checkpoint::Precision precisions[] = {checkpoint::Precision::Float32, checkpoint::Precision::Float16,
+                                                checkpoint::Precision::Float16Deviation};
+    const char* names[] = {"fp32", "fp16", "fp16 deviation"};
+    for (int k = 0; k < 3; k++) {
+        std::string path = dir + "/roundtrip.ckpt";
+        Lattice lattice(precisions[k]);
+        bool saved = lattice.save(path);
+        checkpoint::Reader file;
+        check(saved && file.open(path) && lattice.matches(file),
+              std::string(names[k]) + " round trip keeps header, bias and page-aligned planes");
+        check(!exists(path + ".tmp"), std::string(names[k]) + " save leaves no temporary file");
+    }
+
+    // a second save replaces the first one
+    std::string path = dir + "/replace.ckpt";
+    Lattice first(checkpoint::Precision::Float32, 100);
+    Lattice second(checkpoint::Precision::Float32, 200);
+    checkpoint::Reader file;
+    check(first.save(path) && second.save(path) && file.open(path) && second.matches(file),
+          "a later save replaces the checkpoint");
+
+    // an aborted save leaves the previous checkpoint alone
+    file.close();
+    {
+        checkpoint::Writer writer;
+        Lattice third(checkpoint::Precision::Float32, 300);
+        writer.open(path, third.header);
+        writer.writePlane(0, third.planes[0].data());
+    }  // destroyed without commit()
+    check(file.open(path) && second.matches(file) && !exists(path + ".tmp"),
+          "an unfinished save keeps the previous checkpoint");
+}
+
+// copies a valid checkpoint, lets damage() edit its bytes and expects the
+// reader to refuse the result
+template <typename F>
+static void rejects(const std::string& dir, const std::string& what, F damage) {
+    std::string good = dir + "/good.ckpt";
+    std::string bad = dir + "/bad.ckpt";
+    std::vector<char> bytes = readFile(good);
+    if (bytes.empty()) {
+        check(false, "rejects " + what + " (no reference checkpoint)");
+        return;
+    }
+    damage(bytes);
+    writeFile(bad, bytes);
+    checkpoint::Reader file;
+    check(!file.open(bad), "rejects " + what);
+}
+
+template <typename T>
+static void poke(std::vector<char>& bytes, size_t offset, T value) {
+    std::memcpy(bytes.data() + offset, &value, sizeof(T));
+}
+
+static void rejections(const std::string& dir) {
+    Lattice lattice(checkpoint::Precision::Float32);
+    checkpoint::Reader file;
+    check(lattice.save(dir + "/good.ckpt") && file.open(dir + "/good.ckpt"), "reference checkpoint loads");
+
+    using checkpoint::Header;
+    rejects(dir, "a bad magic", [](std::vector<char>& b) { b[0] = 'X'; });
+    rejects(dir, "another version",
+            [](std::vector<char>& b) { poke(b, offsetof(Header, version), checkpoint::Version + 1); });
+    rejects(dir, "planes smaller than the grid",
+            [](std::vector<char>& b) { poke(b, offsetof(Header, planeBytes), uint64_t(checkpoint::PageBytes)); });
+    rejects(dir, "planes that are not page multiples",
+            [](std::vector<char>& b) { poke(b, offsetof(Header, planeBytes), uint64_t(3 * 4096 + 4)); });
+    rejects(dir, "a plane offset that is not a page multiple",
+            [](std::vector<char>& b) { poke(b, offsetof(Header, headerBytes), uint32_t(100)); });
+    rejects(dir, "a grid larger than the planes",
+            [](std::vector<char>& b) { poke(b, offsetof(Header, ny), uint32_t(4000)); });
+    rejects(dir, "q = 0", [](std::vector<char>& b) { poke(b, offsetof(Header, q), uint32_t(0)); });
+    rejects(dir, "q above MaxQ",
+            [](std::vector<char>& b) { poke(b, offsetof(Header, q), uint32_t(checkpoint::MaxQ + 1)); });
+    rejects(dir, "an unknown precision", [](std::vector<char>& b) { poke(b, offsetof(Header, precision), uint32_t(7)); });
+    rejects(dir, "an unknown state", [](std::vector<char>& b) { poke(b, offsetof(Header, state), uint32_t(9)); });
+    rejects(dir, "a truncated file", [](std::vector<char>& b) { b.resize(b.size() - 1); });
+    rejects(dir, "a file shorter than its header", [](std::vector<char>& b) { b.resize(16); });
+    check(!file.open(dir + "/missing.ckpt"), "rejects a missing file");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " SCRATCH_DIR" << std::endl;
+        return 1;
+    }
+    std::string dir = argv[1];
+    for (size_t slash = dir.find('/', 1); slash != std::string::npos; slash = dir.find('/', slash + 1)) {
+        mkdir(dir.substr(0, slash).c_str(), 0755);
+    }
+    mkdir(dir.c_str(), 0755);
+
+    std::cout << "=== Checkpoint Format ===" << std::endl;
+    roundTrips(dir);
+    rejections(dir);
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+# Checkpoint chain check for checkpoint_chain.h, run by ctest through LBM_Headless:
+#   cmake -DHEADLESS=<binary> -DWORK=<dir> -DARGS="--fused" [-DEVERY=3] -P headless_chain.cmake
+# Saves an eps 0 chain every EVERY (default 4) steps of a 24 step run, then
+# requires that replaying the chain and replaying its compacted form both
+# rebuild the live populations byte for byte, and that compaction deletes the
+# superseded entry files of the chain and nothing else.
+
+if(NOT DEFINED EVERY)
+    set(EVERY 4)
+endif()
+
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+
+# same flow as headless_restart.cmake: inlet, outlet and an obstacle
+set(ppm "P3\n16 16\n255\n")
+foreach(y RANGE 15)
+    foreach(x RANGE 15)
+        if(x EQUAL 0)
+            string(APPEND ppm "255 0 0 ")
+        elseif(x EQUAL 15)
+            string(APPEND ppm "0 0 255 ")
+        elseif(x GREATER 3 AND x LESS 7 AND y GREATER 5 AND y LESS 10)
+            string(APPEND ppm "0 0 0 ")
+        else()
+            string(APPEND ppm "255 255 255 ")
+        endif()
+    endforeach()
+    string(APPEND ppm "\n")
+endforeach()
+file(WRITE ${WORK}/flags.ppm "${ppm}")
+set(COMMON --nx 64 --ny 48 --threads 2 --tau 0.6 --flags flags.ppm --inlet 0.05)
+
+function(run_headless)
+    execute_process(COMMAND ${HEADLESS} ${ARGN}
+                    WORKING_DIRECTORY ${WORK} RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "LBM_Headless ${ARGN} failed:\n${output}")
+    endif()
+endfunction()
+
+function(expect_same a b what)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/${a} ${WORK}/${b} RESULT_VARIABLE different)
+    if(different)
+        message(FATAL_ERROR "${what}: ${b} differs from ${a}")
+    endif()
+endfunction()
+
+# Early saves only touch the tiles the inflow reached, so this writes
+# keyframes at steps 4 and 20 and deltas in between and at step 24. Every 3
+# steps an in-place run alternates AA phases: keyframes at steps 3 and 6,
+# then deltas against the previous save of the same phase.
+run_headless(${COMMON} ${ARGS} --steps 24 --chain run --checkpoint-every ${EVERY} --keyframe-every 4
+             --delta-tile 8 --delta-eps 0 --save live.ckpt)
+file(STRINGS ${WORK}/run.chain manifest)
+list(GET manifest -1 last)
+set(keyframes ${manifest})
+list(FILTER keyframes INCLUDE REGEX "^full ")
+list(LENGTH keyframes keyframeCount)
+string(REPLACE ";" "\n" manifest "${manifest}")
+if(NOT last MATCHES "^delta 24 " OR keyframeCount LESS 2)
+    message(FATAL_ERROR "expected a chain with two keyframes that ends on a delta, got:\n${manifest}")
+endif()
+
+run_headless(${COMMON} ${ARGS} --steps 0 --load run.chain --save replay.ckpt)
+expect_same(live.ckpt replay.ckpt "eps 0 chain replay")
+
+# files next to the chain that compaction must leave alone
+file(WRITE ${WORK}/run.notes "not part of the chain\n")
+file(WRITE ${WORK}/other.000000000004.ckpt "another chain's entry\n")
+file(GLOB before RELATIVE ${WORK} ${WORK}/*)
+
+run_headless(--compact run.chain)
+file(STRINGS ${WORK}/run.chain compacted)
+list(LENGTH compacted lines)
+list(GET compacted -1 entry)
+if(NOT lines EQUAL 2 OR NOT entry MATCHES "^full 24 ([^ ]+)$")
+    string(REPLACE ";" "\n" compacted "${compacted}")
+    message(FATAL_ERROR "compacted manifest should hold one keyframe at step 24, got:\n${compacted}")
+endif()
+set(keyframe ${CMAKE_MATCH_1})
+
+# every entry file of the old chain is gone, everything else is still there
+file(GLOB after RELATIVE ${WORK} ${WORK}/*)
+set(expected ${before})
+list(FILTER expected EXCLUDE REGEX "^run\\.[0-9]+\\.(ckpt|delta)$")
+list(APPEND expected ${keyframe})
+list(REMOVE_DUPLICATES expected)
+list(SORT expected)
+list(SORT after)
+if(NOT after STREQUAL expected)
+    message(FATAL_ERROR "compaction left ${after}, expected ${expected}")
+endif()
+
+run_headless(${COMMON} ${ARGS} --steps 0 --load run.chain --save compacted.ckpt)
+expect_same(live.ckpt compacted.ckpt "compacted chain")
+
+# Resuming at step 8 of a chain that reached step 16 rewinds it: the save at
+# step 12 replaces the entries from step 12 on, and their files are deleted
+run_headless(${COMMON} ${ARGS} --steps 8 --save rewind8.ckpt)
+run_headless(${COMMON} ${ARGS} --steps 16 --chain rw --checkpoint-every 4 --delta-tile 8)
+file(GLOB old RELATIVE ${WORK} ${WORK}/rw.*)
+run_headless(${COMMON} ${ARGS} --load rewind8.ckpt --steps 4 --chain rw --checkpoint-every 4 --delta-tile 8
+             --save rewind12.ckpt)
+file(STRINGS ${WORK}/rw.chain rewound)
+list(GET rewound -1 entry)
+if(NOT entry MATCHES "^full 12 ([^ ]+)$")
+    string(REPLACE ";" "\n" rewound "${rewound}")
+    message(FATAL_ERROR "rewound manifest should end on a keyframe at step 12, got:\n${rewound}")
+endif()
+set(expected ${old})
+list(FILTER expected EXCLUDE REGEX "^rw\\.0*(12|16)\\.(ckpt|delta)$")
+list(APPEND expected ${CMAKE_MATCH_1})
+list(SORT expected)
+file(GLOB after RELATIVE ${WORK} ${WORK}/rw.*)
+list(SORT after)
+if(NOT after STREQUAL expected)
+    message(FATAL_ERROR "rewinding left ${after}, expected ${expected}")
+endif()
+run_headless(${COMMON} ${ARGS} --steps 0 --load rw.chain --save rewound.ckpt)
+expect_same(rewind12.ckpt rewound.ckpt "rewound chain")
+
+message(STATUS "chain replay, compaction and rewinding rebuild their steps exactly (${keyframe})")
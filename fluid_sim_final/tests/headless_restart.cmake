@@ -0,0 +1,64 @@
+# Restart check for checkpoint.h, run by ctest through LBM_Headless:
+#   cmake -DHEADLESS=<binary> -DWORK=<dir> -DARGS="--fused;--half" [-DRESUME_ARGS=...] -P headless_restart.cmake
+# Runs FIRST steps with ARGS, a checkpoint and a resumed run of the rest with
+# RESUME_ARGS (default ARGS), and STEPS steps straight with RESUME_ARGS. Both
+# must end with the same populations, byte for byte, and report the same
+# average density.
+
+if(NOT DEFINED STEPS)
+    set(STEPS 40)
+endif()
+if(NOT DEFINED FIRST)
+    set(FIRST 21)  # odd, so in-place runs resume mid AA pair
+endif()
+if(NOT DEFINED RESUME_ARGS)
+    set(RESUME_ARGS ${ARGS})
+endif()
+math(EXPR REST "${STEPS} - ${FIRST}")
+
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK})
+
+# 16x16 PPM scaled to the grid: red inlet column, blue outlet column and a
+# black obstacle, so the flow is not at rest
+set(ppm "P3\n16 16\n255\n")
+foreach(y RANGE 15)
+    foreach(x RANGE 15)
+        if(x EQUAL 0)
+            string(APPEND ppm "255 0 0 ")
+        elseif(x EQUAL 15)
+            string(APPEND ppm "0 0 255 ")
+        elseif(x GREATER 3 AND x LESS 7 AND y GREATER 5 AND y LESS 10)
+            string(APPEND ppm "0 0 0 ")
+        else()
+            string(APPEND ppm "255 255 255 ")
+        endif()
+    endforeach()
+    string(APPEND ppm "\n")
+endforeach()
+file(WRITE ${WORK}/flags.ppm "${ppm}")
+set(COMMON --nx 64 --ny 48 --threads 2 --tau 0.6 --flags flags.ppm --inlet 0.05)
+
+function(run_headless out)
+    execute_process(COMMAND ${HEADLESS} ${COMMON} ${ARGN}
+                    WORKING_DIRECTORY ${WORK} RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE output)
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "LBM_Headless ${ARGN} failed:\n${output}")
+    endif()
+    string(REGEX MATCH "Average Density: [0-9.]+" density "${output}")
+    set(${out} "${density}" PARENT_SCOPE)
+endfunction()
+
+run_headless(straight ${RESUME_ARGS} --steps ${STEPS} --save straight.ckpt)
+run_headless(first ${ARGS} --steps ${FIRST} --save first.ckpt)
+run_headless(resumed ${RESUME_ARGS} --steps ${REST} --load first.ckpt --save resumed.ckpt)
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK}/straight.ckpt ${WORK}/resumed.ckpt
+                RESULT_VARIABLE different)
+if(different)
+    message(FATAL_ERROR "resumed run differs from the straight run (${straight} vs ${resumed})")
+endif()
+if(NOT straight STREQUAL resumed OR straight STREQUAL "")
+    message(FATAL_ERROR "density mismatch: '${straight}' vs '${resumed}'")
+endif()
+message(STATUS "restart after ${FIRST} of ${STEPS} steps is exact (${straight})")
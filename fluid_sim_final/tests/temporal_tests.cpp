@@ -0,0 +1,78 @@
+#include <lbm_cpu.h>
+#include <half_float.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// Temporal blocking check for LBMCpuEngine::advance(): fused tiles that run
+// several steps per visit must end where the same number of step() calls
+// ends. The scalar tails of the collision kernel at tile and halo edges may
+// round differently, so fp32 gets a few ulps and fp16 less than one
+// half-precision step of the stored values (2.4e-4 near the 4/9 rest
+// population), which is what skipping the rounding of intermediate steps
+// costs.
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (ok) {
+        std::cout << "✓ " << what << std::endl;
+    } else {
+        std::cout << "ERROR: " << what << std::endl;
+        failures++;
+    }
+}
+
+// population i of cell c as the engine would load it
+static float stored(const LBMCpuEngine& sim, int i, size_t c) {
+    if (sim.storageFormat() == LBMStorage::Float32) return sim.population(i)[c];
+    return half_float::toFloat(sim.packedPopulation(i)[c]) + sim.checkpointHeader().bias[i];
+}
+
+static void compare(LBMStorage storage, int depth, float tolerance) {
+    const int nx = 96, ny = 64, steps = 24;
+    LBMForce force;
+    force.mouseX = 0.4f;
+    force.mouseY = 0.5f;
+    force.velX = 1.0f;
+    force.velY = 0.5f;
+
+    LBMCpuEngine stepped(nx, ny, 0.6f, 2, detectSimdIsa(), LBMScheme::Fused, storage);
+    stepped.initialize();
+    for (int s = 0; s < steps; s++) stepped.step(&force);
+
+    LBMCpuEngine blocked(nx, ny, 0.6f, 2, detectSimdIsa(), LBMScheme::Fused, storage);
+    blocked.setTileSize(16, 32);
+    blocked.setTemporalDepth(depth);
+    blocked.initialize();
+    blocked.advance(steps, &force);
+
+    float worst = 0.0f;
+    float moved = 0.0f;  // the flow must have left the rest state
+    for (int i = 0; i < 9; i++) {
+        for (size_t c = 0; c < size_t(nx) * ny; c++) {
+            float a = stored(stepped, i, c);
+            float b = stored(blocked, i, c);
+            worst = std::max(worst, std::fabs(a - b));
+            moved = std::max(moved, std::fabs(a - stored(stepped, i, 0)));
+        }
+    }
+    std::string what = std::string(lbmStorageName(storage)) + " advance(" + std::to_string(steps) +
+                       ") at depth " + std::to_string(depth) + " matches step(), max diff " +
+                       std::to_string(worst);
+    check(moved > 1e-3f && blocked.steps() == stepped.steps() && worst <= tolerance, what);
+}
+
+int main() {
+    std::cout << "=== Temporal Blocking ===" << std::endl;
+    compare(LBMStorage::Float32, 1, 1e-6f);
+    compare(LBMStorage::Float32, 4, 1e-6f);
+    compare(LBMStorage::Float16, 4, 1e-4f);
+    compare(LBMStorage::Float16Deviation, 4, 1e-5f);
+    if (failures > 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
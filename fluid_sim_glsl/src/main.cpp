@@ -4,11 +4,18 @@
 #include <flgl/geometry.h>
 #include <flgl/allocators.h>
 #include <shader_helper.h>
+#ifdef LBM_HAS_EGL
+#include <egl_context.h>
+#endif
 #include <vector>
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <string>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
 
 // Simulation parameters
 constexpr int NX = 380;
@@ -16,13 +23,6 @@ constexpr int NY = 300;
 constexpr float TAU = 1.0f;
 constexpr int STEPS_PER_FRAME = 5;
 
-// D2Q9 lattice constants
-constexpr float WEIGHTS[9] = {
-    1.0f/36.0f, 1.0f/9.0f, 1.0f/36.0f,
-    1.0f/9.0f, 4.0f/9.0f, 1.0f/9.0f,
-    1.0f/36.0f, 1.0f/9.0f, 1.0f/36.0f
-};
-
 class LBMFluidSimulation {
 private:
     // Screen quad for rendering
@@ -54,6 +54,11 @@ private:
     // Simulation state
     bool pingPong = true;
     
+    // Cell types (0 = fluid, 1 = solid) and the solid cells as rectangles
+    // {x, y, width, height}; the boundary pass only shades these
+    std::vector<uint8_t> cellFlags;
+    std::vector<std::array<int, 4>> boundaryRects;
+    
     // Window handle
     GLFWwindow* windowHandle = nullptr;
     
@@ -91,6 +96,9 @@ public:
         // Create textures
         createTextures();
         
+        // The box walls; obstacles are more solid cells
+        createCellFlags();
+        
         // Create framebuffers
         createFramebuffers();
         
@@ -126,6 +134,47 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     }
     
+    void createCellFlags() {
+        cellFlags.assign(size_t(NX) * NY, 0);
+        for (int y = 0; y < NY; y++) {
+            for (int x = 0; x < NX; x++) {
+                if (x == 0 || y == 0 || x == NX - 1 || y == NY - 1) cellFlags[size_t(y) * NX + x] = 1;
+            }
+        }
+        buildBoundaryRects();
+    }
+    
+    // Covers the solid cells with rectangles: runs of solid cells per row,
+    // merged with the run of the row below when it spans the same columns.
+    // The one-cell ring of the box becomes four strips.
+    void buildBoundaryRects() {
+        boundaryRects.clear();
+        std::vector<size_t> open;  // rects that end on the previous row
+        for (int y = 0; y < NY; y++) {
+            std::vector<size_t> next;
+            int x = 0;
+            while (x < NX) {
+                if (!cellFlags[size_t(y) * NX + x]) { x++; continue; }
+                int x0 = x;
+                while (x < NX && cellFlags[size_t(y) * NX + x]) x++;
+                bool merged = false;
+                for (size_t r : open) {
+                    if (boundaryRects[r][0] == x0 && boundaryRects[r][2] == x - x0) {
+                        boundaryRects[r][3]++;
+                        next.push_back(r);
+                        merged = true;
+                        break;
+                    }
+                }
+                if (!merged) {
+                    next.push_back(boundaryRects.size());
+                    boundaryRects.push_back({x0, y, x - x0, 1});
+                }
+            }
+            open = next;
+        }
+    }
+    
     void createFramebuffers() {
         for (int i = 0; i < 2; i++) {
             glGenFramebuffers(1, &fbo[i]);
@@ -155,15 +204,9 @@ public:
         glViewport(0, 0, NX, NY);
         glBindFramebuffer(GL_FRAMEBUFFER, fbo[0]);
         
-        initShader.bind();
+        initShader.bind();  // lbm_init.frag has the weights as constants
         ShaderHelper::setUniform1f("tau", TAU);
         
-        // Set array uniforms individually
-        for (int i = 0; i < 9; i++) {
-            std::string name = "weights[" + std::to_string(i) + "]";
-            ShaderHelper::setUniform1f(name.c_str(), WEIGHTS[i]);
-        }
-        
         gl.draw_mesh(screenQuad);
         
         glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo[0]);
@@ -237,7 +280,14 @@ public:
         ShaderHelper::setUniform2f("gridSize", float(NX), float(NY));
         ShaderHelper::setUniform1f("wallDamping", 0.7f);
         
-        gl.draw_mesh(screenQuad);
+        // Only the solid cells are shaded; the interior keeps what the
+        // streaming pass wrote instead of being copied through
+        glEnable(GL_SCISSOR_TEST);
+        for (const std::array<int, 4>& r : boundaryRects) {
+            glScissor(r[0], r[1], r[2], r[3]);
+            gl.draw_mesh(screenQuad);
+        }
+        glDisable(GL_SCISSOR_TEST);
     }
     
     void applyMouseForce() {
@@ -314,7 +364,8 @@ public:
         gl.draw_mesh(screenQuad);
     }
     
-    void update() {
+    // one frame of simulation, without drawing
+    void simulate() {
         for (int step = 0; step < STEPS_PER_FRAME; step++) {
             runCollisionStep();
             runStreamingStep();
@@ -322,7 +373,10 @@ public:
             applyMouseForce();
             computeMacroscopic();
         }
-        
+    }
+    
+    void update() {
+        simulate();
         visualize();
     }
     
@@ -355,7 +409,40 @@ public:
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
+    int headlessFrames = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--headless") && i + 1 < argc) headlessFrames = std::atoi(argv[++i]);
+    }
+    
+    if (headlessFrames > 0) {
+#ifdef LBM_HAS_EGL
+        // fixed number of frames on an EGL context: no window, no drawing, no swap
+        EGLHeadlessContext context;
+        if (!context.create(3, 3)) return 1;
+        
+        LBMFluidSimulation simulation;
+        simulation.initialize();
+        
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < headlessFrames; frame++) simulation.simulate();
+        glFinish();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        
+        long long steps = (long long)headlessFrames * STEPS_PER_FRAME;
+        std::cout << "Headless: " << steps << " steps in " << seconds << " s, "
+                  << steps / seconds << " steps/s, "
+                  << double(NX) * NY * steps / seconds * 1e-6 << " MLUPS" << std::endl;
+        
+        simulation.cleanup();
+        context.destroy();
+        return 0;
+#else
+        std::cerr << "--headless needs a build with EGL" << std::endl;
+        return 1;
+#endif
+    }
+    
     gl.init();
     window.create("LBM Fluid Simulation", 1280, 720);
     
@@ -0,0 +1,187 @@
+#ifndef ASYNC_READBACK_H
+#define ASYNC_READBACK_H
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One finished read: a rectangle of a color attachment as floats, row by row
+// from the bottom, components interleaved like the pixel format.
+struct Readback {
+    int tag = 0;      // caller's label, e.g. which field was read
+    int frame = 0;    // frame the read was issued on
+    int x = 0, y = 0, width = 0, height = 0;
+    int components = 1;
+    std::vector<float> data;
+};
+
+// Asynchronous readback through a ring of pixel-pack buffers.
+//
+// request() starts glReadPixels into the next free buffer and fences it; the
+// copy runs on the GPU behind the frame instead of draining the pipeline like
+// a plain glReadPixels into client memory. poll() (once per frame) maps the
+// buffers whose fence has signaled, oldest first, and hands the data to a
+// consumer thread, so printing or writing files never blocks rendering.
+// Results arrive a few frames late. When every buffer is still in flight the
+// request is dropped and counted rather than waited for.
+class AsyncReadback {
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsizeiptr capacity = 0;
+        GLsync fence = nullptr;
+        Readback info;
+    };
+
+    std::vector<Slot> ring;
+    size_t next = 0;     // slot the next request uses
+    size_t oldest = 0;   // oldest slot in flight
+    size_t inFlight = 0;
+    size_t dropped = 0;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Readback> queue;
+    bool stopping = false;
+    std::function<void(const Readback&)> consumer;
+
+    static int componentsOf(GLenum format) {
+        switch (format) {
+            case GL_RG: return 2;
+            case GL_RGB: return 3;
+            case GL_RGBA: return 4;
+            default: return 1;
+        }
+    }
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;  // stopping and drained
+            Readback r = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            consumer(r);
+            lock.lock();
+        }
+    }
+
+    // maps the oldest slot and queues its data for the consumer
+    void retire() {
+        Slot& s = ring[oldest];
+        glDeleteSync(s.fence);
+        s.fence = nullptr;
+
+        size_t count = size_t(s.info.width) * s.info.height * s.info.components;
+        s.info.data.resize(count);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+        void* mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(count * sizeof(float)), GL_MAP_READ_BIT);
+        if (mapped) {
+            std::memcpy(s.info.data.data(), mapped, count * sizeof(float));
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        if (mapped) {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(s.info));
+        }
+        ready.notify_one();
+        s.info = Readback();
+        oldest = (oldest + 1) % ring.size();
+        inFlight--;
+    }
+
+public:
+    // slots = reads that may be in flight at once; onData runs on the
+    // consumer thread, one result at a time in request order
+    void create(int slots, std::function<void(const Readback&)> onData) {
+        ring.assign(size_t(slots > 0 ? slots : 1), Slot());
+        for (Slot& s : ring) glGenBuffers(1, &s.buffer);
+        consumer = std::move(onData);
+        stopping = false;
+        worker = std::thread(&AsyncReadback::run, this);
+    }
+
+    // Starts reading a rectangle of a color attachment of fbo. format is
+    // GL_RED, GL_RG or GL_RGBA; the data is always GL_FLOAT. Returns false
+    // (and counts a drop) when all buffers are still in flight.
+    bool request(GLuint fbo, GLenum attachment, int x, int y, int width, int height,
+                 GLenum format, int tag, int frame) {
+        if (inFlight == ring.size()) {
+            dropped++;
+            return false;
+        }
+        Slot& s = ring[next];
+        s.info.tag = tag;
+        s.info.frame = frame;
+        s.info.x = x;
+        s.info.y = y;
+        s.info.width = width;
+        s.info.height = height;
+        s.info.components = componentsOf(format);
+
+        GLsizeiptr bytes = GLsizeiptr(sizeof(float)) * width * height * s.info.components;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, s.buffer);
+        if (s.capacity < bytes) {
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+            s.capacity = bytes;
+        }
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+        glReadBuffer(attachment);
+        glReadPixels(x, y, width, height, format, GL_FLOAT, nullptr);  // into the bound buffer
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        next = (next + 1) % ring.size();
+        inFlight++;
+        return true;
+    }
+
+    // hands over every read the GPU has finished; never waits
+    void poll() {
+        while (inFlight > 0) {
+            GLenum status = glClientWaitSync(ring[oldest].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) break;
+            retire();
+        }
+    }
+
+    // waits for every read in flight (shutdown, or before a final export)
+    void flush() {
+        while (inFlight > 0) {
+            GLenum status = GL_TIMEOUT_EXPIRED;
+            while (status == GL_TIMEOUT_EXPIRED) {
+                status = glClientWaitSync(ring[oldest].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            }
+            retire();
+        }
+    }
+
+    size_t droppedCount() const { return dropped; }
+
+    // finishes outstanding reads, lets the consumer drain and stops it
+    void destroy() {
+        if (ring.empty()) return;
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        if (worker.joinable()) worker.join();
+        for (Slot& s : ring) glDeleteBuffers(1, &s.buffer);
+        ring.clear();
+        next = oldest = inFlight = 0;
+    }
+};
+
+#endif
@@ -2,10 +2,13 @@
 #include <flgl/tools.h>
 #include <flgl/geometry.h>
 #include <shader_helper.h>
+#include <async_readback.h>
 #include <iostream>
+#include <fstream>
 #include <cmath>
 #include <vector>
 #include <iomanip>
+#include <string>
 
 class SimpleLBM {
 private:
@@ -37,6 +40,12 @@ private:
     
     int frameCount = 0;
     
+    // Readbacks: the density probe and, with --export, the full density
+    // field every frame; written by the readback consumer thread
+    enum ReadbackTag { DensityProbe, DensityField };
+    AsyncReadback readback;
+    std::ofstream exportFile;
+    
     // Quad
     std::vector<Vt_2Dclassic> quadVertices = {
         {{-1.0f,  1.0f}, {0.0f, 1.0f}},
@@ -48,6 +57,17 @@ private:
     std::vector<uint32_t> quadIndices = {0, 1, 2, 0, 2, 3};
 
 public:
+    // appends every frame's density (NX*NY floats, raw) to path
+    bool exportTo(const std::string& path) {
+        exportFile.open(path, std::ios::binary);
+        if (!exportFile) {
+            std::cerr << "ERROR: cannot open export file " << path << std::endl;
+            return false;
+        }
+        std::cout << "✓ Exporting density to " << path << std::endl;
+        return true;
+    }
+    
     void initialize() {
         std::cout << "\n=== MINIMAL LBM WITH COLLISION TEST ===" << std::endl;
         
@@ -81,6 +101,10 @@ public:
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
         std::cout << "✓ Second buffer initialized" << std::endl;
         
+        // Pixel-pack ring; a few frames of reads may be in flight
+        readback.create(4, [this](const Readback& r) { consume(r); });
+        std::cout << "✓ Async readback ready" << std::endl;
+        
         // Compute initial macroscopic
         computeMacroscopic();
         checkDensity();
@@ -257,13 +281,19 @@ public:
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
+    // Queues a read of the 3x3 density around the center; it is reported
+    // by the consumer thread a few frames later
     void checkDensity() {
-        glBindFramebuffer(GL_FRAMEBUFFER, macroFBO);
-        glReadBuffer(GL_COLOR_ATTACHMENT0);
-        
-        float density[9];
-        glReadPixels(NX/2-1, NY/2-1, 3, 3, GL_RED, GL_FLOAT, density);
+        readback.request(macroFBO, GL_COLOR_ATTACHMENT0, NX/2-1, NY/2-1, 3, 3, GL_RED, DensityProbe, frameCount);
+    }
+    
+    void consume(const Readback& r) {
+        if (r.tag == DensityField) {
+            exportFile.write(reinterpret_cast<const char*>(r.data.data()), std::streamsize(r.data.size() * sizeof(float)));
+            return;
+        }
         
+        const float* density = r.data.data();
         float min = density[0], max = density[0], avg = 0;
         for (int i = 0; i < 9; i++) {
             avg += density[i];
@@ -272,7 +302,7 @@ public:
         }
         avg /= 9.0f;
         
-        std::cout << "Frame " << frameCount << " - Density: ["
+        std::cout << "Frame " << r.frame << " - Density: ["
                   << std::fixed << std::setprecision(4) 
                   << min << ", " << max << "], avg=" << avg;
         
@@ -280,8 +310,6 @@ public:
             std::cout << " ⚠️ WARNING!";
         }
         std::cout << std::endl;
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
     void render() {
@@ -309,9 +337,19 @@ public:
         if (frameCount % 100 == 0) {
             checkDensity();
         }
+        if (exportFile.is_open()) {
+            readback.request(macroFBO, GL_COLOR_ATTACHMENT0, 0, 0, NX, NY, GL_RED, DensityField, frameCount);
+        }
+        
+        // Hand finished reads to the consumer; never waits on the GPU
+        readback.poll();
     }
     
     void cleanup() {
+        readback.destroy();
+        if (readback.droppedCount() > 0) {
+            std::cout << "WARNING: " << readback.droppedCount() << " readbacks dropped (ring full)" << std::endl;
+        }
         glDeleteTextures(3, distTextures);
         glDeleteTextures(3, distTextures2);
         glDeleteTextures(1, &densityTexture);
@@ -322,11 +360,16 @@ public:
     }
 };
 
-int main() {
+int main(int argc, char** argv) {
     gl.init();
     window.create("Minimal LBM Test", 800, 800);
     
     SimpleLBM sim;
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--export" && i + 1 < argc) {
+            if (!sim.exportTo(argv[++i])) return 1;
+        }
+    }
     sim.initialize();
     
     gl.set_clear_color(0.0f, 0.0f, 0.0f, 1.0f);
@@ -2,6 +2,7 @@
 #include <flgl/tools.h>
 #include <flgl/geometry.h>
 #include <shader_helper.h>
+#include <async_readback.h>
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -41,6 +42,7 @@ private:
     // Debug mode
     bool debugMode = true;
     int frameCount = 0;
+    AsyncReadback readback;  // debug reads, printed by its consumer thread
     
     // D2Q9 weights
     const float weights[9] = {
@@ -122,6 +124,7 @@ public:
         checkGLError("after initial macro");
         
         // Debug: Check initial values
+        readback.create(4, [this](const Readback& r) { printDebugCheck(r); });
         debugCheckValues();
         
         std::cout << "=== Initialization Complete! ===\n" << std::endl;
@@ -300,17 +303,17 @@ public:
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
+    // Queues a read of the 3x3 density around the center; printDebugCheck()
+    // reports it on the readback thread a few frames later
     void debugCheckValues() {
         if (!debugMode || frameCount > 5) return;
+        readback.request(macroFBO, GL_COLOR_ATTACHMENT0, NX/2-1, NY/2-1, 3, 3, GL_RED, 0, frameCount);
+    }
+    
+    void printDebugCheck(const Readback& r) {
+        std::cout << "\n--- Debug Check (Frame " << r.frame << ") ---" << std::endl;
         
-        std::cout << "\n--- Debug Check (Frame " << frameCount << ") ---" << std::endl;
-        
-        // Read back some density values
-        glBindFramebuffer(GL_FRAMEBUFFER, macroFBO);
-        glReadBuffer(GL_COLOR_ATTACHMENT0);
-        
-        float densityValues[9];
-        glReadPixels(NX/2-1, NY/2-1, 3, 3, GL_RED, GL_FLOAT, densityValues);
+        const float* densityValues = r.data.data();
         
         std::cout << "Density values (3x3 center):" << std::endl;
         for (int y = 2; y >= 0; y--) {
@@ -338,8 +341,6 @@ public:
         if (hasNaN) std::cout << "WARNING: NaN detected!" << std::endl;
         if (hasNegative) std::cout << "WARNING: Negative density!" << std::endl;
         if (hasHuge) std::cout << "WARNING: Huge values!" << std::endl;
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
     void render() {
@@ -368,9 +369,11 @@ public:
         if (debugMode && frameCount <= 5) {
             debugCheckValues();
         }
+        readback.poll();
     }
     
     void cleanup() {
+        readback.destroy();
         for (int i = 0; i < 2; i++) {
             glDeleteTextures(3, distTextures[i]);
         }
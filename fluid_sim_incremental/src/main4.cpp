@@ -2,6 +2,7 @@
 #include <flgl/tools.h>
 #include <flgl/geometry.h>
 #include <shader_helper.h>
+#include <async_readback.h>
 #include <iostream>
 #include <cmath>
 #include <vector>
@@ -43,6 +44,7 @@ private:
     // Debug mode
     bool debugMode = true;
     int frameCount = 0;
+    AsyncReadback readback;  // debug reads, printed by its consumer thread
     
     // Quad vertices
     std::vector<Vt_2Dclassic> quadVertices = {
@@ -99,6 +101,7 @@ public:
         
         // Compute initial macroscopic quantities
         computeMacroscopic();
+        readback.create(4, [this](const Readback& r) { printDebugCheck(r); });
         debugCheckValues();
         
         std::cout << "=== Initialization Complete! ===\n" << std::endl;
@@ -278,16 +281,17 @@ public:
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
+    // Queues a read of the 3x3 density around the center; printDebugCheck()
+    // reports it on the readback thread a few frames later
     void debugCheckValues() {
         if (!debugMode || frameCount > 10) return;
+        readback.request(macroFBO, GL_COLOR_ATTACHMENT0, NX/2-1, NY/2-1, 3, 3, GL_RED, 0, frameCount);
+    }
+    
+    void printDebugCheck(const Readback& r) {
+        std::cout << "\n--- Debug Check (Frame " << r.frame << ") ---" << std::endl;
         
-        std::cout << "\n--- Debug Check (Frame " << frameCount << ") ---" << std::endl;
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, macroFBO);
-        glReadBuffer(GL_COLOR_ATTACHMENT0);
-        
-        float densityValues[9];
-        glReadPixels(NX/2-1, NY/2-1, 3, 3, GL_RED, GL_FLOAT, densityValues);
+        const float* densityValues = r.data.data();
         
         std::cout << "Density at center: " << densityValues[4] << std::endl;
         
@@ -298,8 +302,6 @@ public:
             if (densityValues[i] > max) max = densityValues[i];
         }
         std::cout << "Density range: [" << min << ", " << max << "], avg: " << sum/9.0f << std::endl;
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
     }
     
     void render() {
@@ -329,6 +331,7 @@ public:
         if (debugMode && frameCount <= 10) {
             debugCheckValues();
         }
+        readback.poll();
         
         if (frameCount % 100 == 0) {
             std::cout << "Frame " << frameCount << std::endl;
@@ -336,6 +339,7 @@ public:
     }
     
     void cleanup() {
+        readback.destroy();
         for (int i = 0; i < 2; i++) {
             glDeleteTextures(3, distTextures[i]);
         }